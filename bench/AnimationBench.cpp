@@ -0,0 +1,77 @@
+#include "Bench.hpp"
+
+#include <crucible/Animation.hpp>
+#include <crucible/Bone.hpp>
+
+#include <cmath>
+#include <string>
+
+static const int NUM_BONES = 64;
+static const int NUM_KEYFRAMES = 60;
+
+// a humanoid sized skeleton: a spine with four limbs of equal length branching off its end
+static Bone buildSkeleton() {
+    Bone root("bone0", vec3(0.0f, 1.0f, 0.0f), quaternion());
+
+    int index = 1;
+    Bone *spine = &root;
+    for (int i = 0; i < 8; i++) {
+        spine = &spine->addChild(Bone("bone" + std::to_string(index++), vec3(0.0f, 0.2f, 0.0f), quaternion()));
+    }
+
+    int limbLength = (NUM_BONES - index) / 4;
+    for (int limb = 0; limb < 4; limb++) {
+        Bone *bone = spine;
+        for (int i = 0; i < limbLength && index < NUM_BONES; i++) {
+            bone = &bone->addChild(Bone("bone" + std::to_string(index++), vec3(0.1f, 0.0f, 0.0f), quaternion(vec3(0.0f, 1.0f, 0.0f), radians(limb * 90.0f))));
+        }
+    }
+
+    return root;
+}
+
+static Animation buildAnimation() {
+    Animation animation;
+    animation.length = 2.0f;
+
+    for (int i = 0; i < NUM_BONES; i++) {
+        std::vector<Keyframe> &keyframes = animation.keyframes["bone" + std::to_string(i)];
+
+        for (int j = 0; j < NUM_KEYFRAMES; j++) {
+            Keyframe k;
+            k.time = animation.length * (float)j / (float)(NUM_KEYFRAMES - 1);
+            k.transform.position = vec3(0.0f, 0.2f, 0.0f);
+            k.transform.rotation = quaternion(normalize(vec3(1.0f, (float)i, (float)j)), 0.05f * (float)j);
+
+            keyframes.push_back(k);
+        }
+    }
+
+    return animation;
+}
+
+BENCHMARK("animation/Animation::applyToSkeleton", false) {
+    Bone skeleton = buildSkeleton();
+    Animation animation = buildAnimation();
+    float time = 0.0f;
+
+    bench.setItemsPerOp(NUM_BONES);
+    bench.run([&]() {
+        animation.applyToSkeleton(time, skeleton);
+        time = std::fmod(time + 1.0f / 60.0f, animation.length);
+    });
+
+    doNotOptimize(skeleton.position);
+}
+
+BENCHMARK("animation/Bone::getSkinningTransforms", false) {
+    Bone skeleton = buildSkeleton();
+    Animation animation = buildAnimation();
+    animation.applyToSkeleton(0.7f, skeleton);
+
+    bench.setItemsPerOp(NUM_BONES);
+    bench.run([&]() {
+        std::vector<mat4> transforms = skeleton.getSkinningTransforms();
+        doNotOptimize(transforms[0]);
+    });
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps the compiler from optimizing away a value that is computed but never used.
+ */
+template<typename T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static const void *volatile sink;
+    sink = &value;
+#endif
+}
+
+struct BenchResult {
+    std::string name;
+    double nsPerOp = 0.0;
+    double opsPerSecond = 0.0;
+
+    // 0 unless the benchmark set how many items one operation processes
+    double itemsPerSecond = 0.0;
+
+    long iterations = 0;
+};
+
+/**
+ * Measures one benchmark. The body passed to run is timed in batches, the batch size doubles until a batch takes at
+ * least minSampleTime, then numSamples batches are timed and the median is reported.
+ */
+class Bench {
+private:
+    double itemsPerOp = 0.0;
+
+    template<typename F>
+    static double timeBatch(F &body, long iterations) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (long i = 0; i < iterations; i++) {
+            body();
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void finish(std::vector<double> &samples, long iterations);
+
+public:
+    static double minSampleTime;
+    static int numSamples;
+
+    BenchResult result;
+
+    /**
+     * How many items (vertices, particles, bones) a single call of the body processes, for the throughput column.
+     */
+    void setItemsPerOp(double items);
+
+    template<typename F>
+    void run(F body) {
+        long iterations = 1;
+
+        // also serves as the warm up
+        while (timeBatch(body, iterations) < minSampleTime && iterations < (1L << 30)) {
+            iterations *= 2;
+        }
+
+        std::vector<double> samples;
+        for (int i = 0; i < numSamples; i++) {
+            samples.push_back(timeBatch(body, iterations) * 1e9 / (double)iterations);
+        }
+
+        finish(samples, iterations);
+    }
+};
+
+struct BenchmarkInfo {
+    const char *name;
+
+    // benchmarks that upload to the GPU run after a headless window is created, and are skipped with --no-gl
+    bool needsGL;
+
+    void (*function)(Bench &bench);
+};
+
+std::vector<BenchmarkInfo> &getBenchmarks();
+
+struct BenchmarkRegistrar {
+    BenchmarkRegistrar(const char *name, bool needsGL, void (*function)(Bench &bench));
+};
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+
+/**
+ * Defines and registers a benchmark, the block that follows is its body and gets a Bench &bench.
+ */
+#define BENCHMARK(name, needsGL) \
+    static void BENCH_CONCAT(benchmark, __LINE__)(Bench &bench); \
+    static BenchmarkRegistrar BENCH_CONCAT(registrar, __LINE__)(name, needsGL, BENCH_CONCAT(benchmark, __LINE__)); \
+    static void BENCH_CONCAT(benchmark, __LINE__)(Bench &bench)
@@ -0,0 +1,158 @@
+#include "Bench.hpp"
+
+#include <crucible/Window.hpp>
+#include <crucible/Renderer.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+double Bench::minSampleTime = 0.05;
+int Bench::numSamples = 7;
+
+void Bench::setItemsPerOp(double items) {
+    itemsPerOp = items;
+}
+
+void Bench::finish(std::vector<double> &samples, long iterations) {
+    std::sort(samples.begin(), samples.end());
+
+    result.nsPerOp = samples[samples.size() / 2];
+    result.opsPerSecond = result.nsPerOp > 0.0 ? 1e9 / result.nsPerOp : 0.0;
+    result.itemsPerSecond = result.opsPerSecond * itemsPerOp;
+    result.iterations = iterations;
+}
+
+std::vector<BenchmarkInfo> &getBenchmarks() {
+    static std::vector<BenchmarkInfo> benchmarks;
+    return benchmarks;
+}
+
+BenchmarkRegistrar::BenchmarkRegistrar(const char *name, bool needsGL, void (*function)(Bench &bench)) {
+    BenchmarkInfo info;
+    info.name = name;
+    info.needsGL = needsGL;
+    info.function = function;
+
+    getBenchmarks().push_back(info);
+}
+
+static void writeJson(const std::string &path, const std::string &label, const std::vector<BenchResult> &results) {
+    std::ofstream file(path);
+
+    if (!file.is_open()) {
+        std::cout << "Could not write " << path << std::endl;
+        return;
+    }
+
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    file << "{\n  \"label\": \"" << label << "\",\n  \"date\": \"" << date << "\",\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+
+        char line[512];
+        snprintf(line, sizeof(line), "%s\n    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_second\": %.3f, \"items_per_second\": %.3f, \"iterations\": %ld}",
+                 i == 0 ? "" : ",", r.name.c_str(), r.nsPerOp, r.opsPerSecond, r.itemsPerSecond, r.iterations);
+        file << line;
+    }
+
+    file << "\n  ]\n}\n";
+}
+
+static void printUsage() {
+    std::cout << "usage: crucible-bench [--filter text] [--json file] [--label text] [--min-time seconds] [--samples n] [--no-gl] [--list]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::string filter;
+    std::string jsonPath;
+    std::string label;
+    bool useGL = true;
+    bool list = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--label" && hasValue) label = argv[++i];
+        else if (arg == "--min-time" && hasValue) Bench::minSampleTime = atof(argv[++i]);
+        else if (arg == "--samples" && hasValue) Bench::numSamples = std::max(atoi(argv[++i]), 1);
+        else if (arg == "--no-gl") useGL = false;
+        else if (arg == "--list") list = true;
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // static registration order depends on the linker, sort so runs are comparable
+    std::vector<BenchmarkInfo> benchmarks = getBenchmarks();
+    std::stable_sort(benchmarks.begin(), benchmarks.end(), [](const BenchmarkInfo &a, const BenchmarkInfo &b) {
+        return strcmp(a.name, b.name) < 0;
+    });
+
+    // particle spawning uses rand()
+    srand(1234);
+
+    std::vector<BenchResult> results;
+    bool windowCreated = false;
+
+    if (!list) {
+        printf("%-44s %14s %16s %16s\n", "benchmark", "ns/op", "ops/s", "items/s");
+    }
+
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        const BenchmarkInfo &info = benchmarks[i];
+
+        if (!filter.empty() && std::string(info.name).find(filter) == std::string::npos) {
+            continue;
+        }
+        if (info.needsGL && !useGL) {
+            continue;
+        }
+        if (list) {
+            printf("%s%s\n", info.name, info.needsGL ? " (gl)" : "");
+            continue;
+        }
+
+        if (info.needsGL && !windowCreated) {
+            Window::createHeadless(vec2i(1280, 720), "crucible-bench");
+            Renderer::init(1280, 720);
+
+            // anything reading the clock sees the same time steps every run
+            Window::setFixedTimestep(1.0f / 60.0f);
+
+            windowCreated = true;
+        }
+
+        Bench bench;
+        bench.result.name = info.name;
+        info.function(bench);
+
+        const BenchResult &r = bench.result;
+        printf("%-44s %14.1f %16.0f %16.0f\n", r.name.c_str(), r.nsPerOp, r.opsPerSecond, r.itemsPerSecond);
+        fflush(stdout);
+
+        results.push_back(r);
+    }
+
+    if (!jsonPath.empty()) {
+        writeJson(jsonPath, label, results);
+    }
+
+    if (windowCreated) {
+        Window::terminate();
+    }
+
+    return 0;
+}
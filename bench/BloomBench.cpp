@@ -0,0 +1,111 @@
+#include "Bench.hpp"
+
+#include <crucible/PostProcessing.hpp>
+#include <crucible/FramebufferPool.hpp>
+#include <crucible/Renderer.hpp>
+#include <crucible/Resources.hpp>
+
+#include <glad/glad.h>
+
+#include <cmath>
+
+// the three level separable gaussian bloom used before the mip chain, kept here as the baseline
+static float gaussianDistribution(float x, float sigma) {
+    float n = 1.0f / (sqrt(2.0f * PI) * sigma);
+
+    return exp(-x*x/(2.0f * sigma * sigma)) * n;
+}
+
+static void uniformGaussians(const Shader &s, std::string name, int radius) {
+    for (int i = 0; i < radius; i++) {
+        s.uniformFloat(name + "[" + std::to_string(i) + "]", gaussianDistribution(i, 1.0f));
+    }
+
+    s.uniformInt(name + "_length", radius);
+}
+
+static void gaussianBloom(const Framebuffer &source) {
+    vec2i resolution = Renderer::getResolution();
+    int divisors[] = {2, 8, 16};
+
+    const Framebuffer *previous = &source;
+    Framebuffer *results[3];
+
+    for (int i = 0; i < 3; i++) {
+        FramebufferDesc desc = FramebufferDesc(resolution.x / divisors[i], resolution.y / divisors[i]).color(GL_RGB16F, GL_RGB, GL_FLOAT);
+        Framebuffer &temp = FramebufferPool::acquire(desc);
+        Framebuffer &result = FramebufferPool::acquire(desc);
+
+        glViewport(0, 0, result.getWidth(), result.getHeight());
+        result.bind();
+        Resources::passthroughShader.bind();
+        previous->getAttachment(0).bind();
+        Resources::framebufferMesh.render();
+
+        for (int horizontal = 1; horizontal >= 0; horizontal--) {
+            Framebuffer &from = horizontal ? result : temp;
+            Framebuffer &to = horizontal ? temp : result;
+
+            to.bind();
+            Resources::gaussianBlurShader.bind();
+            Resources::gaussianBlurShader.uniformBool("horizontal", horizontal == 1);
+            uniformGaussians(Resources::gaussianBlurShader, "weights", 8);
+            from.getAttachment(0).bind();
+            Resources::framebufferMesh.render();
+        }
+
+        FramebufferPool::release(temp);
+
+        previous = &result;
+        results[i] = &result;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        FramebufferPool::release(*results[i]);
+    }
+}
+
+// times the blur passes only, the composite is a few taps in a merged pass either way
+template<typename F>
+static void runBloom(Bench &bench, int width, int height, F bloom) {
+    Renderer::resize(width, height);
+
+    Framebuffer &source = FramebufferPool::acquire(FramebufferDesc(width, height).color(GL_RGB16F, GL_RGB, GL_FLOAT));
+
+    bench.setItemsPerOp((double)width * height);
+    bench.run([&]() {
+        bloom(source);
+        glFinish();
+    });
+
+    FramebufferPool::release(source);
+    Renderer::resize(1280, 720);
+}
+
+BENCHMARK("bloom/gaussian 3 levels 1080p", true) {
+    runBloom(bench, 1920, 1080, gaussianBloom);
+}
+
+BENCHMARK("bloom/gaussian 3 levels 4k", true) {
+    runBloom(bench, 3840, 2160, gaussianBloom);
+}
+
+BENCHMARK("bloom/mip chain 1080p", true) {
+    BloomPostProcessor bloom;
+    Camera cam;
+
+    runBloom(bench, 1920, 1080, [&](const Framebuffer &source) {
+        bloom.prepareFused(cam, source);
+        bloom.finishFused();
+    });
+}
+
+BENCHMARK("bloom/mip chain 4k", true) {
+    BloomPostProcessor bloom;
+    Camera cam;
+
+    runBloom(bench, 3840, 2160, [&](const Framebuffer &source) {
+        bloom.prepareFused(cam, source);
+        bloom.finishFused();
+    });
+}
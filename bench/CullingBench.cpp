@@ -0,0 +1,126 @@
+#include "Bench.hpp"
+
+#include <crucible/AABB.hpp>
+#include <crucible/Camera.hpp>
+#include <crucible/Frustum.hpp>
+#include <crucible/OcclusionCuller.hpp>
+
+#include <random>
+
+static const int COUNT = 4096;
+
+static std::vector<AABB> randomBoxes(int count) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+    std::vector<AABB> boxes;
+    for (int i = 0; i < count; i++) {
+        vec3 min(position(rng), position(rng), position(rng));
+        boxes.push_back(AABB(min, min + vec3(size(rng), size(rng), size(rng))));
+    }
+
+    return boxes;
+}
+
+BENCHMARK("culling/Frustum::isBoxInside", false) {
+    std::vector<AABB> boxes = randomBoxes(COUNT);
+
+    Camera cam;
+    cam.position = vec3(0.0f, 0.0f, 0.0f);
+    cam.direction = normalize(vec3(1.0f, -0.2f, -1.0f));
+    cam.dimensions = vec2(1920.0f, 1080.0f);
+
+    Frustum f;
+    f.setupInternals(cam.fov, cam.dimensions.x / cam.dimensions.y, cam.nearPlane, cam.farPlane);
+    f.updateCamPosition(cam);
+
+    bench.setItemsPerOp(COUNT);
+    bench.run([&]() {
+        int visible = 0;
+        for (int i = 0; i < COUNT; i++) {
+            visible += f.isBoxInside(boxes[i]);
+        }
+        doNotOptimize(visible);
+    });
+}
+
+BENCHMARK("culling/AABB::raycast", false) {
+    std::vector<AABB> boxes = randomBoxes(COUNT);
+
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+    std::vector<vec3> directions;
+    for (int i = 0; i < COUNT; i++) {
+        directions.push_back(normalize(vec3(direction(rng), direction(rng), direction(rng)) + vec3(0.0f, 0.0f, 0.01f)));
+    }
+
+    bench.setItemsPerOp(COUNT);
+    bench.run([&]() {
+        int hits = 0;
+        vec3 point;
+        vec3 normal;
+
+        for (int i = 0; i < COUNT; i++) {
+            hits += boxes[i].raycast(vec3(0.0f), directions[i] * 400.0f, point, normal);
+        }
+        doNotOptimize(hits);
+    });
+}
+
+// a grid of 64 walls in front of the camera, the kind of large occluders a level would mark
+static void addWalls(OcclusionCuller &culler) {
+    std::vector<vec3> positions = {vec3(-4.0f, -4.0f, 0.0f), vec3(4.0f, -4.0f, 0.0f), vec3(4.0f, 4.0f, 0.0f), vec3(-4.0f, 4.0f, 0.0f)};
+    std::vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+
+    for (int x = 0; x < 8; x++) {
+        for (int z = 0; z < 8; z++) {
+            culler.addOccluder(positions, indices, translate(mat4(), vec3(x * 12.0f - 42.0f, 0.0f, -10.0f - z * 6.0f)));
+        }
+    }
+}
+
+static Camera occlusionCamera() {
+    Camera cam;
+    cam.position = vec3(0.0f, 0.0f, 10.0f);
+    cam.direction = vec3(0.0f, 0.0f, -1.0f);
+    cam.dimensions = vec2(1920.0f, 1080.0f);
+
+    return cam;
+}
+
+BENCHMARK("culling/OcclusionCuller::rasterize", false) {
+    Camera cam = occlusionCamera();
+
+    OcclusionCuller culler;
+    culler.setup(256, 128);
+
+    bench.setItemsPerOp(128);
+    bench.run([&]() {
+        culler.begin(cam.getProjection() * cam.getView());
+        addWalls(culler);
+        culler.rasterize();
+        doNotOptimize(culler.getDepth(128, 64));
+    });
+}
+
+BENCHMARK("culling/OcclusionCuller::isOccluded", false) {
+    std::vector<AABB> boxes = randomBoxes(COUNT);
+    Camera cam = occlusionCamera();
+
+    OcclusionCuller culler;
+    culler.setup(256, 128);
+    culler.begin(cam.getProjection() * cam.getView());
+    addWalls(culler);
+    culler.rasterize();
+
+    bench.setItemsPerOp(COUNT);
+    bench.run([&]() {
+        int occluded = 0;
+        for (int i = 0; i < COUNT; i++) {
+            occluded += culler.isOccluded(boxes[i]);
+        }
+        doNotOptimize(occluded);
+    });
+}
@@ -0,0 +1,132 @@
+#include "Bench.hpp"
+
+#include <crucible/Renderer.hpp>
+#include <crucible/Primitives.hpp>
+#include <crucible/FramebufferPool.hpp>
+
+#include <glad/glad.h>
+
+// a screen filling grid of spheres lit by a sun and full screen point lights, so most of the frame is passes reading
+// the g-buffer
+static void runScene(Bench &bench, bool compact) {
+    Renderer::compactGBuffer = compact;
+    Renderer::resize(1920, 1080);
+
+    Mesh sphere = Primitives::sphere(32, 32);
+
+    Material material;
+    material.setPBRUniforms(vec3(0.5f), 0.5f, 0.0f);
+
+    std::vector<Transform> transforms;
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 9; y++) {
+            transforms.push_back(Transform(vec3(x - 7.5f, y - 4.0f, -8.0f), quaternion(), vec3(0.6f)));
+        }
+    }
+
+    DirectionalLight sun(vec3(1.05f, -1.2f, -1.3f), vec3(1.2f));
+
+    std::vector<PointLight> lights;
+    for (int i = 0; i < 32; i++) {
+        lights.push_back(PointLight(vec3((i % 8) * 2.0f - 7.0f, (i / 8) * 2.0f - 3.0f, -6.0f), vec3(1.0f), 12.0f));
+    }
+
+    Camera cam;
+    cam.dimensions = vec2(1920.0f, 1080.0f);
+
+    Renderer::PointLightMode mode = Renderer::pointLightMode;
+    Renderer::pointLightMode = Renderer::POINT_LIGHTS_FULLSCREEN;
+
+    bench.setItemsPerOp(1920.0 * 1080.0);
+    bench.run([&]() {
+        for (size_t i = 0; i < transforms.size(); i++) {
+            Renderer::render(&sphere, &material, &transforms[i]);
+        }
+        Renderer::renderDirectionalLight(&sun);
+        for (size_t i = 0; i < lights.size(); i++) {
+            Renderer::renderPointLight(&lights[i]);
+        }
+
+        Renderer::flushToTexture(cam);
+        glFinish();
+    });
+
+    Renderer::pointLightMode = mode;
+    Renderer::compactGBuffer = false;
+    Renderer::resize(1280, 720);
+
+    sphere.destroy();
+}
+
+BENCHMARK("gbuffer/full layout 1080p", true) {
+    runScene(bench, false);
+}
+
+BENCHMARK("gbuffer/compact layout 1080p", true) {
+    runScene(bench, true);
+}
+
+// eight layers of spheres behind each other, drawn front to back or back to front
+static void runOverdraw(Bench &bench, Renderer::DepthPrepassMode mode, bool backToFront) {
+    Renderer::resize(1920, 1080);
+
+    Mesh sphere = Primitives::sphere(32, 32);
+
+    Material material;
+    material.setPBRUniforms(vec3(0.5f), 0.5f, 0.0f);
+
+    std::vector<Transform> transforms;
+    for (int layer = 0; layer < 8; layer++) {
+        int z = backToFront ? 7 - layer : layer;
+
+        for (int x = 0; x < 16; x++) {
+            for (int y = 0; y < 9; y++) {
+                transforms.push_back(Transform(vec3((x - 7.5f) * (1.0f + z * 0.25f), (y - 4.0f) * (1.0f + z * 0.25f), -8.0f - z * 2.0f), quaternion(), vec3(0.6f)));
+            }
+        }
+    }
+
+    DirectionalLight sun(vec3(1.05f, -1.2f, -1.3f), vec3(1.2f));
+
+    Camera cam;
+    cam.dimensions = vec2(1920.0f, 1080.0f);
+
+    Renderer::DepthPrepassMode previousMode = Renderer::depthPrepassMode;
+    Renderer::depthPrepassMode = mode;
+
+    bench.setItemsPerOp(1920.0 * 1080.0);
+    bench.run([&]() {
+        for (size_t i = 0; i < transforms.size(); i++) {
+            Renderer::render(&sphere, &material, &transforms[i]);
+        }
+        Renderer::renderDirectionalLight(&sun);
+
+        Renderer::flushToTexture(cam);
+        glFinish();
+    });
+
+    Renderer::depthPrepassMode = previousMode;
+    Renderer::resize(1280, 720);
+
+    sphere.destroy();
+}
+
+BENCHMARK("gbuffer/overdraw back to front", true) {
+    runOverdraw(bench, Renderer::DEPTH_PREPASS_NEVER, true);
+}
+
+BENCHMARK("gbuffer/overdraw back to front with prepass", true) {
+    runOverdraw(bench, Renderer::DEPTH_PREPASS_ALWAYS, true);
+}
+
+BENCHMARK("gbuffer/overdraw front to back", true) {
+    runOverdraw(bench, Renderer::DEPTH_PREPASS_NEVER, false);
+}
+
+BENCHMARK("gbuffer/overdraw front to back with prepass", true) {
+    runOverdraw(bench, Renderer::DEPTH_PREPASS_ALWAYS, false);
+}
+
+BENCHMARK("gbuffer/overdraw back to front auto", true) {
+    runOverdraw(bench, Renderer::DEPTH_PREPASS_AUTO, true);
+}
@@ -0,0 +1,44 @@
+#include "Bench.hpp"
+
+#include <crucible/SphericalHarmonics.hpp>
+#include <crucible/ThreadPool.hpp>
+
+#include <random>
+
+static const int SIZE = 128;
+
+static void runProjection(Bench &bench, int threads) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> radiance(0.0f, 4.0f);
+
+    std::vector<float> faces[6];
+    const float *faceData[6];
+
+    for (int i = 0; i < 6; i++) {
+        faces[i].resize(SIZE * SIZE * 3);
+        for (float &value : faces[i]) {
+            value = radiance(rng);
+        }
+
+        faceData[i] = faces[i].data();
+    }
+
+    int previousThreads = ThreadPool::numThreads;
+    ThreadPool::numThreads = threads;
+
+    bench.setItemsPerOp(SIZE * SIZE * 6);
+    bench.run([&]() {
+        SH9 sh = SphericalHarmonics::projectIrradiance(faceData, SIZE);
+        doNotOptimize(sh);
+    });
+
+    ThreadPool::numThreads = previousThreads;
+}
+
+BENCHMARK("ibl/SphericalHarmonics::projectIrradiance 128 single thread", false) {
+    runProjection(bench, 1);
+}
+
+BENCHMARK("ibl/SphericalHarmonics::projectIrradiance 128", false) {
+    runProjection(bench, 0);
+}
@@ -0,0 +1,93 @@
+#include "Bench.hpp"
+
+#include <crucible/Math.hpp>
+
+#include <random>
+
+static const int COUNT = 1024;
+
+static std::vector<mat4> randomMatrices(int count) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+    std::uniform_real_distribution<float> offset(-100.0f, 100.0f);
+
+    std::vector<mat4> matrices;
+    for (int i = 0; i < count; i++) {
+        Transform t(vec3(offset(rng), offset(rng), offset(rng)), quaternion(normalize(vec3(offset(rng), offset(rng), offset(rng))), angle(rng)), vec3(1.5f));
+        matrices.push_back(t.getMatrix());
+    }
+
+    return matrices;
+}
+
+static std::vector<quaternion> randomRotations(int count) {
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+    std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+
+    std::vector<quaternion> rotations;
+    for (int i = 0; i < count; i++) {
+        rotations.push_back(quaternion(normalize(vec3(axis(rng), axis(rng), axis(rng)) + vec3(0.0f, 0.0f, 0.01f)), angle(rng)));
+    }
+
+    return rotations;
+}
+
+BENCHMARK("math/mat4 multiply", false) {
+    std::vector<mat4> matrices = randomMatrices(COUNT);
+    int i = 0;
+
+    bench.run([&]() {
+        mat4 result = matrices[i] * matrices[(i + 1) % COUNT];
+        doNotOptimize(result);
+        i = (i + 1) % COUNT;
+    });
+}
+
+BENCHMARK("math/mat4 inverse", false) {
+    std::vector<mat4> matrices = randomMatrices(COUNT);
+    int i = 0;
+
+    bench.run([&]() {
+        mat4 result = inverse(matrices[i]);
+        doNotOptimize(result);
+        i = (i + 1) % COUNT;
+    });
+}
+
+BENCHMARK("math/mat4 transform points", false) {
+    std::vector<mat4> matrices = randomMatrices(1);
+    std::vector<vec4> points(COUNT, vec4(1.0f, 2.0f, 3.0f, 1.0f));
+    std::vector<vec4> results(COUNT);
+
+    bench.setItemsPerOp(COUNT);
+    bench.run([&]() {
+        for (int i = 0; i < COUNT; i++) {
+            results[i] = matrices[0] * points[i];
+        }
+        doNotOptimize(results[0]);
+    });
+}
+
+BENCHMARK("math/quaternion slerp", false) {
+    std::vector<quaternion> rotations = randomRotations(COUNT);
+    int i = 0;
+
+    bench.run([&]() {
+        quaternion result = slerp(rotations[i], rotations[(i + 1) % COUNT], 0.37f);
+        doNotOptimize(result);
+        i = (i + 1) % COUNT;
+    });
+}
+
+BENCHMARK("math/transform getMatrix", false) {
+    std::vector<quaternion> rotations = randomRotations(COUNT);
+    int i = 0;
+
+    bench.run([&]() {
+        Transform t(vec3(1.0f, 2.0f, 3.0f), rotations[i], vec3(2.0f));
+        mat4 result = t.getMatrix();
+        doNotOptimize(result);
+        i = (i + 1) % COUNT;
+    });
+}
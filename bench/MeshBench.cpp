@@ -0,0 +1,74 @@
+#include "Bench.hpp"
+
+#include <crucible/Mesh.hpp>
+
+#include <cmath>
+
+// same layout as Primitives::sphere, built here so the CPU benchmarks don't need a GL context
+static void buildSphere(Mesh &mesh, unsigned int xSegments, unsigned int ySegments) {
+    for (unsigned int y = 0; y <= ySegments; y++) {
+        for (unsigned int x = 0; x <= xSegments; x++) {
+            float xSegment = (float)x / (float)xSegments;
+            float ySegment = (float)y / (float)ySegments;
+            vec3 position(std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI), std::cos(ySegment * PI), std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI));
+
+            mesh.positions.push_back(position);
+            mesh.normals.push_back(position);
+            mesh.uvs.push_back(vec2(xSegment, ySegment));
+            mesh.tangents.push_back(normalize(vec3(-position.z, 0.0f, position.x) + vec3(0.001f, 0.0f, 0.0f)));
+        }
+    }
+
+    for (unsigned int y = 0; y < ySegments; y++) {
+        for (unsigned int x = 0; x < xSegments; x++) {
+            unsigned int i0 = y * (xSegments + 1) + x;
+            unsigned int i1 = i0 + xSegments + 1;
+
+            mesh.indices.push_back(i0);
+            mesh.indices.push_back(i1);
+            mesh.indices.push_back(i0 + 1);
+            mesh.indices.push_back(i0 + 1);
+            mesh.indices.push_back(i1);
+            mesh.indices.push_back(i1 + 1);
+        }
+    }
+}
+
+BENCHMARK("mesh/Mesh::generate 128x128 sphere", true) {
+    Mesh mesh;
+    buildSphere(mesh, 128, 128);
+
+    bench.setItemsPerOp((double)mesh.positions.size());
+    bench.run([&]() {
+        mesh.generate();
+    });
+
+    mesh.destroy();
+}
+
+BENCHMARK("mesh/Mesh::generate 128x128 sphere unpooled", true) {
+    Mesh mesh;
+    mesh.pooled = false;
+    buildSphere(mesh, 128, 128);
+
+    bench.setItemsPerOp((double)mesh.positions.size());
+    bench.run([&]() {
+        mesh.generate();
+    });
+
+    mesh.destroy();
+}
+
+BENCHMARK("mesh/Mesh::fromJson 32x32 sphere", false) {
+    Mesh source;
+    buildSphere(source, 32, 32);
+
+    json j = source.toJson();
+
+    bench.setItemsPerOp((double)source.positions.size());
+    bench.run([&]() {
+        Mesh mesh;
+        mesh.fromJson(j);
+        doNotOptimize(mesh.positions[0]);
+    });
+}
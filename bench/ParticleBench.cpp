@@ -0,0 +1,34 @@
+#include "Bench.hpp"
+
+#include <crucible/ParticleSystem.hpp>
+
+BENCHMARK("particles/ParticleSystem::update 3000", true) {
+    ParticleSystem particles;
+    particles.particleCount = 3000;
+    particles.despawn = true;
+    particles.init();
+
+    Camera cam;
+    cam.position = vec3(0.0f, 5.0f, 20.0f);
+    cam.direction = vec3(0.0f, 0.0f, -1.0f);
+
+    bench.setItemsPerOp(particles.particleCount);
+    bench.run([&]() {
+        particles.update(cam);
+    });
+}
+
+BENCHMARK("particles/ParticleSystem::update 3000 unsorted", true) {
+    ParticleSystem particles;
+    particles.particleCount = 3000;
+    particles.despawn = true;
+    particles.sorting = false;
+    particles.init();
+
+    Camera cam;
+
+    bench.setItemsPerOp(particles.particleCount);
+    bench.run([&]() {
+        particles.update(cam);
+    });
+}
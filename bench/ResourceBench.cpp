@@ -0,0 +1,59 @@
+#include "Bench.hpp"
+
+#include <crucible/Texture.hpp>
+
+#include <stb_image.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static std::vector<unsigned char> readFile(const char *path) {
+    std::ifstream file(path, std::ios::binary);
+
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static const char *texturePath = PROJECT_SOURCE_DIR "/resources/checkerboard/albedo.png";
+
+BENCHMARK("resources/decode png", false) {
+    std::vector<unsigned char> file = readFile(texturePath);
+
+    if (file.empty()) {
+        std::cout << "Could not read " << texturePath << std::endl;
+        return;
+    }
+
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    stbi_info_from_memory(&file[0], (int)file.size(), &width, &height, &channels);
+
+    bench.setItemsPerOp((double)width * height);
+    bench.run([&]() {
+        unsigned char *data = stbi_load_from_memory(&file[0], (int)file.size(), &width, &height, &channels, 4);
+        doNotOptimize(data);
+        stbi_image_free(data);
+    });
+}
+
+BENCHMARK("resources/texture upload with mipmaps", true) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char *data = stbi_load(texturePath, &width, &height, &channels, 4);
+
+    if (!data) {
+        std::cout << "Could not read " << texturePath << std::endl;
+        return;
+    }
+
+    bench.setItemsPerOp((double)width * height);
+    bench.run([&]() {
+        Texture texture;
+        texture.load(data, width, height);
+        texture.destroy();
+    });
+
+    stbi_image_free(data);
+}
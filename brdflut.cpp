@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// Integrates the split sum BRDF of lighting.glsl on the CPU, with the same sampling and geometry term as its
+// IntegrateBRDF, and writes it as a GPU ready RG16F lookup table: width and height as two 32 bit integers followed by
+// the rows bottom to top, NdotV along x and roughness along y.
+
+static const int SIZE = 128;
+static const uint32_t SAMPLE_COUNT = 1024u;
+
+static const float PI = 3.14159265359f;
+
+struct Vec3 {
+    float x, y, z;
+};
+
+static float dot(const Vec3 &a, const Vec3 &b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static float radicalInverse(uint32_t bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return float(bits) * 2.3283064365386963e-10f;
+}
+
+static float geometrySchlickGGX(float NdotV, float roughness) {
+    float r = roughness + 1.0f;
+    float k = (r * r) / 8.0f;
+    return NdotV / (NdotV * (1.0f - k) + k);
+}
+
+// the normal is +z, so the GGX half vector is already in tangent space
+static Vec3 importanceSampleGGX(float u, float v, float roughness) {
+    float a = roughness * roughness;
+    float phi = 2.0f * PI * u;
+    float cosTheta = std::sqrt((1.0f - v) / (1.0f + (a * a - 1.0f) * v));
+    float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+    return {std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta};
+}
+
+static void integrateBRDF(float NdotV, float roughness, float &scale, float &bias) {
+    Vec3 V = {std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV};
+
+    float A = 0.0f;
+    float B = 0.0f;
+
+    for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+        Vec3 H = importanceSampleGGX(float(i) / float(SAMPLE_COUNT), radicalInverse(i), roughness);
+
+        float VdotH = dot(V, H);
+        Vec3 L = {2.0f * VdotH * H.x - V.x, 2.0f * VdotH * H.y - V.y, 2.0f * VdotH * H.z - V.z};
+
+        float NdotL = std::fmax(L.z, 0.0f);
+        float NdotH = std::fmax(H.z, 0.0f);
+        VdotH = std::fmax(VdotH, 0.0f);
+
+        if (NdotL > 0.0f) {
+            float G = geometrySchlickGGX(NdotV, roughness) * geometrySchlickGGX(NdotL, roughness);
+            float G_Vis = (G * VdotH) / (NdotH * NdotV);
+            float Fc = std::pow(1.0f - VdotH, 5.0f);
+
+            A += (1.0f - Fc) * G_Vis;
+            B += Fc * G_Vis;
+        }
+    }
+
+    scale = A / float(SAMPLE_COUNT);
+    bias = B / float(SAMPLE_COUNT);
+}
+
+// round to nearest even, the table only holds small positive values so infinities and NaNs can't come up
+static uint16_t toHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+
+        // denormal
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7bffu);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        // carries into the exponent when the mantissa overflows, which is still the right rounding
+        half++;
+    }
+    return (uint16_t)half;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "USAGE: %s {out}\n\n"
+                        "  Writes the BRDF lookup table to {out}\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream ofs(argv[1], std::ios::binary);
+
+    if (!ofs) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t size[2] = {SIZE, SIZE};
+    ofs.write((const char*)size, sizeof(size));
+
+    // sampled at texel centers, the same coordinates a full screen pass over the table would have
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < SIZE; x++) {
+            float scale, bias;
+            integrateBRDF((x + 0.5f) / SIZE, (y + 0.5f) / SIZE, scale, bias);
+
+            uint16_t texel[2] = {toHalf(scale), toHalf(bias)};
+            ofs.write((const char*)texel, sizeof(texel));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -27,7 +27,8 @@ int main(int argc, char** argv)
 
     ofstream ofs(dst);
 
-    ifstream ifs(src);
+    // binary, so generated data survives on platforms that translate line endings
+    ifstream ifs(src, ios::binary);
 
     ofs << "#include <stdlib.h>" << endl;
     ofs << "char _resource_" << sym << "[] = {" << endl;
@@ -36,7 +37,8 @@ int main(int argc, char** argv)
     char c;
     while (ifs.get(c))
     {
-        ofs << "0x" << hex << (c&0xff) << ", ";
+        // cast, bytes above 0x7f would otherwise be narrowing conversions in the char initializer
+        ofs << "(char)0x" << hex << (c&0xff) << ", ";
         if (++lineCount == 10) {
             ofs << endl;
             lineCount = 0;
@@ -17,7 +17,7 @@ int main() {
     PointLight lamp(vec3(0.0f, 2.0f, 5.0f), vec3(1.0f, 0.6f, 0.4f)*10.0f, 5.0f);
 
     // create all meshes to be used in the scene
-	Mesh shaderball = Resources::getAssimpFile("resources/shaderball.fbx").getMesh(0);
+	Mesh &shaderball = Resources::getAssimpFile("resources/shaderball.fbx").getMesh(0);
     Mesh cube = Primitives::cube(0.1f, 20.0f, 1.0f, 20.0f);
     Mesh sphere = Primitives::sphere(32, 32);
 
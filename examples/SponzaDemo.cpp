@@ -28,7 +28,7 @@ int main() {
     Material probe;
     probe.setPBRUniforms(vec3(1.0f), 0.0f, 1.0f);
 
-    Mesh dragon = Resources::getAssimpFile("resources/dragon.obj").getMesh(0);
+    Mesh &dragon = Resources::getAssimpFile("resources/dragon.obj").getMesh(0);
     Material metal;
     metal.setPBRUniforms(vec3(1.0f), 0.3f, 1.0f);
 
@@ -42,12 +42,44 @@ int main() {
     Scene scene;
     scene.setupPhysicsWorld();
 
-    Resources::getAssimpFile("resources/sponza/sponza.obj").addToScene(scene);
+    AssimpFile &sponza = Resources::getAssimpFile("resources/sponza/sponza.obj");
+    sponza.addToScene(scene);
+
+    // the walls, floors and pillars hide most of the hall from any point inside it. Small meshes hide little and
+    // would only cost rasterizing, and the culler reads the CPU side data the importer keeps around
+    std::vector<const Mesh*> occluders;
+    for (unsigned int i = 0; i < sponza.numMeshes(); i++) {
+        const Mesh &mesh = sponza.getMesh(i);
+        const AABB *bounds = mesh.getBounds();
+
+        if (length(bounds->max - bounds->min) > 20.0f) {
+            occluders.push_back(&mesh);
+        }
+    }
     
     scene.createMeshObject(sphere, probe, Transform(vec3(0.0f, 20.0f, 0.0f)), "probe");
     scene.createMeshObject(dragon, metal, Transform(vec3(20.0f, 4.5f, -2.0f), quaternion(vec3(0.0f, 1.0f, 0.0f), radians(30)), vec3(1.0f)), "dragon");
 
-    bool first = true;
+    // baked probes are cached here, later launches load them instead of baking
+    IBL::cacheDirectory = "resources/";
+
+    // the sky is baked first so it lights the two probes inside, which blend along the hall
+    IBL::Probe sky(vec3(0.0f, 20000.0f, 0.0f));
+    IBL::Probe hall[] = {
+        IBL::Probe(vec3(-40.0f, 20.0f, 0.0f), 60.0f),
+        IBL::Probe(vec3(40.0f, 20.0f, 0.0f), 60.0f)
+    };
+
+    // a dense row of irradiance only probes along the floor, 27 floats each once baked
+    std::vector<IBL::Probe> floorProbes;
+    for (int i = 0; i < 8; i++) {
+        floorProbes.push_back(IBL::Probe(vec3(i * 15.0f - 52.5f, 5.0f, 0.0f), 15.0f, false));
+    }
+
+    std::vector<IBL::Probe*> bakeOrder = {&hall[0], &hall[1]};
+    for (IBL::Probe &probe : floorProbes) {
+        bakeOrder.push_back(&probe);
+    }
 
     while (Window::isOpen()) {
         Window::begin();
@@ -68,17 +100,34 @@ int main() {
         // render all objects in the scene
         scene.render();
 
-        // if this is the first frame, render scene into a light probe
-        if (first) {
-            IBL::generateIBLmaps(vec3(0.0f,  20000.0f, 0.0f), Renderer::irradiance, Renderer::specular);
-
-            IBL::generateIBLmaps(vec3(0.0f,  20.0f, 0.0f), Renderer::irradiance, Renderer::specular);
-            
-            first = false;
+        for (const Mesh *occluder : occluders) {
+            Renderer::renderOccluder(occluder, nullptr);
         }
 
         Renderer::renderDirectionalLight(&sun);
-        
+
+        // bake the light probes a few steps per frame instead of stalling on the first one. The sun has to be submitted
+        // by now, the captures and the cache key are made of the queued frame. The probes are submitted after, so they
+        // don't light each other's captures, which the cache key doesn't cover
+        if (!sky.isBaked()) {
+            if (sky.bake(2.0f)) {
+                Renderer::irradiance = sky.getIrradiance();
+                Renderer::specular = sky.getSpecular();
+            }
+        }
+        else {
+            for (IBL::Probe *probe : bakeOrder) {
+                if (!probe->isBaked()) {
+                    probe->bake(2.0f);
+                    break;
+                }
+            }
+        }
+
+        for (IBL::Probe *probe : bakeOrder) {
+            Renderer::renderProbe(probe);
+        }
+
         // render the scene to the screen
         Renderer::flush(cam);
 
@@ -5,23 +5,71 @@
 #include <crucible/Camera.hpp>
 #include <crucible/Frustum.hpp>
 
+#include <vector>
+
+/**
+ * One shadow map of a cascaded shadow map, along with what it was last rendered with so it can be reused.
+ */
+struct ShadowCascade {
+    Framebuffer buffer;
+
+    // projection * view of the shadow camera the map was rendered with
+    mat4 lightSpaceMatrix;
+
+    // texel snapped shadow camera position and hash of the shadow casters at the last update
+    vec3 center;
+    unsigned int casterHash = 0;
+
+    // the cascade is re-rendered at most once every updateInterval frames
+    int updateInterval = 1;
+    int framesSinceUpdate = 0;
+
+    bool valid = false;
+};
+
 class DirectionalLight {
 private:
     bool isFramebufferSetup = false;
 
-    Camera getShadowCamera(float radius, const Camera &cam, float depth);
+    Camera getShadowCamera(float radius, const vec3 &center, float depth);
+
+    Frustum getShadowFrustum(float radius, const vec3 &center, float depth);
 
-    Frustum getShadowFrustum(float radius, const Camera &cam, float depth);
+    /**
+     * Fits a bounding sphere around the part of the view frustum covered by a cascade. Returns its radius.
+     */
+    float getCascadeBounds(int cascade, const Camera &cam, vec3 &center);
+
+    /**
+     * Returns center moved onto the shadow map's texel grid, so the map only shifts by whole texels as the camera
+     * moves and static shadows don't shimmer.
+     */
+    vec3 getSnappedCenter(float radius, const vec3 &center);
+
+    float getDepthStep(float radius);
 
     void setupFramebuffers();
 
+    void renderProbeCascades(const Camera &cam);
+
     bool m_hasShadows;
     int m_shadowResolution;
 
     float m_shadowDepth;
     std::vector<float> m_shadowDistances;
 
-    std::vector<Framebuffer> shadowBuffers;
+    std::vector<ShadowCascade> m_cascades;
+    int m_numUpdatedCascades = 0;
+
+    // fitted to a probe face and re-rendered for every one, so probe captures never touch the cached cascades
+    std::vector<ShadowCascade> m_probeCascades;
+
+    // whether the last preRender was for a probe, render samples the cascades it filled
+    bool m_renderingProbe = false;
+    std::vector<int> m_updateIntervals = {1, 1, 2, 4};
+
+    // direction the cascades were last rendered with
+    vec3 m_cachedDirection;
 
 public:
     vec3 m_direction;
@@ -35,9 +83,29 @@ public:
 
     DirectionalLight(vec3 direction, vec3 color, int shadowResolution, std::vector<float> distances);
 
-    
-
-    void preRender(const Camera &cam);
+    /**
+     * Sets how many frames each cascade may go without being re-rendered, starting at the nearest one. Cascades past
+     * the end of the list use its last value. Cascades are also skipped while neither the camera moved by a texel
+     * nor any shadow caster changed. Defaults to {1, 1, 2, 4}.
+     */
+    void setCascadeUpdateIntervals(const std::vector<int> &intervals);
+
+    /**
+     * Forces all cascades to be re-rendered on the next frame.
+     */
+    void invalidateShadows();
+
+    /**
+     * Number of cascades that were re-rendered in the last preRender call of the main view.
+     */
+    int getNumUpdatedCascades() const;
+
+    /**
+     * Updates the shadow cascades for the view about to be lit. The main view goes through the cache, which counts
+     * frames by these calls, so it has to be called once per flush. Other views, like probe faces, get uncached
+     * cascades of their own that are re-rendered on every call.
+     */
+    void preRender(const Camera &cam, bool mainView = true);
 
     void render(const Camera &cam);
 };
\ No newline at end of file
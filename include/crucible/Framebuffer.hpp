@@ -25,6 +25,11 @@ public:
 	 */
 	void attachRBO();
 
+	/**
+	 * Attaches a depth and stencil texture that can be sampled, added after the color attachments.
+	 */
+	void attachDepthTexture();
+
     /**
      * Initializes this framebuffer with data for shadow maps.
      */
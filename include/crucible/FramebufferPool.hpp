@@ -0,0 +1,84 @@
+#pragma once
+
+#include <crucible/Framebuffer.hpp>
+
+#include <cstddef>
+#include <vector>
+
+struct FramebufferFormat {
+    unsigned int internalFormat;
+    unsigned int format;
+    unsigned int type;
+};
+
+/**
+ * Size and attachments of a pooled framebuffer. Two framebuffers with equal descriptions are interchangeable.
+ */
+struct FramebufferDesc {
+    int width = 0;
+    int height = 0;
+
+    std::vector<FramebufferFormat> attachments;
+
+    // depth and stencil renderbuffer
+    bool depthStencil = false;
+
+    // the depth and stencil buffer is a texture instead, the last attachment
+    bool sampledDepth = false;
+
+    FramebufferDesc(int width, int height);
+
+    FramebufferDesc &color(unsigned int internalFormat, unsigned int format, unsigned int type);
+
+    FramebufferDesc &depth();
+
+    /**
+     * Depth and stencil in a texture that can be sampled after rendering.
+     */
+    FramebufferDesc &depthTexture();
+
+    bool operator==(const FramebufferDesc &other) const;
+};
+
+/**
+ * Shares framebuffers between render passes. A pass acquires a framebuffer of the size and format it needs and releases
+ * it when done, so passes that don't run at the same time end up using the same memory. Framebuffers nobody acquired
+ * for a few frames are deleted, so after a resolution change the old sizes go away on their own while switching back
+ * and forth (or rendering a probe at another size) doesn't reallocate anything.
+ */
+namespace FramebufferPool {
+    /**
+     * Frames a released framebuffer is kept around before it's deleted.
+     */
+    extern int maxUnusedFrames;
+
+    /**
+     * Returns a framebuffer matching the description that is held until released. Contents are undefined.
+     */
+    Framebuffer &acquire(const FramebufferDesc &desc);
+
+    /**
+     * Like acquire, but released automatically at the next newFrame. For results that have to outlive the pass that
+     * rendered them until the end of the frame.
+     */
+    Framebuffer &acquireForFrame(const FramebufferDesc &desc);
+
+    void release(const Framebuffer &framebuffer);
+
+    /**
+     * Releases the framebuffers acquired for the previous frame and deletes the ones that went unused for too long.
+     * Renderer::flushToTexture calls this once per frame.
+     */
+    void newFrame();
+
+    void destroyAll();
+
+    int getNumFramebuffers();
+
+    int getNumAcquired();
+
+    /**
+     * Approximate GPU memory held by the pool in bytes.
+     */
+    size_t getMemoryUsage();
+}
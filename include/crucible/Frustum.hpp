@@ -17,10 +17,21 @@ public:
     vec3 pos, dir, up, right;
     vec3 normalTop, normalBottom, normalLeft, normalRight;
 
+    // near, far, left, right, top, bottom. Normals point inwards, a point p is inside a plane if dot(n, p) + d >= 0
+    vec3 planeNormals[6];
+    float planeOffsets[6];
+
+    bool orthographic = false;
+    vec2 orthoOffset;
+
     Frustum();
 
     void setupInternals(float fov, float aspect, float near, float far);
 
+    /**
+     * Sets up a box shaped frustum, as used by orthographic cameras. Offsets are relative to the camera position along
+     * its right, up and direction vectors. near may be negative to extend the box behind the camera.
+     */
     void setupInternalsOrthographic(float left, float right, float bottom, float top, float near, float far);
 
     void updateCamPosition(Camera &cam);
@@ -29,5 +40,9 @@ public:
 
     bool isPointInside(const vec3 &point) const;
 
+    /**
+     * Conservative test, returns true if the box intersects or is inside the frustum. Only the corner furthest along
+     * each plane's normal is tested, so boxes near frustum edges may still pass.
+     */
     bool isBoxInside(const AABB &box) const;
 };
@@ -32,6 +32,12 @@ private:
     Material &material;
 
 public:
+    /** Forces a detail level of the mesh to be drawn, -1 lets the renderer pick one from the on screen size. */
+    int lodOverride = -1;
+
+    /** Detail level the renderer last picked for this component. */
+    int currentLod = 0;
+
     ModelComponent(Mesh &mesh, Material &material);
 
     void render();
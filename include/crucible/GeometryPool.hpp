@@ -0,0 +1,148 @@
+#pragma once
+
+#include <map>
+#include <cstddef>
+
+/**
+ * Vertex attributes present in a vertex layout. Position is always present.
+ */
+enum VertexLayoutFlags {
+    VERTEX_NORMALS = 1,
+    VERTEX_UVS = 2,
+    VERTEX_TANGENTS = 4,
+    VERTEX_BONE_IDS = 8,
+    VERTEX_BONE_WEIGHTS = 16
+};
+
+/**
+ * Offset based allocator over a linear range, used to sub allocate the pool's buffers. Free ranges are kept sorted by
+ * offset and coalesced with their neighbours when released, allocation picks the smallest range that fits.
+ */
+class RangeAllocator {
+private:
+    std::map<size_t, size_t> freeRanges;
+    size_t capacity = 0;
+    size_t used = 0;
+
+public:
+    /**
+     * Returns the offset of the new range, or (size_t)-1 if no free range is large enough.
+     */
+    size_t allocate(size_t size);
+
+    void free(size_t offset, size_t size);
+
+    /**
+     * Adds newCapacity - capacity units of free space at the end of the range.
+     */
+    void grow(size_t newCapacity);
+
+    size_t getCapacity() const;
+
+    size_t getUsed() const;
+
+    size_t getNumFreeRanges() const;
+};
+
+class GeometryPool;
+
+/**
+ * Layout of one command in an indirect draw buffer, as read by glMultiDrawElementsIndirect.
+ */
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+
+    // in indices, not bytes
+    unsigned int firstIndex;
+    int baseVertex;
+
+    // the renderer stores the draw index here, it reaches the shader through the instanced draw id attribute
+    unsigned int baseInstance;
+};
+
+/**
+ * A mesh's slice of a GeometryPool.
+ */
+struct GeometryAllocation {
+    GeometryPool *pool = nullptr;
+
+    // offset and size in vertices inside the vertex buffer, used as base vertex when drawing
+    unsigned int firstVertex = 0;
+    unsigned int vertexCount = 0;
+
+    // offset and size in bytes inside the element buffer, always 4 byte aligned
+    unsigned int indexOffset = 0;
+    unsigned int indexSize = 0;
+};
+
+/**
+ * Large shared vertex and element buffers for all meshes of one vertex layout. Every mesh in a pool is drawn with the
+ * same VAO, so consecutive draws don't need to rebind any vertex state.
+ */
+class GeometryPool {
+private:
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+
+    int layout;
+    int stride;
+
+    // units are vertices for the vertex buffer and 4 byte words for the element buffer
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    void setupAttributes();
+
+    void growBuffer(unsigned int &buffer, size_t oldBytes, size_t newBytes);
+
+    GeometryPool(int layout);
+
+public:
+    GeometryPool(const GeometryPool &) = delete;
+
+    GeometryPool &operator=(const GeometryPool &) = delete;
+
+    /**
+     * Returns the pool for a vertex layout (a combination of VertexLayoutFlags), creating it on first use.
+     */
+    static GeometryPool &get(int layout);
+
+    static int getStride(int layout);
+
+    /**
+     * Binds a VAO unless it is already bound. All VAO binds should go through here so redundant binds can be skipped.
+     */
+    static void bindVertexArray(unsigned int vao);
+
+    /**
+     * Makes sure the shared draw id buffer holds at least count ids. Every pool VAO reads it as an instanced
+     * uint attribute at location 6, so with baseInstance set to the draw index a shader can identify its draw.
+     */
+    static void reserveDrawIds(unsigned int count);
+
+    /**
+     * Deletes all pools and their buffers.
+     */
+    static void destroyAll();
+
+    /**
+     * Reserves space for vertexCount vertices and indexBytes bytes of index data, growing the buffers if necessary.
+     */
+    GeometryAllocation allocate(unsigned int vertexCount, unsigned int indexBytes);
+
+    void free(GeometryAllocation &allocation);
+
+    void uploadVertices(const GeometryAllocation &allocation, const float *data);
+
+    void uploadIndices(const GeometryAllocation &allocation, const void *data, size_t bytes);
+
+    void bind() const;
+
+    int getLayout() const;
+
+    size_t getVertexBytes() const;
+
+    size_t getIndexBytes() const;
+};
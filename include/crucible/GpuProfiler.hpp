@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Timing of a named GPU scope over the last frames, all times in milliseconds.
+ */
+struct GpuScopeStats {
+    std::string name;
+
+    // nesting depth of the scope when it was first recorded
+    int depth = 0;
+
+    float last = 0.0f;
+    float min = 0.0f;
+    float average = 0.0f;
+    float max = 0.0f;
+
+    // number of frames in the history
+    int samples = 0;
+};
+
+/**
+ * Measures GPU time of named scopes with timestamp queries. Every scope keeps a small ring of queries per frame in
+ * flight and results are only read once the GPU reports them available, so profiling never waits on the GPU. Scopes
+ * can be nested, and a scope entered several times in a frame reports the sum.
+ */
+namespace GpuProfiler {
+    /**
+     * Number of frames kept in the history of every scope.
+     */
+    extern int historyLength;
+
+    /**
+     * Collects finished results and starts a new frame. Renderer::flushToTexture calls this once per frame.
+     */
+    void newFrame();
+
+    void beginScope(const std::string &name);
+
+    void endScope();
+
+    /**
+     * Returns false if no scope of this name was recorded yet.
+     */
+    bool getStats(const std::string &name, GpuScopeStats &stats);
+
+    /**
+     * Stats of every scope, in the order they were first recorded.
+     */
+    std::vector<GpuScopeStats> getAllStats();
+
+    /**
+     * Draws the scope timings as ImGui text inside the current window.
+     */
+    void renderImGui();
+
+    void destroy();
+}
+
+/**
+ * Times the GPU work issued between construction and destruction.
+ */
+class GpuProfileScope {
+public:
+    GpuProfileScope(const std::string &name);
+
+    ~GpuProfileScope();
+};
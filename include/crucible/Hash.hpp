@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * FNV-1a over raw bytes. Used for cache keys and change detection, it's fast but does nothing against deliberate
+ * collisions.
+ */
+namespace Hash {
+    static const unsigned int OFFSET_BASIS = 2166136261u;
+
+    /**
+     * Hashes size bytes at data, continuing from hash. Start a new hash from OFFSET_BASIS.
+     */
+    unsigned int fnv1a(unsigned int hash, const void *data, size_t size);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <crucible/Math.hpp>
+
+class Shader;
+
+/**
+ * Depth pyramid built from the g-buffer. Level 0 has the view distance of every pixel, each level above keeps the
+ * nearest and farthest distance of the 2x2 texels below it (three where the level below has an odd size), so a single
+ * texel tells whether anything in a screen area can be in front of or behind a depth.
+ *
+ * Shaders use it through `#include <hiz>`, which has hierarchical ray tracing for screen space reflections and an
+ * occlusion test for screen rectangles.
+ */
+class HiZBuffer {
+private:
+    unsigned int texture = 0;
+    unsigned int fbo = 0;
+
+    vec2i size;
+    int numLevels = 0;
+
+public:
+    /**
+     * Distance stored for pixels nothing was drawn to.
+     */
+    static const float FAR_DISTANCE;
+
+    void setup(int width, int height);
+
+    void destroy();
+
+    /**
+     * Rebuilds the pyramid from the g-buffer of the renderer.
+     */
+    void build();
+
+    /**
+     * Binds the pyramid to the given unit and sets the uniforms of `#include <hiz>`.
+     */
+    void bind(const Shader &shader, int unit) const;
+
+    unsigned int getID() const;
+
+    vec2i getSize() const;
+
+    int getNumLevels() const;
+};
@@ -1,7 +1,106 @@
 #pragma once
 
 #include <crucible/Texture.hpp>
+#include <crucible/SphericalHarmonics.hpp>
+
+#include <string>
 
 namespace IBL {
+    /**
+     * Directory baked probes are saved to and loaded from, keyed by the scene hash and probe position. Empty disables
+     * the cache.
+     */
+    extern std::string cacheDirectory;
+
+    /**
+     * Captures the scene at position and convolves it all at once. Stalls for as long as six full renders of the scene
+     * take, prefer a Probe baked over several frames at runtime.
+     */
     void generateIBLmaps(const vec3 &position, Cubemap &irradiance, Cubemap &specular);
-}
\ No newline at end of file
+
+    /**
+     * Reads a captured environment back from the GPU, which waits for it to finish rendering, and projects it into
+     * spherical harmonics irradiance on the CPU.
+     */
+    SH9 projectIrradianceSH(const Cubemap &environment, int resolution);
+
+    /**
+     * A light probe baked a step at a time: one captured face, the irradiance convolution, or one prefiltered mip per
+     * step. Probes submitted with Renderer::renderProbe light everything within their radius once baked.
+     *
+     * Probes without specular only keep their irradiance as spherical harmonics, 27 floats once baked, so dense grids
+     * of them cost next to no memory. They light diffuse surfaces only, reflections come from the other probes.
+     */
+    class Probe {
+    private:
+        vec3 position;
+        float radius;
+        bool specularMaps;
+
+        Cubemap environment;
+        Cubemap irradiance;
+        Cubemap specular;
+
+        // convolved into while baking and swapped in at the end, so a rebake never lights with a mix of old and new
+        Cubemap bakingIrradiance;
+        Cubemap bakingSpecular;
+
+        SH9 irradianceSH;
+
+        // next step to run, numSteps once done
+        int step = 0;
+        bool baked = false;
+
+        // scene hash combined with the position, fixed when a bake starts
+        unsigned int cacheKey = 0;
+
+        int getNumSteps() const;
+
+        void runStep(int step);
+
+        std::string getCachePath(const char *suffix) const;
+
+        bool save() const;
+
+        bool load();
+
+    public:
+        Probe(const vec3 &position = vec3(), float radius = 10.0f, bool specular = true);
+
+        /**
+         * Runs bake steps until budget milliseconds of CPU time have passed, at least one. Faces are captured from the
+         * render calls queued so far, so this has to be called between submitting the frame and flushing it. Returns
+         * true once the probe is baked, either by finishing or by loading it from the cache on the first call.
+         */
+        bool bake(float budget = 0.0f);
+
+        /**
+         * Starts baking again from the first face. The previous result keeps lighting the scene meanwhile.
+         */
+        void rebake();
+
+        void destroy();
+
+        bool isBaked() const;
+
+        /**
+         * Fraction of the current bake that is done.
+         */
+        float getProgress() const;
+
+        const vec3 &getPosition() const;
+
+        float getRadius() const;
+
+        bool hasSpecular() const;
+
+        /**
+         * Irradiance of a probe without specular, empty for the others.
+         */
+        const SH9 &getIrradianceSH() const;
+
+        const Cubemap &getIrradiance() const;
+
+        const Cubemap &getSpecular() const;
+    };
+}
@@ -1,9 +1,28 @@
 #pragma once
 
+class AABB;
+
 /**
  * A base class for objects that can be rendered in the render queue pipeline, generally mesh objects.
  */
 class IRenderable {
 public:
     virtual void render() const = 0;
-};
\ No newline at end of file
+
+    /**
+     * Number of detail levels available, level 0 is always full detail.
+     */
+    virtual int getNumLods() const { return 1; }
+
+    /**
+     * Largest object space distance the surface of a detail level deviates from level 0.
+     */
+    virtual float getLodError(int) const { return 0.0f; }
+
+    virtual void renderLod(int) const { render(); }
+
+    /**
+     * Object space bounds of this renderable, or nullptr if they aren't known.
+     */
+    virtual const AABB *getBounds() const { return nullptr; }
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <crucible/Math.hpp>
+
+#include <vector>
+
+class Camera;
+class PointLight;
+class Shader;
+class ShadowAtlas;
+
+/**
+ * Assigns point lights to a 3D grid of clusters over the view frustum: screen space tiles in x and y, exponentially
+ * spaced depth slices in z. The lighting shader only iterates the lights of the cluster a pixel falls into.
+ *
+ * Binning happens on the CPU, one depth slice per task spread over the ThreadPool, testing four lights at a time
+ * against each cluster's view space bounding box with SSE where available.
+ */
+class LightClusters {
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+    static const int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+
+private:
+    unsigned int lightBuffer = 0;
+    unsigned int gridBuffer = 0;
+    unsigned int indexBuffer = 0;
+    unsigned int shadowBuffer = 0;
+
+    unsigned int lightTexture = 0;
+    unsigned int gridTexture = 0;
+    unsigned int indexTexture = 0;
+    unsigned int shadowTexture = 0;
+
+    // view space position and radius, then color and shadow index (or -1), two texels per light
+    std::vector<vec4> lightData;
+
+    // six matrices from view space to shadow atlas coordinates per shadowed light, one column per texel
+    std::vector<float> shadowMatrices;
+
+    // offset into the index list and light count for every cluster
+    std::vector<unsigned int> grid;
+
+    std::vector<unsigned int> indices;
+
+    int numLights = 0;
+    int numIndices = 0;
+
+    float nearPlane = 0.1f;
+    float farPlane = 1000.0f;
+
+public:
+    void setup();
+
+    void destroy();
+
+    /**
+     * Bins the lights against the clusters of the given camera and uploads the result. Lights that have a shadow in
+     * the atlas get their shadow matrices uploaded as well.
+     */
+    void update(const Camera &cam, const std::vector<PointLight*> &lights, const ShadowAtlas *shadows = nullptr);
+
+    /**
+     * Binds the light, cluster, index and shadow matrix buffer textures to four consecutive texture units starting at
+     * firstUnit and sets the uniforms deferred_point.glsl needs.
+     */
+    void bind(const Shader &shader, int firstUnit) const;
+
+    int getNumLights() const;
+
+    /**
+     * Total length of the light index list, the sum of the light counts of all clusters.
+     */
+    int getNumIndices() const;
+};
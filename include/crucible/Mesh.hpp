@@ -5,19 +5,72 @@
 
 #include <crucible/Math.hpp>
 #include <crucible/IRenderable.hpp>
+#include <crucible/AABB.hpp>
+#include <crucible/GeometryPool.hpp>
 
 #include <json.hpp>
 using nlohmann::json;
 
 
+/**
+ * A simplified version of a mesh's index list. It reuses the vertices of the base mesh, error is the largest object
+ * space distance the simplified surface moved from the original.
+ */
+struct MeshLod {
+    std::vector<unsigned int> indices;
+    float error = 0.0f;
+};
+
 class Mesh : public IRenderable {
 private:
-    unsigned int VAO = 0;
-    unsigned int VBO = 0;
-    unsigned int EBO = 0;
+    /**
+     * The GPU side of a mesh. A copy starts out empty and moving hands it over, so no two meshes ever delete the same
+     * buffers or free the same pool range.
+     */
+    struct Buffers {
+        unsigned int VAO = 0;
+        unsigned int VBO = 0;
+        unsigned int EBO = 0;
+
+        // slice of the shared geometry pool this mesh was uploaded to, pool is null for meshes with their own buffers
+        GeometryAllocation allocation;
+
+        Buffers() = default;
+
+        Buffers(const Buffers &other);
+
+        Buffers(Buffers &&other) noexcept;
+
+        /**
+         * Keeps the buffers this side already has, generate() refills them with the copied data.
+         */
+        Buffers &operator=(const Buffers &other);
+
+        /**
+         * Moving replaces the buffers this side had, they are released first.
+         */
+        Buffers &operator=(Buffers &&other) noexcept;
+
+        /**
+         * Frees the pool allocation or deletes the mesh's own buffers, whichever it has.
+         */
+        void release();
+    };
+
+    Buffers buffers;
 
     int length = 0;
 
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, picked in generate() from the vertex count
+    int indexType = 0x1405;
+
+    // element offsets and lengths of each lod inside the shared element buffer, not including the base level
+    std::vector<int> lodOffsets;
+    std::vector<int> lodLengths;
+    std::vector<float> lodErrors;
+
+    AABB bounds;
+
 public:
     std::vector<vec3> positions;
     std::vector<vec2> uvs;
@@ -28,8 +81,17 @@ public:
     std::vector<vec4i> boneIDs;
     std::vector<vec4> boneWeights;
 
+    /** Lower detail index lists, ordered from most to least detailed. Uploaded after the base indices by generate(). */
+    std::vector<MeshLod> lods;
+
     int renderMode = 0x0004;
 
+    /**
+     * If true, generate() puts indexed meshes in the shared GeometryPool of their vertex layout. Meshes that are
+     * regenerated every frame can turn this off to keep their own buffers.
+     */
+    bool pooled = true;
+
     Mesh();
 
     Mesh(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices);
@@ -46,6 +108,7 @@ public:
 
     /**
      * Sends buffered data to OpenGL to make this mesh ready for rendering. (Note this does not clear buffered data as OpenGL still needs it)
+     * Copies of a mesh only take the buffered data and have to be generated themselves, moving one keeps it uploaded.
      */
     void generate();
 
@@ -56,6 +119,36 @@ public:
 
     void render() const;
 
+    int getNumLods() const;
+
+    float getLodError(int lod) const;
+
+    /**
+     * Renders the given detail level, 0 being the base mesh. Levels past the last one are clamped.
+     */
+    void renderLod(int lod) const;
+
+    /**
+     * Object space bounds of the positions, computed in generate().
+     */
+    const AABB *getBounds() const;
+
+    /**
+     * Fills in an indirect draw command for the given detail level. Returns false if this mesh isn't stored in a
+     * GeometryPool and can't be drawn indirectly.
+     */
+    bool getIndirectCommand(int lod, DrawElementsIndirectCommand &command) const;
+
+    /**
+     * The pool this mesh lives in, or nullptr if it owns its buffers.
+     */
+    GeometryPool *getPool() const;
+
+    /**
+     * GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+     */
+    int getIndexType() const;
+
     /**
      *  Deletes mesh handles on OpenGL and local buffer data.
      */
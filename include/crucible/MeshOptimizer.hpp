@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <crucible/Mesh.hpp>
+
+/**
+ * Import time optimizations for indexed triangle meshes. These only reorder data, the rendered result stays the same.
+ */
+namespace MeshOptimizer {
+    struct VertexCacheStats {
+        // average cache miss ratio: transformed vertices per triangle (0.5 is ideal for large grids, 3.0 is worst case)
+        float acmr = 0.0f;
+
+        // average transform to vertex ratio: transformed vertices per unique vertex (1.0 is ideal)
+        float atvr = 0.0f;
+    };
+
+    /**
+     * Simulates a FIFO post-transform cache of cacheSize entries over the index list.
+     */
+    VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = 16);
+
+    /**
+     * Reorders triangles for post-transform cache locality using Tom Forsyth's linear-speed vertex cache algorithm.
+     */
+    void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount);
+
+    /**
+     * Groups cache optimized triangles into clusters at cache flush boundaries and sorts those clusters so
+     * outward facing ones are drawn first, which tends to reduce overdraw without hurting the cache much.
+     * Should be run after optimizeVertexCache.
+     */
+    void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<vec3> &positions, unsigned int cacheSize = 16);
+
+    /**
+     * Reorders the vertex attributes of the mesh to match the order they are first referenced by the index list
+     * and rewrites the indices to match. Vertices that are never referenced are dropped.
+     */
+    void optimizeVertexFetch(Mesh &mesh);
+
+    /**
+     * Runs all of the above on a triangle mesh in the correct order. Does nothing on non indexed or non triangle meshes.
+     */
+    void optimize(Mesh &mesh);
+
+    /**
+     * Reduces a triangle list towards targetIndexCount using quadric error metric half edge collapses. Vertices are never
+     * moved or created so the result indexes the same vertex buffer. Border and attribute seam vertices are locked, and
+     * collapses that would flip a triangle or exceed targetError (an object space distance) are rejected.
+     *
+     * resultError is set to the largest error introduced, in the same units as the positions.
+     */
+    std::vector<unsigned int> simplify(const std::vector<unsigned int> &indices, const std::vector<vec3> &positions, size_t targetIndexCount, float targetError, float *resultError = nullptr);
+
+    /**
+     * Fills mesh.lods with up to maxLods - 1 progressively simplified index lists, each with about reduction times
+     * the triangles of the previous one. Stops early once the simplifier can't make meaningful progress or the error
+     * grows beyond maxError times the mesh's bounding radius.
+     */
+    void generateLods(Mesh &mesh, int maxLods = 4, float reduction = 0.5f, float maxError = 0.1f);
+}
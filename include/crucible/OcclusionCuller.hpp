@@ -0,0 +1,91 @@
+#pragma once
+
+#include <crucible/Math.hpp>
+
+#include <vector>
+
+class AABB;
+class Mesh;
+
+/**
+ * Software occlusion culling. Occluders (walls, floors, or low poly hulls of them) are rasterized on the CPU into a
+ * small depth buffer, then bounding boxes are tested against it: a box whose nearest point is behind the occluders
+ * at every pixel it covers can't be visible.
+ *
+ * Rows are split into bands rasterized on the ThreadPool, four pixels at a time with SSE where available. Nothing here
+ * touches OpenGL.
+ */
+class OcclusionCuller {
+private:
+    struct Triangle {
+        // screen space in buffer pixels and 1/w, which is linear in screen space
+        float x[3];
+        float y[3];
+        float invW[3];
+
+        int minX, maxX, minY, maxY;
+    };
+
+    int width = 0;
+    int height = 0;
+
+    // rows are padded to a multiple of four floats
+    int stride = 0;
+
+    // 1/w of the nearest occluder per pixel, 0 where there is none
+    std::vector<float> depth;
+
+    std::vector<Triangle> triangles;
+
+    mat4 viewProjection;
+
+    int numTested = 0;
+    int numCulled = 0;
+
+    void addTriangle(const vec4 &a, const vec4 &b, const vec4 &c);
+
+    void rasterizeRows(int firstRow, int lastRow);
+
+public:
+    void setup(int width, int height);
+
+    /**
+     * Clears the buffer and occluders for a new frame seen through the given matrix.
+     */
+    void begin(const mat4 &viewProjection);
+
+    void addOccluder(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices, const mat4 &model);
+
+    /**
+     * Uses the CPU side positions and indices of the mesh, which must not have been cleared after upload.
+     */
+    void addOccluder(const Mesh &mesh, const mat4 &model);
+
+    /**
+     * Draws the occluders added since begin into the depth buffer.
+     */
+    void rasterize();
+
+    /**
+     * Whether the box is hidden behind the rasterized occluders. Boxes crossing the near plane are never occluded.
+     */
+    bool isOccluded(const AABB &box);
+
+    int getWidth() const;
+
+    int getHeight() const;
+
+    /**
+     * Depth of a pixel as 1/w of the nearest occluder, 0 if no occluder covers it.
+     */
+    float getDepth(int x, int y) const;
+
+    int getNumOccluderTriangles() const;
+
+    /**
+     * Boxes tested and culled since begin.
+     */
+    int getNumTested() const;
+
+    int getNumCulled() const;
+};
@@ -8,5 +8,10 @@ public:
     vec3 m_color;
     float m_radius;
 
+    /**
+     * Whether this light may be given a cube shadow in the renderer's shadow atlas.
+     */
+    bool m_castShadows = false;
+
     PointLight(vec3 position, vec3 color, float radius);
 };
\ No newline at end of file
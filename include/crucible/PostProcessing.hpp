@@ -4,59 +4,189 @@
 #include <crucible/Camera.hpp>
 #include <crucible/Shader.hpp>
 
+#include <string>
+#include <vector>
+
+/**
+ * One step of the post processing stack. Intermediate framebuffers should come from the FramebufferPool and be
+ * released at the end of postProcess, then steps share memory and don't need to do anything on resize.
+ */
 class PostProcessor {
 public:
+    virtual ~PostProcessor();
+
+    /**
+     * Draws the step on its own. Fusible steps that don't override this run as a pass of one.
+     */
     virtual void postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination);
 
     virtual void resize();
+
+    /**
+     * Steps that only change the color of each pixel return GLSL defining `vec3 STAGE_apply(vec3 color, vec2 texCoord)`
+     * here, along with any uniforms and helpers it uses. Runs of such steps are merged into one generated shader with
+     * STAGE_ replaced by a prefix per step, so they cost a single full screen pass. Empty (the default) if the step
+     * has to run through postProcess.
+     */
+    virtual std::string getFusedSource() const;
+
+    /**
+     * Whether the step reads the pass input `source` somewhere other than at texCoord, or runs passes on it in
+     * prepareFused. Such a step can only be the first of a merged pass.
+     */
+    virtual bool needsSourceTexture() const;
+
+    /**
+     * Runs whatever passes the merged shader depends on, before it is bound.
+     */
+    virtual void prepareFused(const Camera &cam, const Framebuffer &source);
+
+    /**
+     * Sets the step's uniforms on the bound merged shader. Textures are bound from textureUnit up, returns the next
+     * free unit.
+     */
+    virtual int setFusedUniforms(const Shader &shader, const std::string &prefix, int textureUnit);
+
+    /**
+     * Releases anything prepareFused acquired, once the merged pass is drawn.
+     */
+    virtual void finishFused();
+};
+
+/**
+ * One full screen pass of the post processing stack, either a single step that isn't fusible or a run of fusible steps
+ * sharing a generated shader.
+ */
+struct PostProcessPass {
+    std::vector<PostProcessor*> steps;
+    std::vector<std::string> prefixes;
+
+    // null for a step drawn through its own postProcess
+    const Shader *shader = nullptr;
+
+    /**
+     * Draws into destination, or into the window when destination is null. Only merged passes can draw into the window.
+     */
+    void render(const Camera &cam, const Framebuffer &source, const Framebuffer *destination) const;
 };
 
+namespace PostProcessing {
+    /**
+     * Groups steps into as few passes as possible. Generated shaders are cached by their source, so rebuilding after
+     * the stack changed only compiles combinations that weren't seen before.
+     */
+    std::vector<PostProcessPass> buildPasses(const std::vector<PostProcessor*> &steps);
+}
+
 class FxaaPostProcessor: public PostProcessor {
 public:
-    void postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination);
+    std::string getFusedSource() const;
+
+    bool needsSourceTexture() const;
 };
 
 class TonemapPostProcessor: public PostProcessor {
 public:
-    void postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination);
+    std::string getFusedSource() const;
+};
+
+/**
+ * Converts linear color to sRGB. Renderer::flush merges it into the last pass of the stack.
+ */
+class GammaCorrectPostProcessor: public PostProcessor {
+public:
+    std::string getFusedSource() const;
 };
 
+/**
+ * Computes AO at half resolution with a kernel that rotates every frame, accumulates it with the reprojected result of
+ * previous frames and upsamples it with a depth aware filter in the merged pass.
+ */
 class SsaoPostProcessor: public PostProcessor {
-private:
-    Framebuffer ssaoBuffer;
+public:
+    /**
+     * Uniform buffer binding point of the kernel. Resources::init points the block of ssaoShader at it.
+     */
+    static const unsigned int KERNEL_BINDING = 0;
 
+private:
     std::vector<vec3> ssaoKernel;
     Texture noiseTex;
 
+    // uniform buffer holding the whole kernel, uploaded once
+    unsigned int kernelBuffer = 0;
+
+    Framebuffer *ssaoBuffer = nullptr;
+
+    // accumulated AO, the newest first. Kept across frames.
+    Framebuffer *history[2] = {nullptr, nullptr};
+    bool hasHistory = false;
+
+    mat4 previousView;
+    mat4 previousProjection;
+
+    // the upsample rebuilds depth with it in the compact g-buffer layout
+    mat4 inverseProjection;
+
+    int frame = 0;
+
 public:
     float ssaoRadius = 4.0f;
     float strength = 1.0f;
     int ssaoKernelSize = 6;
-    bool highQuality = true;
+
+    // computes AO at full instead of half resolution
+    bool highQuality = false;
+
+    // blend with previous frames, the rotating kernel makes them average out to many more samples
+    bool temporal = true;
+
+    // weight of the current frame in the accumulated AO
+    float temporalBlend = 0.1f;
+
+    // how quickly the upsample stops using samples at other depths than the pixel
+    float depthSharpness = 20.0f;
 
     SsaoPostProcessor();
 
-    virtual void postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination);
+    ~SsaoPostProcessor();
 
-    virtual void resize();
+    std::string getFusedSource() const;
+
+    void prepareFused(const Camera &cam, const Framebuffer &source);
+
+    int setFusedUniforms(const Shader &shader, const std::string &prefix, int textureUnit);
+
+    void finishFused();
 };
 
 
+/**
+ * Downsamples the input through a chain of half resolution levels, then tent filters back up adding each level to the
+ * next larger one. The blur widens with every level at a fixed cost per pixel.
+ */
 class BloomPostProcessor: public PostProcessor {
 private:
-    Framebuffer bloomBuffer0;
-    Framebuffer bloomBuffer1;
-    Framebuffer bloomBuffer2;
-    Framebuffer bloomBuffer3;
-    Framebuffer bloomBuffer4;
-    Framebuffer bloomBuffer5;
+    std::vector<Framebuffer*> levels;
 
 public:
     float bloomStrength = 0.05f;
 
+    // number of half resolution levels, the first is half the render resolution
+    int mipLevels = 6;
+
+    // spread of the upsample filter in texels of the smaller level
+    float upsampleRadius = 1.0f;
+
     BloomPostProcessor();
 
-    virtual void postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination);
+    std::string getFusedSource() const;
 
-    virtual void resize();
+    bool needsSourceTexture() const;
+
+    void prepareFused(const Camera &cam, const Framebuffer &source);
+
+    int setFusedUniforms(const Shader &shader, const std::string &prefix, int textureUnit);
+
+    void finishFused();
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * One timed CPU scope. Names must be string literals or otherwise outlive the profiler, only the pointer is kept.
+ */
+struct ProfileEvent {
+    const char *name;
+
+    // nanoseconds since the profiler started
+    uint64_t start;
+    uint64_t end;
+
+    uint32_t thread;
+    uint32_t depth;
+};
+
+struct ProfileFrame {
+    uint64_t start = 0;
+    uint64_t end = 0;
+
+    // sorted by thread, then start time
+    std::vector<ProfileEvent> events;
+};
+
+/**
+ * Hierarchical CPU profiler. Every thread records into its own ring buffer without taking locks, the buffers are
+ * drained into a ring of recent frames by newFrame. Use the PROFILE_SCOPE and PROFILE_FUNCTION macros to time a
+ * block, they compile to nothing when CRUCIBLE_DISABLE_PROFILER is defined.
+ */
+namespace Profiler {
+    static const int MAX_FRAMES = 64;
+
+    /**
+     * Recording can be switched off at runtime, scopes then cost a single branch.
+     */
+    extern bool enabled;
+
+    /**
+     * Returns nanoseconds since the profiler started.
+     */
+    uint64_t now();
+
+    void record(const char *name, uint64_t start, uint64_t end, uint32_t depth);
+
+    /**
+     * Closes the current frame and starts the next one. Window::begin calls this once per frame.
+     */
+    void newFrame();
+
+    /**
+     * A paused profiler keeps its frames so they can be inspected, new frames are thrown away.
+     */
+    void setPaused(bool paused);
+
+    bool isPaused();
+
+    int getNumFrames();
+
+    /**
+     * Returns a recorded frame, age 0 being the most recently completed one.
+     */
+    const ProfileFrame &getFrame(int age);
+
+    /**
+     * Draws a flame graph of one recorded frame inside the current ImGui window, one lane per thread.
+     */
+    void renderImGui();
+
+    /**
+     * Writes all recorded frames as Chrome trace event JSON, viewable in chrome://tracing or Perfetto.
+     */
+    bool exportChromeTrace(const std::string &path);
+}
+
+/**
+ * Records the time between construction and destruction.
+ */
+class ProfileScope {
+private:
+    const char *name;
+    uint64_t start;
+    uint32_t depth;
+
+public:
+    ProfileScope(const char *name);
+
+    ~ProfileScope();
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifndef CRUCIBLE_DISABLE_PROFILER
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#endif
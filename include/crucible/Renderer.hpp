@@ -13,29 +13,125 @@
 #include <crucible/Model.hpp>
 #include <crucible/DirectionalLight.hpp>
 #include <crucible/PointLight.hpp>
+#include <crucible/HiZBuffer.hpp>
+#include <crucible/OcclusionCuller.hpp>
 
 #include <vector>
 
+namespace IBL {
+    class Probe;
+}
 
 struct RenderCall {
 	const IRenderable *mesh;
 	const Material *material;
 	const Transform *transform;
-	const AABB *aabb;
 	const Bone *bones;
+
+	// world space bounds used for culling, the ones passed to render or else the mesh's own moved by the transform
+	AABB bounds;
+
+	// neither were known, the call is never culled
+	bool hasBounds;
+
+	// forced detail level, or -1 to pick one from the projected size
+	int lodOverride;
+
+	// optional per object storage of the last selected lod, used for hysteresis
+	int *lodState;
+
+	// detail level selected for this frame
+	int lod;
+
+	// drawn in this frame's depth prepass, so the g-buffer pass only has to match its depth
+	bool depthPrepassed;
 };
 
 namespace Renderer {
+    enum PointLightMode {
+        POINT_LIGHTS_AUTO,
+        POINT_LIGHTS_FULLSCREEN,
+        POINT_LIGHTS_VOLUMES
+    };
+
+    enum DepthPrepassMode {
+        DEPTH_PREPASS_AUTO,
+        DEPTH_PREPASS_ALWAYS,
+        DEPTH_PREPASS_NEVER
+    };
+
 	extern DebugRenderer debug;
 
 	extern Cubemap irradiance;
 	extern Cubemap specular;
 
-    extern Framebuffer HDRbuffer;
-    extern Framebuffer HDRbuffer1;
-
     extern std::vector<std::shared_ptr<PostProcessor>> postProcessingStack;
 
+    /**
+     * Largest error in pixels a mesh lod may project to on screen before a more detailed one is used.
+     */
+    extern float lodThreshold;
+
+    /**
+     * Fraction below lodThreshold the error has to fall before switching to a coarser lod, so objects
+     * near a transition distance don't flicker between levels.
+     */
+    extern float lodHysteresis;
+
+    /**
+     * Draws static meshes in the g-buffer and shadow passes with glMultiDrawElementsIndirect when the driver supports
+     * it. Has no effect otherwise.
+     */
+    extern bool useMultiDrawIndirect;
+
+    /**
+     * Tests the bounds of g-buffer draws against the occluders of the frame on the CPU and skips the hidden ones.
+     * Only draws with an AABB are tested, and only when frustum culling is on.
+     */
+    extern bool useOcclusionCulling;
+
+    /**
+     * Allocates the g-buffer without a position target, positions are rebuilt from the depth buffer, and with
+     * octahedral normals in two 16 bit channels. About half the bytes per pixel for every pass that reads it. Takes
+     * effect in init and resize.
+     */
+    extern bool compactGBuffer;
+
+    /**
+     * How deferred point lights are shaded. Full screen shades every light in one clustered pass over the whole screen,
+     * volumes rasterize a bounding sphere per light so each light only costs its screen coverage. Auto picks per light.
+     */
+    extern PointLightMode pointLightMode;
+
+    /**
+     * In auto mode, lights whose projected radius is larger than this fraction of the screen height go through the full
+     * screen pass, smaller ones are drawn as volumes.
+     */
+    extern float lightVolumeThreshold;
+
+    /**
+     * Whether opaque geometry is drawn to depth first, so the g-buffer pass runs its fragment shader once per pixel
+     * instead of once per covering fragment. Auto does it when the estimated overdraw is above depthPrepassThreshold.
+     */
+    extern DepthPrepassMode depthPrepassMode;
+
+    /**
+     * Estimated overdraw of the g-buffer pass, the summed screen coverage of the visible bounding boxes, above which auto
+     * mode uses the depth prepass.
+     */
+    extern float depthPrepassThreshold;
+
+    /**
+     * Width and height of the shadow atlas point light shadows are rendered into. Takes effect in init.
+     */
+    extern int shadowAtlasSize;
+
+    /**
+     * Builds the hi-z pyramid after the geometry pass of every flush, for post processors that read getHiZBuffer().
+     * Off by default, nothing built in reads it, and it costs a pass per mip level.
+     */
+    extern bool buildHiZBuffer;
+
     /**
      * Sets up vital shaders and variables only once at startup.
      */
@@ -53,22 +149,72 @@ namespace Renderer {
     void renderDirectionalLight(DirectionalLight *light);
 
     /**
-     * General purpose abstraction of all render calls to an internal renderer.
+     * General purpose abstraction of all render calls to an internal renderer. Without an aabb the world bounds are
+     * derived from the mesh's bounds and the transform, skinned meshes are only culled with one given.
      */
-    void render(const IRenderable *mesh, const Material *material, const Transform *transform, const AABB *aabb=nullptr, const Bone *bones=nullptr);
+    void render(const IRenderable *mesh, const Material *material, const Transform *transform, const AABB *aabb=nullptr, const Bone *bones=nullptr, int lodOverride=-1, int *lodState=nullptr);
 
     /**
      * Same as the general purpose render command, but accepts Models.
      */
     void render(const Model *model, const Transform *transform, const AABB *aabb=nullptr);
 
+    /**
+     * Adds a mesh to the occluders of the next flush. Occluders are only rasterized into the software depth buffer,
+     * not drawn, so a large simplified hull of an object that is rendered normally works best. The mesh must keep its
+     * CPU side positions and indices.
+     */
+    void renderOccluder(const Mesh *mesh, const Transform *transform);
+
+    void renderOccluder(const Model *model, const Transform *transform);
+
+    /**
+     * Adds a light probe to the next flush. The two baked probes nearest the camera light the scene within their radius,
+     * blended per pixel, and irradiance and specular light everything outside of them. Of the probes without specular
+     * the 16 nearest are blended into the diffuse lighting the same way.
+     */
+    void renderProbe(const IBL::Probe *probe);
+
     void renderSkybox(const Material *material);
 
     void renderToDepth(const Framebuffer &target, const Camera &cam, const Frustum &f, bool doFrustumCulling);
 
+    /**
+     * Renders depth into one rectangle of the target (x, y, width, height), leaving the rest of it untouched.
+     */
+    void renderToDepth(const Framebuffer &target, const vec4i &viewport, const Camera &cam, const Frustum &f, bool doFrustumCulling);
+
+    /**
+     * Hash of everything renderToDepth would draw with the same arguments: meshes, detail levels and transforms. A
+     * depth map can be reused for as long as this stays the same.
+     */
+    unsigned int getShadowCasterHash(const Frustum &f, bool doFrustumCulling);
+
+    /**
+     * Hash of the values the queued frame is made of: mesh bounds, transforms, material uniforms, lights and the clear
+     * color. Unlike getShadowCasterHash it stays the same between launches, textures are not part of it.
+     */
+    unsigned int getSceneHash();
+
 	Cubemap renderToProbe(const vec3 &position);
 
-    void renderToFramebuffer(const Camera &cam, const Frustum &f, bool doFrustumCulling);
+    /**
+     * Renders the queued frame into one face of a cubemap.
+     */
+    void renderToProbe(const vec3 &position, const Cubemap &target, int face, int probeResolution);
+
+    void renderToFramebuffer(const Camera &cam, const Frustum &f, bool doFrustumCulling, bool mainView);
+
+    /**
+     * Whether the g-buffer pass of the queued frame gets a depth prepass. In auto mode this estimates the overdraw from
+     * the bounds of the queued calls, without touching OpenGL.
+     */
+    bool wantsDepthPrepass(const Camera &cam, const Frustum &f, bool doFrustumCulling = true);
+
+    /**
+     * Overdraw estimated by the last auto mode decision.
+     */
+    float getEstimatedOverdraw();
 
 	/**
 	* Flush command with frustum culling disabled.
@@ -86,11 +232,46 @@ namespace Renderer {
 
 	const Texture &flushToTexture(const Camera &cam, const Frustum &f, bool doFrustumCulling = true);
 
-    void renderToFramebuffer(const Camera &cam, const Frustum &f, bool doFrustumCulling = true);
+    /**
+     * Renders the queued frame into the HDR buffer without post processing. Only the main view, which flush renders,
+     * updates the state that is cached between frames, so probes and other extra views should pass false.
+     */
+    void renderToFramebuffer(const Camera &cam, const Frustum &f, bool doFrustumCulling = true, bool mainView = true);
 
     void setClearColor(vec3 color);
 
     vec2i getResolution();
 
     Framebuffer &getGBuffer();
+
+    /**
+     * Binds the g-buffer to four texture units starting at firstUnit and sets the uniforms `#include <gbuffer>` reads,
+     * so shaders work with either layout.
+     */
+    void bindGBuffer(const Shader &shader, int firstUnit = 0);
+
+    bool isGBufferCompact();
+
+    /**
+     * The view space position target, or the depth texture positions are rebuilt from in the compact layout.
+     */
+    const Texture &getGBufferPosition();
+
+    /**
+     * Returns the target the lighting passes render into, before post processing.
+     */
+    Framebuffer &getHDRBuffer();
+
+    /**
+     * Depth pyramid of the last frame's g-buffer, rebuilt right after the geometry pass while buildHiZBuffer is on.
+     * Empty otherwise.
+     */
+    const HiZBuffer &getHiZBuffer();
+
+    /**
+     * Software depth buffer and culling stats of the last g-buffer pass that had occluders.
+     */
+    const OcclusionCuller &getOcclusionCuller();
+
+    bool isMultiDrawIndirectSupported();
 };
@@ -10,34 +10,35 @@ namespace Resources {
     extern Mesh cubemapMesh;
     extern Mesh framebufferMesh;
     extern Mesh spriteMesh;
+    extern Mesh sphereMesh;
 
     extern Shader standardShader;
     extern Shader eq2cubeShader;
     extern Shader cubemapShader;
     extern Shader irradianceShader;
     extern Shader prefilterShader;
-    extern Shader brdfShader;
     extern Shader passthroughShader;
     extern Shader spriteShader;
     extern Shader textShader;
     extern Shader ShadowShader;
+    extern Shader depthPrepassShader;
     extern Shader deferredShader;
     extern Shader deferredAmbientShader;
     extern Shader deferredPointShader;
+    extern Shader deferredPointVolumeShader;
     extern Shader deferredDirectionalShadowShader;
     extern Shader deferredDirectionalShader;
 
     extern Shader debugShader;
     extern Shader particleShader;
 
-    extern Shader tonemapShader;
-    extern Shader fxaaShader;
     extern Shader gaussianBlurShader;
+    extern Shader bloomDownsampleShader;
+    extern Shader bloomUpsampleShader;
     extern Shader ssaoShader;
-    extern Shader ssaoBlurShader;
+    extern Shader ssaoTemporalShader;
     extern Shader ssrShader;
-    extern Shader gammaCorrectShader;
-    extern Shader bloomShader;
+    extern Shader hiZShader;
 
 
 
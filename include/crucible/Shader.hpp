@@ -21,12 +21,23 @@ public:
     // Use the program
     void bind() const;
 
+    unsigned int getID() const;
+
     void uniformMat4(const std::string &location, const mat4 &mat) const;
 
+    void uniformVec2(const std::string &location, const vec2 &vec) const;
+
     void uniformVec3(const std::string &location, const vec3 &vec) const;
 
     void uniformVec4(const std::string &location, const vec4 &vec) const;
 
+    /**
+     * Sets count elements of a uniform array at once, location being the name of the array.
+     */
+    void uniformVec3Array(const std::string &location, const vec3 *values, int count) const;
+
+    void uniformFloatArray(const std::string &location, const float *values, int count) const;
+
     void uniformInt(const std::string &location, int value) const;
 
     void uniformFloat(const std::string &location, float value) const;
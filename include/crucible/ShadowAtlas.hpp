@@ -0,0 +1,125 @@
+#pragma once
+
+#include <crucible/Math.hpp>
+#include <crucible/Framebuffer.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
+
+class Camera;
+class PointLight;
+
+/**
+ * Quadtree allocator for square power of two tiles inside the atlas. Freed tiles are merged back with their three
+ * siblings as soon as all four are free.
+ */
+class ShadowTileAllocator {
+private:
+    int size = 0;
+    int minTileSize = 0;
+
+    // free tile origins for every level, level 0 is the whole atlas
+    std::vector<std::set<std::pair<int, int>>> freeTiles;
+
+    int getLevel(int tileSize) const;
+
+    bool allocateLevel(int level, vec2i &origin);
+
+public:
+    void setup(int size, int minTileSize);
+
+    /**
+     * Returns false if there is no free space for a tile of this size. The tile is x, y, width, height in texels.
+     */
+    bool allocate(int tileSize, vec4i &tile);
+
+    void free(const vec4i &tile);
+
+    int getNumFreeTiles() const;
+};
+
+/**
+ * The cube shadow of one point light, six tiles of the same size.
+ */
+struct PointLightShadow {
+    vec4i tiles[6];
+    int tileSize = 0;
+
+    // projection * view of every cube face
+    mat4 faceMatrices[6];
+
+    // light position and radius and the shadow caster hash the tiles were rendered with
+    vec3 position;
+    float radius = 0.0f;
+    unsigned int casterHash = 0;
+
+    float importance = 0.0f;
+    bool rendered = false;
+};
+
+/**
+ * One large depth texture shared by the shadows of all point lights. Lights are given tiles sized by how large they
+ * are on screen, and only a limited number of them are re-rendered per frame, so the number of shadowed lights can grow
+ * without the cost growing at the same rate. A shadow is re-rendered when its light moves or a caster near it changes.
+ */
+class ShadowAtlas {
+private:
+    Framebuffer framebuffer;
+    ShadowTileAllocator allocator;
+    int size = 0;
+
+    std::map<const PointLight*, PointLightShadow> shadows;
+
+    int numUpdated = 0;
+
+    int getTileSize(float importance) const;
+
+    void renderShadow(const PointLight &light, PointLightShadow &shadow);
+
+public:
+    /**
+     * Number of point light shadows that may be re-rendered per frame. Lights that need an update are handled in order
+     * of importance, the rest keep their old shadow until a later frame.
+     */
+    static int updateBudget;
+
+    /**
+     * Largest number of point lights that get a shadow at once, the most important ones win.
+     */
+    static int maxShadowedLights;
+
+    /**
+     * Tile size used for each cube face of the most important lights, halved for every step down in importance.
+     */
+    static int maxTileSize;
+
+    void setup(int size);
+
+    void destroy();
+
+    /**
+     * Assigns tiles to the shadow casting lights of this frame, frees those of lights that are gone, and re-renders
+     * shadows within the update budget. Must be called after the frame's render calls have been submitted, and only
+     * for the main view: lights are ranked by the camera given here.
+     */
+    void update(const Camera &cam, const std::vector<PointLight*> &lights);
+
+    /**
+     * Returns the shadow of a light if it has one that can be sampled, or nullptr.
+     */
+    const PointLightShadow *getShadow(const PointLight *light) const;
+
+    /**
+     * Matrices that take a view space position to atlas texture coordinates and depth, one for every cube face.
+     */
+    void getShadowMatrices(const PointLightShadow &shadow, const mat4 &inverseView, mat4 matrices[6]) const;
+
+    const Texture &getTexture() const;
+
+    int getSize() const;
+
+    int getNumShadows() const;
+
+    int getNumUpdated() const;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * CRUCIBLE_SSE is defined when SSE intrinsics can be used. Every x86-64 target has them, 32 bit builds need -msse or
+ * /arch:SSE. Code using them keeps a scalar fallback for everything else.
+ */
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CRUCIBLE_SSE
+#endif
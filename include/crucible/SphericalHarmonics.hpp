@@ -0,0 +1,30 @@
+#pragma once
+
+#include <crucible/Math.hpp>
+
+/**
+ * Irradiance as 9 order 2 spherical harmonics coefficients per color channel, 27 floats. The coefficients are already
+ * convolved with the cosine lobe and divided by pi, so evaluating them gives the same value an irradiance cubemap would.
+ */
+struct SH9 {
+    vec3 coefficients[9];
+
+    vec3 evaluate(const vec3 &normal) const;
+};
+
+/**
+ * Projection of captured environments into spherical harmonics on the CPU. Nothing here touches OpenGL.
+ */
+namespace SphericalHarmonics {
+    /**
+     * The 9 basis functions at a normalized direction.
+     */
+    void basis(const vec3 &direction, float out[9]);
+
+    /**
+     * Projects a cubemap given as six faces of size by size RGB floats, in OpenGL face order and with rows starting at
+     * the bottom like glGetTexImage returns them, and convolves it into irradiance. Texels are weighted by their solid
+     * angle, four at a time with SSE where available, and rows are split across the ThreadPool.
+     */
+    SH9 projectIrradiance(const float *const faces[6], int size);
+}
@@ -22,6 +22,13 @@ public:
 	void destroy();
 
 	static void bindNull(unsigned int unit = 0);
+
+	/**
+	 * Reads the texture back from the GPU and writes it to a PNG file, flipped so the first row is the top of the
+	 * image. Values are clamped to [0, 1] and written opaque, gammaCorrect applies the same curve as the final pass
+	 * of Renderer::flush, use it for the linear HDR output of Renderer::flushToTexture.
+	 */
+	bool save(const Path &file, bool gammaCorrect = false) const;
 };
 
 class Cubemap {
@@ -32,7 +39,24 @@ public:
     void load(const Path &file1, const Path &file2, const Path &file3, const Path &file4,
 			  const Path &file5, const Path &file6);
 
-	void loadEquirectangular(const Path &file, int resolution = 512);
+	/**
+	 * Converts an equirectangular HDR image to a cubemap. With cache on, the converted faces are saved next to the image
+	 * with a ".cubemap" extension, and later calls with the same image contents and resolution load those instead of
+	 * decoding and converting it again.
+	 */
+	void loadEquirectangular(const Path &file, int resolution = 512, bool cache = true);
+
+	/**
+	 * Writes the faces of the first mipLevels levels as RGB half floats, ready to upload as they are. key is stored
+	 * along, whatever identifies the source the cubemap was made from.
+	 */
+	bool saveBinary(const Path &file, unsigned int key, int mipLevels = 1) const;
+
+	/**
+	 * Loads a cubemap written by saveBinary into a new texture. Returns false, leaving this cubemap as it was, if the
+	 * file doesn't exist or was saved with a different key.
+	 */
+	bool loadBinary(const Path &file, unsigned int key);
 
     void bind(unsigned int unit = 0) const;
 
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <functional>
+
+/**
+ * Worker threads shared by the CPU side passes, like light binning and occlusion rasterizing. The threads are started
+ * the first time a loop needs them and then sleep between loops, so a parallel loop costs a wake up instead of a
+ * thread creation.
+ */
+namespace ThreadPool {
+    /**
+     * Threads a loop is spread over, the calling one included. 0 picks one per hardware thread.
+     */
+    extern int numThreads;
+
+    /**
+     * How many threads a loop started now would run on.
+     */
+    int getThreadCount();
+
+    /**
+     * Calls task(i) for every i below count and returns once all of them finished. The calling thread works on the
+     * loop too. Loops started from inside a task run on the calling thread alone.
+     */
+    void parallelFor(int count, const std::function<void(int)> &task);
+}
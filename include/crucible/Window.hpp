@@ -15,6 +15,16 @@ public:
 
     static void create(const vec2i &resolution, const std::string &title, bool fullscreen, bool vsync=true);
 
+    /**
+     * Creates an invisible window, rendering goes to its offscreen framebuffer or to framebuffer objects. Meant for
+     * benchmarks and image tests on machines without a monitor, software drivers like Mesa's llvmpipe work as well
+     * (LIBGL_ALWAYS_SOFTWARE=1). GLFW still needs a display server to connect to, use a virtual one such as Xvfb when
+     * there is none.
+     */
+    static void createHeadless(const vec2i &resolution, const std::string &title = "crucible");
+
+    static bool isHeadless();
+
     static bool isOpen();
 
     static void begin();
@@ -30,6 +40,17 @@ public:
 
     static float deltaTime();
 
+    /**
+     * Makes every frame advance getTime and deltaTime by exactly this many seconds, however long it actually took, so
+     * that a run only depends on the number of frames rendered. 0 switches back to the real clock.
+     */
+    static void setFixedTimestep(float seconds);
+
+    /**
+     * Returns the number of frames begun since the window was created.
+     */
+    static int getFrameCount();
+
     /**
      * Returns the window size in pixels.
      */
@@ -39,5 +60,10 @@ public:
 
     static void setMouseGrabbed(bool grabbed);
 
+    /**
+     * Looks up an OpenGL function of the current context, used for functions newer than the loaded GL version.
+     */
+    static void *getProcAddress(const char *name);
+
     static bool getMouseGrabbed();
 };
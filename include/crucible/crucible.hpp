@@ -8,6 +8,8 @@
 #include <crucible/Framebuffer.hpp>
 #include <crucible/Material.hpp>
 #include <crucible/Mesh.hpp>
+#include <crucible/MeshOptimizer.hpp>
+#include <crucible/GeometryPool.hpp>
 #include <crucible/Model.hpp>
 #include <crucible/Primitives.hpp>
 #include <crucible/Renderer.hpp>
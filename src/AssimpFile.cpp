@@ -1,6 +1,7 @@
 #include <crucible/AssimpFile.hpp>
 #include <crucible/Path.hpp>
 #include <crucible/Resources.hpp>
+#include <crucible/MeshOptimizer.hpp>
 
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -182,9 +183,21 @@ void AssimpFile::load(const aiScene *scene, Path workingDirectory) {
             }
         }
 
+        MeshOptimizer::VertexCacheStats before = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.positions.size());
+        MeshOptimizer::optimize(mesh);
+        MeshOptimizer::VertexCacheStats after = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.positions.size());
+
+        std::cout << "optimized mesh " << index << " (" << mesh.indices.size() / 3 << " triangles): ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+        MeshOptimizer::generateLods(mesh);
+
+        for (size_t i = 0; i < mesh.lods.size(); i++) {
+            std::cout << "  lod " << i + 1 << ": " << mesh.lods[i].indices.size() / 3 << " triangles, error " << mesh.lods[i].error << std::endl;
+        }
+
         mesh.generate();
 
-        meshes.push_back(mesh);
+        meshes.push_back(std::move(mesh));
     }
 }
 
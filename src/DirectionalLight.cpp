@@ -3,44 +3,107 @@
 #include <crucible/Resources.hpp>
 #include <crucible/Camera.hpp>
 #include <crucible/Renderer.hpp>
+#include <crucible/Profiler.hpp>
 
 #include <glad/glad.h>
 
-Camera DirectionalLight::getShadowCamera(float radius, const Camera &cam, float depth) {
+#include <algorithm>
+#include <cmath>
+
+// probe faces are small, their shadows don't need the full resolution
+static const int maxProbeShadowResolution = 512;
+
+Camera DirectionalLight::getShadowCamera(float radius, const vec3 &center, float depth) {
     Camera ret;
-    ret.position = cam.getPosition();
+    ret.position = center;
     ret.direction = m_direction;
     ret.up = vec3(0.0f, 1.0f, 0.0f);
     ret.dimensions = vec2(radius*1.01*2.0f, radius*1.01*2.0f);
 
+    // reaches depth units towards the light to catch casters outside the cascade, but stops right behind it
     ret.nearPlane = -depth;
-    ret.farPlane = depth;
+    ret.farPlane = radius*1.01f + getDepthStep(radius);
 
     ret.orthographic = true;
     
     return ret;
 }
 
-Frustum DirectionalLight::getShadowFrustum(float radius, const Camera &cam, float depth) {
+Frustum DirectionalLight::getShadowFrustum(float radius, const vec3 &center, float depth) {
 	Frustum shadowFrustum;
-	shadowFrustum.setupInternalsOrthographic(-radius*1.01, radius*1.01, -radius*1.01, radius*1.01, -depth, depth);
+	shadowFrustum.setupInternalsOrthographic(-radius*1.01, radius*1.01, -radius*1.01, radius*1.01, -depth, radius*1.01f + getDepthStep(radius));
 	Camera shadowCam;
-	shadowCam.setPosition(cam.getPosition());
+	shadowCam.setPosition(center);
 	shadowCam.setDirection(m_direction);
+	shadowCam.up = vec3(0.0f, 1.0f, 0.0f);
 	shadowFrustum.updateCamPosition(shadowCam);
 
 	return shadowFrustum;
 }
 
-void DirectionalLight::setupFramebuffers() {
-    shadowBuffers = {Framebuffer(), Framebuffer(), Framebuffer(), Framebuffer()};
+float DirectionalLight::getCascadeBounds(int cascade, const Camera &cam, vec3 &center) {
+    float splitFar = m_shadowDistances[cascade];
+
+    if (cam.orthographic || cam.dimensions.y <= 0.0f) {
+        center = cam.getPosition();
+        return splitFar;
+    }
 
-    for (int i = 0; i < m_shadowDistances.size(); i++) {
-        shadowBuffers.push_back(Framebuffer());
+    float splitNear = cascade == 0 ? cam.nearPlane : m_shadowDistances[cascade - 1];
 
-        shadowBuffers[i].setup(m_shadowResolution, m_shadowResolution);
-        shadowBuffers[i].attachShadow(m_shadowResolution, m_shadowResolution);
+    // squared slope of the frustum's corner edges, the same at every depth
+    float tanY = std::tan(radians(cam.fov) * 0.5f);
+    float tanX = tanY * cam.dimensions.x / cam.dimensions.y;
+    float k = tanX*tanX + tanY*tanY;
+
+    // smallest sphere through the near and far corners of the slice, centered on the view axis. It only depends on
+    // the split distances and the field of view, so its size doesn't change as the camera turns
+    float distance = (splitNear + splitFar) * (1.0f + k) * 0.5f;
+    float radius;
+
+    if (distance >= splitFar) {
+        distance = splitFar;
+        radius = splitFar * std::sqrt(k);
+    }
+    else {
+        radius = std::sqrt((splitFar - distance)*(splitFar - distance) + splitFar*splitFar*k);
     }
+
+    center = cam.getPosition() + normalize(cam.getDirection()) * distance;
+
+    return radius;
+}
+
+float DirectionalLight::getDepthStep(float radius) {
+    return radius * 0.5f;
+}
+
+vec3 DirectionalLight::getSnappedCenter(float radius, const vec3 &center) {
+    vec3 forward = normalize(m_direction);
+    vec3 right = normalize(cross(forward, vec3(0.0f, 1.0f, 0.0f)));
+    vec3 up = cross(right, forward);
+
+    float texelSize = radius*1.01f*2.0f / (float)m_shadowResolution;
+
+    // depth only needs to stay inside the shadow camera's range, coarse steps keep it from invalidating the cache
+    float depthStep = getDepthStep(radius);
+
+    float x = std::floor(dot(center, right) / texelSize) * texelSize;
+    float y = std::floor(dot(center, up) / texelSize) * texelSize;
+    float z = std::floor(dot(center, forward) / depthStep) * depthStep;
+
+    return right * x + up * y + forward * z;
+}
+
+void DirectionalLight::setupFramebuffers() {
+    m_cascades.resize(m_shadowDistances.size());
+
+    for (size_t i = 0; i < m_cascades.size(); i++) {
+        m_cascades[i].buffer.setup(m_shadowResolution, m_shadowResolution);
+        m_cascades[i].buffer.attachShadow(m_shadowResolution, m_shadowResolution);
+    }
+
+    setCascadeUpdateIntervals(m_updateIntervals);
 }
 
 DirectionalLight::DirectionalLight(vec3 direction, vec3 color) {
@@ -99,21 +162,108 @@ DirectionalLight::DirectionalLight(vec3 direction, vec3 color, int shadowResolut
     m_hasShadows = true;
 
     m_shadowDistances = distances;
-    m_shadowDepth = m_shadowDistances[m_shadowDistances.size()];
+    m_shadowDepth = m_shadowDistances.back();
+}
+
+void DirectionalLight::setCascadeUpdateIntervals(const std::vector<int> &intervals) {
+    m_updateIntervals = intervals;
+
+    for (size_t i = 0; i < m_cascades.size(); i++) {
+        int interval = intervals.empty() ? 1 : intervals[std::min(i, intervals.size() - 1)];
+
+        m_cascades[i].updateInterval = std::max(interval, 1);
+    }
+}
+
+void DirectionalLight::invalidateShadows() {
+    for (size_t i = 0; i < m_cascades.size(); i++) {
+        m_cascades[i].valid = false;
+    }
 }
 
-void DirectionalLight::preRender(const Camera &cam) {
+int DirectionalLight::getNumUpdatedCascades() const {
+    return m_numUpdatedCascades;
+}
+
+void DirectionalLight::renderProbeCascades(const Camera &cam) {
+    if (m_probeCascades.empty()) {
+        int resolution = std::min(m_shadowResolution, maxProbeShadowResolution);
+
+        m_probeCascades.resize(m_shadowDistances.size());
+
+        for (size_t i = 0; i < m_probeCascades.size(); i++) {
+            m_probeCascades[i].buffer.setup(resolution, resolution);
+            m_probeCascades[i].buffer.attachShadow(resolution, resolution);
+        }
+    }
+
+    for (size_t i = 0; i < m_probeCascades.size(); i++) {
+        vec3 center;
+        float radius = getCascadeBounds(i, cam, center);
+
+        Camera shadowCamera = getShadowCamera(radius, center, m_shadowDepth);
+        Frustum shadowFrustum = getShadowFrustum(radius, center, m_shadowDepth);
+
+        Renderer::renderToDepth(m_probeCascades[i].buffer, shadowCamera, shadowFrustum, true);
+
+        m_probeCascades[i].lightSpaceMatrix = shadowCamera.getProjection() * shadowCamera.getView();
+    }
+}
+
+void DirectionalLight::preRender(const Camera &cam, bool mainView) {
+    PROFILE_SCOPE("DirectionalLight::preRender");
+
+    m_renderingProbe = !mainView;
+
     if (m_hasShadows) {
         if (!isFramebufferSetup) {
             setupFramebuffers();
             isFramebufferSetup = true;
         }
 
-        for (int i = 0; i < m_shadowDistances.size(); i++) {
-            Camera shadowCamera = getShadowCamera(m_shadowDistances[i], cam, m_shadowDepth);
-            Frustum shadowFrustum = getShadowFrustum(m_shadowDistances[i], cam, m_shadowDepth);
+        if (!mainView) {
+            renderProbeCascades(cam);
+            return;
+        }
 
-            Renderer::renderToDepth(shadowBuffers[i], shadowCamera, shadowFrustum, false);
+        m_numUpdatedCascades = 0;
+
+        if (!(m_direction == m_cachedDirection)) {
+            invalidateShadows();
+            m_cachedDirection = m_direction;
+        }
+
+        for (size_t i = 0; i < m_cascades.size(); i++) {
+            ShadowCascade &cascade = m_cascades[i];
+            cascade.framesSinceUpdate++;
+
+            if (cascade.valid && cascade.framesSinceUpdate < cascade.updateInterval) {
+                continue;
+            }
+
+            vec3 sphereCenter;
+            float radius = getCascadeBounds(i, cam, sphereCenter);
+
+            vec3 center = getSnappedCenter(radius, sphereCenter);
+
+            Camera shadowCamera = getShadowCamera(radius, center, m_shadowDepth);
+            Frustum shadowFrustum = getShadowFrustum(radius, center, m_shadowDepth);
+
+            unsigned int casterHash = Renderer::getShadowCasterHash(shadowFrustum, true);
+
+            if (cascade.valid && cascade.center == center && cascade.casterHash == casterHash) {
+                continue;
+            }
+
+            Renderer::renderToDepth(cascade.buffer, shadowCamera, shadowFrustum, true);
+
+            cascade.lightSpaceMatrix = shadowCamera.getProjection() * shadowCamera.getView();
+            cascade.center = center;
+            cascade.casterHash = casterHash;
+            cascade.framesSinceUpdate = 0;
+            cascade.valid = true;
+
+            m_numUpdatedCascades++;
         }
     }
 }
@@ -124,15 +274,7 @@ void DirectionalLight::render(const Camera &cam) {
 
         mat4 inverseView = inverse(cam.getView());
 
-        Renderer::getGBuffer().getAttachment(0).bind(0);
-        Renderer::getGBuffer().getAttachment(1).bind(1);
-        Renderer::getGBuffer().getAttachment(2).bind(2);
-        Renderer::getGBuffer().getAttachment(3).bind(3);
-
-        Resources::deferredDirectionalShadowShader.uniformInt("gPosition", 0);
-        Resources::deferredDirectionalShadowShader.uniformInt("gNormal", 1);
-        Resources::deferredDirectionalShadowShader.uniformInt("gAlbedo", 2);
-        Resources::deferredDirectionalShadowShader.uniformInt("gRoughnessMetallic", 3);
+        Renderer::bindGBuffer(Resources::deferredDirectionalShadowShader);
 
         Resources::deferredDirectionalShadowShader.uniformVec3("sun.direction", vec3(vec4(m_direction, 0.0f) * cam.getView()));
         Resources::deferredDirectionalShadowShader.uniformVec3("sun.color", m_color);
@@ -145,13 +287,14 @@ void DirectionalLight::render(const Camera &cam) {
             0.5f, 0.5f, 0.5f, 1.0f
         );
 
+        const std::vector<ShadowCascade> &cascades = m_renderingProbe ? m_probeCascades : m_cascades;
+
         for (int i = 0; i < m_shadowDistances.size(); i++) {
-            shadowBuffers[i].getAttachment(0).bind(8+i);
+            cascades[i].buffer.getAttachment(0).bind(8+i);
             Resources::deferredDirectionalShadowShader.uniformInt("shadowTextures["+std::to_string(i)+"]", 8+i);
 
-            Camera shadowCamera = getShadowCamera(m_shadowDistances[i], cam, m_shadowDepth);
-
-            Resources::deferredDirectionalShadowShader.uniformMat4("lightSpaceMatrix["+std::to_string(i)+"]", biasMatrix * shadowCamera.getProjection() * shadowCamera.getView() * inverseView);
+            // cached cascades are sampled with the matrix they were rendered with, not the current camera's
+            Resources::deferredDirectionalShadowShader.uniformMat4("lightSpaceMatrix["+std::to_string(i)+"]", biasMatrix * cascades[i].lightSpaceMatrix * inverseView);
             Resources::deferredDirectionalShadowShader.uniformFloat("shadowDistances["+std::to_string(i)+"]", m_shadowDistances[i]);
         }
 
@@ -164,15 +307,7 @@ void DirectionalLight::render(const Camera &cam) {
 
         mat4 inverseView = inverse(cam.getView());
 
-        Renderer::getGBuffer().getAttachment(0).bind(0);
-        Renderer::getGBuffer().getAttachment(1).bind(1);
-        Renderer::getGBuffer().getAttachment(2).bind(2);
-        Renderer::getGBuffer().getAttachment(3).bind(3);
-
-        Resources::deferredDirectionalShader.uniformInt("gPosition", 0);
-        Resources::deferredDirectionalShader.uniformInt("gNormal", 1);
-        Resources::deferredDirectionalShader.uniformInt("gAlbedo", 2);
-        Resources::deferredDirectionalShader.uniformInt("gRoughnessMetallic", 3);
+        Renderer::bindGBuffer(Resources::deferredDirectionalShader);
 
         Resources::deferredDirectionalShader.uniformVec3("sun.direction", vec3(vec4(m_direction, 0.0f) * cam.getView()));
         Resources::deferredDirectionalShader.uniformVec3("sun.color", m_color);
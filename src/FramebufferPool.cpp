@@ -0,0 +1,207 @@
+#include <crucible/FramebufferPool.hpp>
+
+#include <glad/glad.h>
+
+#include <list>
+
+struct PoolEntry {
+    FramebufferDesc desc;
+    Framebuffer framebuffer;
+
+    bool acquired = false;
+    bool releaseAtFrameEnd = false;
+    int unusedFrames = 0;
+
+    PoolEntry(const FramebufferDesc &desc): desc(desc) {}
+};
+
+// a list so framebuffer references stay valid while the pool grows. Never destroyed, post processors held in statics
+// give their framebuffers back from their destructors at exit.
+static std::list<PoolEntry> &entries = *new std::list<PoolEntry>();
+
+static size_t getBytesPerPixel(unsigned int internalFormat) {
+    switch (internalFormat) {
+        case GL_RED:
+        case GL_R8:
+            return 1;
+        case GL_RG8:
+        case GL_R16F:
+            return 2;
+        case GL_RGB16F:
+        case GL_RGBA16F:
+        case GL_RG32F:
+            // three channel formats are padded to four by most drivers
+            return 8;
+        case GL_RGB32F:
+        case GL_RGBA32F:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+static size_t getEntryBytes(const FramebufferDesc &desc) {
+    size_t pixelBytes = desc.depthStencil ? 4 : 0;
+
+    for (size_t i = 0; i < desc.attachments.size(); i++) {
+        pixelBytes += getBytesPerPixel(desc.attachments[i].internalFormat);
+    }
+
+    return pixelBytes * desc.width * desc.height;
+}
+
+static PoolEntry &acquireEntry(const FramebufferDesc &desc) {
+    for (PoolEntry &entry : entries) {
+        if (!entry.acquired && entry.desc == desc) {
+            entry.acquired = true;
+            entry.unusedFrames = 0;
+
+            return entry;
+        }
+    }
+
+    entries.push_back(PoolEntry(desc));
+    PoolEntry &entry = entries.back();
+
+    entry.framebuffer.setup(desc.width, desc.height);
+    for (size_t i = 0; i < desc.attachments.size(); i++) {
+        entry.framebuffer.attachTexture(desc.attachments[i].internalFormat, desc.attachments[i].format, desc.attachments[i].type);
+    }
+    if (desc.sampledDepth) {
+        entry.framebuffer.attachDepthTexture();
+    }
+    else if (desc.depthStencil) {
+        entry.framebuffer.attachRBO();
+    }
+
+    entry.acquired = true;
+
+    return entry;
+}
+
+FramebufferDesc::FramebufferDesc(int width, int height) {
+    this->width = width;
+    this->height = height;
+}
+
+FramebufferDesc &FramebufferDesc::color(unsigned int internalFormat, unsigned int format, unsigned int type) {
+    FramebufferFormat f;
+    f.internalFormat = internalFormat;
+    f.format = format;
+    f.type = type;
+
+    attachments.push_back(f);
+
+    return *this;
+}
+
+FramebufferDesc &FramebufferDesc::depth() {
+    depthStencil = true;
+
+    return *this;
+}
+
+FramebufferDesc &FramebufferDesc::depthTexture() {
+    depthStencil = true;
+    sampledDepth = true;
+
+    return *this;
+}
+
+bool FramebufferDesc::operator==(const FramebufferDesc &other) const {
+    if (width != other.width || height != other.height || depthStencil != other.depthStencil || sampledDepth != other.sampledDepth || attachments.size() != other.attachments.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < attachments.size(); i++) {
+        const FramebufferFormat &a = attachments[i];
+        const FramebufferFormat &b = other.attachments[i];
+
+        if (a.internalFormat != b.internalFormat || a.format != b.format || a.type != b.type) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+namespace FramebufferPool {
+    int maxUnusedFrames = 4;
+
+    Framebuffer &acquire(const FramebufferDesc &desc) {
+        PoolEntry &entry = acquireEntry(desc);
+        entry.releaseAtFrameEnd = false;
+
+        return entry.framebuffer;
+    }
+
+    Framebuffer &acquireForFrame(const FramebufferDesc &desc) {
+        PoolEntry &entry = acquireEntry(desc);
+        entry.releaseAtFrameEnd = true;
+
+        return entry.framebuffer;
+    }
+
+    void release(const Framebuffer &framebuffer) {
+        for (PoolEntry &entry : entries) {
+            if (entry.framebuffer.fbo == framebuffer.fbo) {
+                entry.acquired = false;
+                return;
+            }
+        }
+    }
+
+    void newFrame() {
+        for (auto it = entries.begin(); it != entries.end();) {
+            PoolEntry &entry = *it;
+
+            if (entry.acquired && entry.releaseAtFrameEnd) {
+                entry.acquired = false;
+                entry.unusedFrames = 0;
+            }
+            else if (!entry.acquired) {
+                entry.unusedFrames++;
+            }
+
+            if (!entry.acquired && entry.unusedFrames > maxUnusedFrames) {
+                entry.framebuffer.destroy();
+                it = entries.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void destroyAll() {
+        for (PoolEntry &entry : entries) {
+            entry.framebuffer.destroy();
+        }
+
+        entries.clear();
+    }
+
+    int getNumFramebuffers() {
+        return (int)entries.size();
+    }
+
+    int getNumAcquired() {
+        int count = 0;
+
+        for (const PoolEntry &entry : entries) {
+            count += entry.acquired;
+        }
+
+        return count;
+    }
+
+    size_t getMemoryUsage() {
+        size_t bytes = 0;
+
+        for (const PoolEntry &entry : entries) {
+            bytes += getEntryBytes(entry.desc);
+        }
+
+        return bytes;
+    }
+}
@@ -12,15 +12,12 @@ vec3 normFromPoints(vec3 v1, vec3 v2, vec3 v3) {
     return normalize(cross(aux2, aux1));
 }
 
-bool planeCollision(vec3 orig, vec3 norm, vec3 point) {
-    return (dot(point - orig, norm) > 0.0f);
-}
-
 Frustum::Frustum() {
 
 }
 
 void Frustum::setupInternals(float fov, float aspect, float near, float far) {
+    this->orthographic = false;
     this->fov = fov;
     this->aspect = aspect;
     this->near = near;
@@ -34,25 +31,28 @@ void Frustum::setupInternals(float fov, float aspect, float near, float far) {
 }
 
 void Frustum::setupInternalsOrthographic(float left, float right, float bottom, float top, float near, float far) {
+    this->orthographic = true;
     this->near = near;
     this->far = far;
 
-    this->nh = bottom - top;
-    this->nw = right - left;
-    this->fh = bottom - top;
-    this->fw = right - left;
+    // the corners are built from half extents around the view axis, an off center box shifts the axis instead
+    this->nh = (top - bottom) * 0.5f;
+    this->nw = (right - left) * 0.5f;
+    this->fh = nh;
+    this->fw = nw;
+
+    this->orthoOffset = vec2((right + left) * 0.5f, (top + bottom) * 0.5f);
 }
 
 void Frustum::updateCamPosition(Camera &cam) {
-    pos = cam.getPosition();
-    dir = cam.getDirection();
+    dir = normalize(cam.getDirection());
     up = cam.getUp();
     right = cam.getRight();
+    pos = cam.getPosition();
 
-    ntl = cam.getPosition();
-    ntr = cam.getPosition();
-    nbl = cam.getPosition();
-    nbr = cam.getPosition();
+    if (orthographic) {
+        pos = pos + right * orthoOffset.x + up * orthoOffset.y;
+    }
 
     ntl = pos + ((dir * near) + (up * nh) - (right * nw));
     ntr = pos + ((dir * near) + (up * nh) + (right * nw));
@@ -68,6 +68,23 @@ void Frustum::updateCamPosition(Camera &cam) {
     normalLeft = normFromPoints(ntl, nbl, fbl);
     normalTop = normFromPoints(ntr, ntl, ftr);
     normalBottom = normFromPoints(nbl, nbr, fbr);
+
+    vec3 normals[6] = {dir, -dir, normalLeft, normalRight, normalTop, normalBottom};
+    vec3 points[6] = {ntl, ftl, ntl, ntr, ntl, nbl};
+
+    vec3 center = (ntl + ntr + nbl + nbr + ftl + ftr + fbl + fbr) * 0.125f;
+
+    for (int i = 0; i < 6; i++) {
+        vec3 n = normals[i];
+
+        // make sure every normal faces into the volume
+        if (dot(center - points[i], n) < 0.0f) {
+            n = -n;
+        }
+
+        planeNormals[i] = n;
+        planeOffsets[i] = -dot(n, points[i]);
+    }
 }
 
 void Frustum::renderDebug() const {
@@ -94,25 +111,13 @@ void Frustum::renderDebug() const {
 }
 
 bool Frustum::isBoxInside(const AABB &box) const {
-    vec3 sides[5] = {dir, normalRight, normalLeft, normalTop, normalBottom};
-    vec3 offsets[5] = {pos + (dir * near), pos - (right * nw), pos + (right * nw), pos - (up * nh), pos + (up * nh)};
-
-    //bool inside = false;
-
-    for (int i = 0; i < 5; i++) {
-        bool insideSide = false;
+    for (int i = 0; i < 6; i++) {
+        const vec3 &n = planeNormals[i];
 
+        // corner of the box furthest along the plane normal
+        vec3 positive = vec3(n.x >= 0.0f ? box.max.x : box.min.x, n.y >= 0.0f ? box.max.y : box.min.y, n.z >= 0.0f ? box.max.z : box.min.z);
 
-        for (int j = 0; j < 8; j++) {
-
-            vec3 point = box.getCorner(j);
-
-            if (planeCollision(offsets[i], sides[i], point)) {
-                insideSide = true;
-            }
-        }
-
-        if (!insideSide) {
+        if (dot(n, positive) + planeOffsets[i] < 0.0f) {
             return false;
         }
     }
@@ -121,11 +126,8 @@ bool Frustum::isBoxInside(const AABB &box) const {
 }
 
 bool Frustum::isPointInside(const vec3 &point) const {
-    vec3 sides[5] = {dir, normalRight, normalLeft, normalTop, normalBottom};
-    vec3 offsets[5] = {nbl, nbr, ntl, ntr, nbl};
-
-    for (int i = 0; i < 5; i++) {
-        if (!planeCollision(offsets[i], sides[i], point)) {
+    for (int i = 0; i < 6; i++) {
+        if (dot(planeNormals[i], point) + planeOffsets[i] < 0.0f) {
             return false;
         }
     }
@@ -0,0 +1,336 @@
+#include <crucible/GeometryPool.hpp>
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+static std::map<int, GeometryPool*> pools;
+
+static unsigned int boundVAO = 0;
+
+static unsigned int drawIdBuffer = 0;
+static unsigned int drawIdCapacity = 0;
+
+// initial pool sizes, 64k vertices and 256k 16 bit indices
+static const size_t initialVertexCapacity = 65536;
+static const size_t initialIndexCapacity = 65536 * 2;
+
+size_t RangeAllocator::allocate(size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    auto best = freeRanges.end();
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second >= size && (best == freeRanges.end() || it->second < best->second)) {
+            best = it;
+
+            if (it->second == size) break;
+        }
+    }
+
+    if (best == freeRanges.end()) {
+        return (size_t)-1;
+    }
+
+    size_t offset = best->first;
+    size_t remaining = best->second - size;
+
+    freeRanges.erase(best);
+
+    if (remaining > 0) {
+        freeRanges[offset + size] = remaining;
+    }
+
+    used += size;
+
+    return offset;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    used -= size;
+
+    auto next = freeRanges.lower_bound(offset);
+
+    // merge with the following range
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    // merge with the preceding range
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+
+    freeRanges[offset] = size;
+}
+
+void RangeAllocator::grow(size_t newCapacity) {
+    if (newCapacity <= capacity) {
+        return;
+    }
+
+    size_t oldCapacity = capacity;
+    capacity = newCapacity;
+
+    // free() merges the new space with a free range at the end, it doesn't count as used space
+    used += newCapacity - oldCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+size_t RangeAllocator::getCapacity() const {
+    return capacity;
+}
+
+size_t RangeAllocator::getUsed() const {
+    return used;
+}
+
+size_t RangeAllocator::getNumFreeRanges() const {
+    return freeRanges.size();
+}
+
+// ------------------------------------------------------------------------------------------------
+
+GeometryPool::GeometryPool(int layout) {
+    this->layout = layout;
+    this->stride = getStride(layout);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    vertexRanges.grow(initialVertexCapacity);
+    indexRanges.grow(initialIndexCapacity);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexRanges.getCapacity() * stride, NULL, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexRanges.getCapacity() * 4, NULL, GL_STATIC_DRAW);
+
+    setupAttributes();
+}
+
+void GeometryPool::setupAttributes() {
+    bindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // same attribute locations and interleaving as Mesh::generate
+    long offset = 0;
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+    offset += 3 * sizeof(float);
+
+    if (layout & VERTEX_NORMALS) {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 3 * sizeof(float);
+    }
+    if (layout & VERTEX_UVS) {
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 2 * sizeof(float);
+    }
+    if (layout & VERTEX_TANGENTS) {
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 3 * sizeof(float);
+    }
+    if (layout & VERTEX_BONE_IDS) {
+        glEnableVertexAttribArray(4);
+        glVertexAttribIPointer(4, 4, GL_INT, stride, (GLvoid*)offset);
+        offset += 4 * sizeof(float);
+    }
+    if (layout & VERTEX_BONE_WEIGHTS) {
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 4 * sizeof(float);
+    }
+
+    if (drawIdBuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glEnableVertexAttribArray(6);
+        glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, 0, (GLvoid*)0);
+        glVertexAttribDivisor(6, 1);
+    }
+}
+
+void GeometryPool::growBuffer(unsigned int &buffer, size_t oldBytes, size_t newBytes) {
+    unsigned int newBuffer;
+    glGenBuffers(1, &newBuffer);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+}
+
+GeometryPool &GeometryPool::get(int layout) {
+    auto it = pools.find(layout);
+
+    if (it == pools.end()) {
+        it = pools.insert(std::make_pair(layout, new GeometryPool(layout))).first;
+    }
+
+    return *it->second;
+}
+
+int GeometryPool::getStride(int layout) {
+    int stride = 3 * sizeof(float);
+
+    if (layout & VERTEX_NORMALS) stride += 3 * sizeof(float);
+    if (layout & VERTEX_UVS) stride += 2 * sizeof(float);
+    if (layout & VERTEX_TANGENTS) stride += 3 * sizeof(float);
+    if (layout & VERTEX_BONE_IDS) stride += 4 * sizeof(float);
+    if (layout & VERTEX_BONE_WEIGHTS) stride += 4 * sizeof(float);
+
+    return stride;
+}
+
+void GeometryPool::bindVertexArray(unsigned int vao) {
+    if (vao != boundVAO) {
+        glBindVertexArray(vao);
+        boundVAO = vao;
+    }
+}
+
+void GeometryPool::reserveDrawIds(unsigned int count) {
+    if (count <= drawIdCapacity) {
+        return;
+    }
+
+    drawIdCapacity = std::max(count, std::max(drawIdCapacity * 2, 1024u));
+
+    std::vector<unsigned int> ids(drawIdCapacity);
+    for (unsigned int i = 0; i < drawIdCapacity; i++) {
+        ids[i] = i;
+    }
+
+    if (!drawIdBuffer) {
+        glGenBuffers(1, &drawIdBuffer);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, drawIdBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, ids.size() * sizeof(unsigned int), &ids[0], GL_STATIC_DRAW);
+
+    for (auto &pair : pools) {
+        pair.second->setupAttributes();
+    }
+}
+
+void GeometryPool::destroyAll() {
+    bindVertexArray(0);
+
+    for (auto &pair : pools) {
+        GeometryPool *pool = pair.second;
+
+        glDeleteVertexArrays(1, &pool->VAO);
+        glDeleteBuffers(1, &pool->VBO);
+        glDeleteBuffers(1, &pool->EBO);
+
+        delete pool;
+    }
+
+    pools.clear();
+
+    if (drawIdBuffer) {
+        glDeleteBuffers(1, &drawIdBuffer);
+        drawIdBuffer = 0;
+        drawIdCapacity = 0;
+    }
+}
+
+GeometryAllocation GeometryPool::allocate(unsigned int vertexCount, unsigned int indexBytes) {
+    GeometryAllocation allocation;
+    allocation.pool = this;
+    allocation.vertexCount = vertexCount;
+    allocation.indexSize = indexBytes;
+
+    size_t indexWords = (indexBytes + 3) / 4;
+
+    size_t firstVertex = vertexRanges.allocate(vertexCount);
+    if (firstVertex == (size_t)-1) {
+        size_t oldCapacity = vertexRanges.getCapacity();
+        size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + vertexCount);
+
+        growBuffer(VBO, oldCapacity * stride, newCapacity * stride);
+        vertexRanges.grow(newCapacity);
+        setupAttributes();
+
+        firstVertex = vertexRanges.allocate(vertexCount);
+    }
+
+    size_t indexOffset = indexRanges.allocate(indexWords);
+    if (indexOffset == (size_t)-1) {
+        size_t oldCapacity = indexRanges.getCapacity();
+        size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + indexWords);
+
+        growBuffer(EBO, oldCapacity * 4, newCapacity * 4);
+        indexRanges.grow(newCapacity);
+        setupAttributes();
+
+        indexOffset = indexRanges.allocate(indexWords);
+    }
+
+    allocation.firstVertex = (unsigned int)firstVertex;
+    allocation.indexOffset = (unsigned int)(indexOffset * 4);
+
+    return allocation;
+}
+
+void GeometryPool::free(GeometryAllocation &allocation) {
+    if (allocation.pool != this) {
+        return;
+    }
+
+    vertexRanges.free(allocation.firstVertex, allocation.vertexCount);
+    indexRanges.free(allocation.indexOffset / 4, (allocation.indexSize + 3) / 4);
+
+    allocation = GeometryAllocation();
+}
+
+void GeometryPool::uploadVertices(const GeometryAllocation &allocation, const float *data) {
+    // the copy targets don't touch VAO state, unlike GL_ELEMENT_ARRAY_BUFFER
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.firstVertex * stride, (GLsizeiptr)allocation.vertexCount * stride, data);
+}
+
+void GeometryPool::uploadIndices(const GeometryAllocation &allocation, const void *data, size_t bytes) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexOffset, std::min(bytes, (size_t)allocation.indexSize), data);
+}
+
+void GeometryPool::bind() const {
+    bindVertexArray(VAO);
+}
+
+int GeometryPool::getLayout() const {
+    return layout;
+}
+
+size_t GeometryPool::getVertexBytes() const {
+    return vertexRanges.getCapacity() * stride;
+}
+
+size_t GeometryPool::getIndexBytes() const {
+    return indexRanges.getCapacity() * 4;
+}
@@ -0,0 +1,248 @@
+#include <crucible/GpuProfiler.hpp>
+
+#include <glad/glad.h>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <map>
+
+// frames that may be in flight before a scope has to skip a frame instead of waiting on old results
+static const int FRAMES_IN_FLIGHT = 4;
+
+struct ScopeFrame {
+    // start and end timestamp pairs, one per time the scope was entered this frame
+    std::vector<GLuint> queries;
+    int used = 0;
+    bool pending = false;
+    bool skipped = false;
+};
+
+struct Scope {
+    std::string name;
+    int depth = 0;
+
+    ScopeFrame frames[FRAMES_IN_FLIGHT];
+
+    // ring buffer of results in milliseconds
+    std::vector<float> history;
+    int historyStart = 0;
+    int numSamples = 0;
+};
+
+static std::vector<Scope> scopes;
+static std::map<std::string, int> scopeIndices;
+
+// scope index and query pair of every open scope, query -1 when the frame was skipped
+static std::vector<std::pair<int, int>> stack;
+
+static int currentFrame = 0;
+
+static void addSample(Scope &scope, float ms) {
+    int length = std::max(GpuProfiler::historyLength, 1);
+
+    if ((int)scope.history.size() != length) {
+        scope.history.assign(length, 0.0f);
+        scope.historyStart = 0;
+        scope.numSamples = 0;
+    }
+
+    scope.history[(scope.historyStart + scope.numSamples) % length] = ms;
+
+    if (scope.numSamples < length) {
+        scope.numSamples++;
+    }
+    else {
+        scope.historyStart = (scope.historyStart + 1) % length;
+    }
+}
+
+static void collect(Scope &scope, ScopeFrame &frame) {
+    if (!frame.pending) {
+        return;
+    }
+
+    // timestamps complete in order, the last one being available means all of them are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.used * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available) {
+        return;
+    }
+
+    GLuint64 total = 0;
+
+    for (int i = 0; i < frame.used; i++) {
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        if (end > start) {
+            total += end - start;
+        }
+    }
+
+    addSample(scope, (float)((double)total * 0.000001));
+
+    frame.pending = false;
+    frame.used = 0;
+}
+
+static GpuScopeStats getScopeStats(const Scope &scope) {
+    GpuScopeStats stats;
+    stats.name = scope.name;
+    stats.depth = scope.depth;
+    stats.samples = scope.numSamples;
+
+    if (scope.numSamples == 0) {
+        return stats;
+    }
+
+    int length = (int)scope.history.size();
+
+    stats.min = scope.history[scope.historyStart];
+    stats.max = stats.min;
+
+    float sum = 0.0f;
+    for (int i = 0; i < scope.numSamples; i++) {
+        float sample = scope.history[(scope.historyStart + i) % length];
+
+        stats.min = std::min(stats.min, sample);
+        stats.max = std::max(stats.max, sample);
+        sum += sample;
+    }
+
+    stats.average = sum / (float)scope.numSamples;
+    stats.last = scope.history[(scope.historyStart + scope.numSamples - 1) % length];
+
+    return stats;
+}
+
+namespace GpuProfiler {
+    int historyLength = 120;
+
+    void newFrame() {
+        // scopes left open by the previous frame can't be matched up anymore
+        while (!stack.empty()) {
+            endScope();
+        }
+
+        currentFrame = (currentFrame + 1) % FRAMES_IN_FLIGHT;
+
+        for (size_t i = 0; i < scopes.size(); i++) {
+            Scope &scope = scopes[i];
+
+            // oldest frame first so the history stays in order
+            for (int j = 1; j <= FRAMES_IN_FLIGHT; j++) {
+                collect(scope, scope.frames[(currentFrame + j) % FRAMES_IN_FLIGHT]);
+            }
+
+            // the GPU is more than FRAMES_IN_FLIGHT frames behind, skip this frame rather than stall on its queries
+            ScopeFrame &frame = scope.frames[currentFrame];
+            frame.skipped = frame.pending;
+        }
+    }
+
+    void beginScope(const std::string &name) {
+        auto it = scopeIndices.find(name);
+
+        if (it == scopeIndices.end()) {
+            Scope scope;
+            scope.name = name;
+            scope.depth = (int)stack.size();
+
+            scopes.push_back(scope);
+            it = scopeIndices.insert(std::make_pair(name, (int)scopes.size() - 1)).first;
+        }
+
+        ScopeFrame &frame = scopes[it->second].frames[currentFrame];
+
+        if (frame.skipped) {
+            stack.push_back(std::make_pair(it->second, -1));
+            return;
+        }
+
+        if ((int)frame.queries.size() < (frame.used + 1) * 2) {
+            frame.queries.resize((frame.used + 1) * 2);
+            glGenQueries(2, &frame.queries[frame.used * 2]);
+        }
+
+        glQueryCounter(frame.queries[frame.used * 2], GL_TIMESTAMP);
+
+        stack.push_back(std::make_pair(it->second, frame.used));
+        frame.used++;
+    }
+
+    void endScope() {
+        if (stack.empty()) {
+            return;
+        }
+
+        std::pair<int, int> open = stack.back();
+        stack.pop_back();
+
+        if (open.second < 0) {
+            return;
+        }
+
+        ScopeFrame &frame = scopes[open.first].frames[currentFrame];
+
+        glQueryCounter(frame.queries[open.second * 2 + 1], GL_TIMESTAMP);
+        frame.pending = true;
+    }
+
+    bool getStats(const std::string &name, GpuScopeStats &stats) {
+        auto it = scopeIndices.find(name);
+
+        if (it == scopeIndices.end()) {
+            return false;
+        }
+
+        stats = getScopeStats(scopes[it->second]);
+
+        return true;
+    }
+
+    std::vector<GpuScopeStats> getAllStats() {
+        std::vector<GpuScopeStats> stats;
+
+        for (size_t i = 0; i < scopes.size(); i++) {
+            stats.push_back(getScopeStats(scopes[i]));
+        }
+
+        return stats;
+    }
+
+    void renderImGui() {
+        for (size_t i = 0; i < scopes.size(); i++) {
+            GpuScopeStats stats = getScopeStats(scopes[i]);
+
+            ImGui::Text("%*s%s: %.2f ms (min %.2f, avg %.2f, max %.2f)", stats.depth * 2, "", stats.name.c_str(), stats.last, stats.min, stats.average, stats.max);
+        }
+    }
+
+    void destroy() {
+        for (size_t i = 0; i < scopes.size(); i++) {
+            for (int j = 0; j < FRAMES_IN_FLIGHT; j++) {
+                std::vector<GLuint> &queries = scopes[i].frames[j].queries;
+
+                if (!queries.empty()) {
+                    glDeleteQueries((GLsizei)queries.size(), &queries[0]);
+                }
+            }
+        }
+
+        scopes.clear();
+        scopeIndices.clear();
+        stack.clear();
+    }
+}
+
+GpuProfileScope::GpuProfileScope(const std::string &name) {
+    GpuProfiler::beginScope(name);
+}
+
+GpuProfileScope::~GpuProfileScope() {
+    GpuProfiler::endScope();
+}
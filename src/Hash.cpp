@@ -0,0 +1,14 @@
+#include <crucible/Hash.hpp>
+
+namespace Hash {
+    unsigned int fnv1a(unsigned int hash, const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char*)data;
+
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+}
@@ -0,0 +1,100 @@
+#include <crucible/HiZBuffer.hpp>
+#include <crucible/Shader.hpp>
+#include <crucible/Resources.hpp>
+#include <crucible/Renderer.hpp>
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+// must match hiz.glsl and hiZBuild.glsl
+const float HiZBuffer::FAR_DISTANCE = 1.0e20f;
+
+void HiZBuffer::setup(int width, int height) {
+    size = vec2i(std::max(width, 1), std::max(height, 1));
+
+    numLevels = 1;
+    while ((std::max(size.x, size.y) >> numLevels) > 0) {
+        numLevels++;
+    }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    vec2i levelSize = size;
+    for (int i = 0; i < numLevels; i++) {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RG32F, levelSize.x, levelSize.y, 0, GL_RG, GL_FLOAT, nullptr);
+        levelSize = vec2i(std::max(levelSize.x / 2, 1), std::max(levelSize.y / 2, 1));
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+
+    glGenFramebuffers(1, &fbo);
+}
+
+void HiZBuffer::destroy() {
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    texture = 0;
+    fbo = 0;
+    numLevels = 0;
+}
+
+void HiZBuffer::build() {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    Resources::hiZShader.bind();
+    Resources::hiZShader.uniformInt("source", 0);
+    Renderer::bindGBuffer(Resources::hiZShader, 1);
+
+    vec2i levelSize = size;
+    for (int level = 0; level < numLevels; level++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        glViewport(0, 0, levelSize.x, levelSize.y);
+
+        if (level > 0) {
+            // only the level below may be sampled while this one is written
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+
+        Resources::hiZShader.uniformBool("firstLevel", level == 0);
+        Resources::framebufferMesh.render();
+
+        levelSize = vec2i(std::max(levelSize.x / 2, 1), std::max(levelSize.y / 2, 1));
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+}
+
+void HiZBuffer::bind(const Shader &shader, int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    shader.uniformInt("hiZ", unit);
+    shader.uniformInt("hiZLevels", numLevels);
+}
+
+unsigned int HiZBuffer::getID() const {
+    return texture;
+}
+
+vec2i HiZBuffer::getSize() const {
+    return size;
+}
+
+int HiZBuffer::getNumLevels() const {
+    return numLevels;
+}
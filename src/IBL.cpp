@@ -4,126 +4,376 @@
 #include <crucible/Mesh.hpp>
 #include <crucible/Texture.hpp>
 #include <crucible/Resources.hpp>
+#include <crucible/GpuProfiler.hpp>
+#include <crucible/Profiler.hpp>
+#include <crucible/Hash.hpp>
 
 #include <glad/glad.h>
 
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static const int environmentResolution = 128;
+static const int irradianceResolution = 32;
+static const int prefilterResolution = 128;
+static const int prefilterMipLevels = 5;
+
+// six captured faces, the irradiance convolution, then one step per prefiltered mip
+static const int captureSteps = 6;
+
+static const unsigned int cacheMagic = 0x42505243; // "CRPB"
+static const unsigned int cacheVersion = 1;
+
+static mat4 captureProjection = perspective(90.0f, 1.0f, 0.1f, 10.0f);
+static mat4 captureViews[] =
+        {
+                LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
+                LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
+                LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  1.0f,  0.0f), vec3(0.0f,  0.0f,  1.0f)),
+                LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f), vec3(0.0f,  0.0f, -1.0f)),
+                LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f,  1.0f), vec3(0.0f, -1.0f,  0.0f)),
+                LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f, -1.0f), vec3(0.0f, -1.0f,  0.0f))
+        };
+
+static unsigned int createCubemap(int resolution, bool mipmapped) {
+    unsigned int id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, resolution, resolution, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (mipmapped) {
+        // allocates the memory of every mip level
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    }
+
+    return id;
+}
+
+/**
+ * Renders the six faces of one mip of target with a shader that samples environment through the capture views.
+ */
+static void renderCubemapFaces(const Shader &shader, const Cubemap &environment, const Cubemap &target, int resolution, int mip) {
+    unsigned int captureFBO;
+    glGenFramebuffers(1, &captureFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glViewport(0, 0, resolution, resolution);
+
+    shader.bind();
+    shader.uniformInt("environmentMap", 0);
+    shader.uniformMat4("projection", captureProjection);
+    environment.bind(0);
+
+    glDisable(GL_DEPTH_TEST);
+
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        shader.uniformMat4("view", captureViews[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, target.getID(), mip);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        Resources::cubemapMesh.render();
+    }
+
+    glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &captureFBO);
+}
+
+static void convolveIrradiance(const Cubemap &environment, const Cubemap &irradiance) {
+    renderCubemapFaces(Resources::irradianceShader, environment, irradiance, irradianceResolution, 0);
+}
+
+static void deleteCubemap(Cubemap &cubemap) {
+    unsigned int id = cubemap.getID();
+
+    if (id) {
+        glDeleteTextures(1, &id);
+    }
+
+    cubemap.setID(0);
+}
+
+static void prefilterMip(const Cubemap &environment, const Cubemap &specular, int mip) {
+    float roughness = (float)mip / (float)(prefilterMipLevels - 1);
+
+    Resources::prefilterShader.bind();
+    Resources::prefilterShader.uniformFloat("roughness", roughness);
+
+    renderCubemapFaces(Resources::prefilterShader, environment, specular, prefilterResolution >> mip, mip);
+}
+
 namespace IBL {
+    std::string cacheDirectory;
+
     void generateIBLmaps(const vec3 &position, Cubemap &irradiance, Cubemap &specular) {
-        static const int resolution = 512;
-
-        static mat4 captureProjection = perspective(90.0f, 1.0f, 0.1f, 10.0f);
-        static mat4 captureViews[] =
-                {
-                        LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
-                        LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
-                        LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  1.0f,  0.0f), vec3(0.0f,  0.0f,  1.0f)),
-                        LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f), vec3(0.0f,  0.0f, -1.0f)),
-                        LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f,  1.0f), vec3(0.0f, -1.0f,  0.0f)),
-                        LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f, -1.0f), vec3(0.0f, -1.0f,  0.0f))
-                };
-
-        unsigned int captureFBO, captureRBO;
-        glGenFramebuffers(1, &captureFBO);
-        glGenRenderbuffers(1, &captureRBO);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, resolution, resolution);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+        PROFILE_SCOPE("IBL::generateIBLmaps");
 
         Cubemap environment = Renderer::renderToProbe(position);
 
+        Cubemap irradianceMap;
+        irradianceMap.setID(createCubemap(irradianceResolution, false));
+        convolveIrradiance(environment, irradianceMap);
 
-        // create the irradiance map from the captured environment map
-        unsigned int irradianceMap;
-        glGenTextures(1, &irradianceMap);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-        for (unsigned int i = 0; i < 6; ++i)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0,
-                         GL_RGB, GL_FLOAT, nullptr);
-        }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-        Resources::irradianceShader.bind();
-        Resources::irradianceShader.uniformMat4("projection", captureProjection);
-       environment.bind();
-
-        glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        for (unsigned int i = 0; i < 6; ++i)
-        {
-            Resources::irradianceShader.uniformMat4("view", captureViews[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                                   GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        Cubemap prefilterMap;
+        prefilterMap.setID(createCubemap(prefilterResolution, true));
+        for (int mip = 0; mip < prefilterMipLevels; mip++) {
+            prefilterMip(environment, prefilterMap, mip);
+        }
 
-            Resources::cubemapMesh.render();
+        deleteCubemap(environment);
+
+        irradiance.setID(irradianceMap.getID());
+        specular.setID(prefilterMap.getID());
+    }
+
+    SH9 projectIrradianceSH(const Cubemap &environment, int resolution) {
+        PROFILE_SCOPE("IBL::projectIrradianceSH");
+
+        std::vector<float> faces[6];
+        const float *faceData[6];
+
+        glBindTexture(GL_TEXTURE_CUBE_MAP, environment.getID());
+        for (int i = 0; i < 6; i++) {
+            faces[i].resize(resolution * resolution * 3);
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, GL_FLOAT, faces[i].data());
+
+            faceData[i] = faces[i].data();
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // generate prefilter cubemap
+        return SphericalHarmonics::projectIrradiance(faceData, resolution);
+    }
 
-        // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
-        // --------------------------------------------------------------------------------
-        unsigned int prefilterMap;
-        glGenTextures(1, &prefilterMap);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-        for (unsigned int i = 0; i < 6; ++i)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
-        }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minifcation filter to mip_linear
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
-        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    Probe::Probe(const vec3 &position, float radius, bool specular) : position(position), radius(radius), specularMaps(specular) {
 
-        Resources::prefilterShader.bind();
-        Resources::prefilterShader.uniformInt("environmentMap", 0);
-        Resources::prefilterShader.uniformMat4("projection", captureProjection);
-        glActiveTexture(GL_TEXTURE0);
-        environment.bind();
+    }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        unsigned int maxMipLevels = 5;
-        for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
-        {
-            // reisze framebuffer according to mip-level size.
-            unsigned int mipWidth = 128 * std::pow(0.5, mip);
-            unsigned int mipHeight = 128 * std::pow(0.5, mip);
-            glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-            glViewport(0, 0, mipWidth, mipHeight);
-
-            float roughness = (float)mip / (float)(maxMipLevels - 1);
-            Resources::prefilterShader.uniformFloat("roughness", roughness);
-            for (unsigned int i = 0; i < 6; ++i)
-            {
-                Resources::prefilterShader.uniformMat4("view", captureViews[i]);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                                       GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
-
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                Resources::cubemapMesh.render();
+    int Probe::getNumSteps() const {
+        return specularMaps ? captureSteps + 1 + prefilterMipLevels : captureSteps + 1;
+    }
+
+    void Probe::runStep(int step) {
+        if (step < captureSteps) {
+            Renderer::renderToProbe(position, environment, step, environmentResolution);
+        }
+        else if (step == captureSteps && !specularMaps) {
+            irradianceSH = projectIrradianceSH(environment, environmentResolution);
+        }
+        else if (step == captureSteps) {
+            convolveIrradiance(environment, bakingIrradiance);
+        }
+        else {
+            prefilterMip(environment, bakingSpecular, step - captureSteps - 1);
+        }
+    }
+
+    std::string Probe::getCachePath(const char *suffix) const {
+        char name[32];
+        snprintf(name, sizeof(name), "probe_%08x", cacheKey);
+
+        if (cacheDirectory.back() == '/' || cacheDirectory.back() == '\\') {
+            return cacheDirectory + name + suffix;
+        }
+
+        return cacheDirectory + "/" + name + suffix;
+    }
+
+    bool Probe::save() const {
+        if (specularMaps) {
+            return irradiance.saveBinary(getCachePath("_irradiance.cubemap"), cacheKey) &&
+                   specular.saveBinary(getCachePath("_specular.cubemap"), cacheKey, prefilterMipLevels);
+        }
+
+        std::ofstream file(getCachePath(".sh"), std::ios::binary);
+
+        if (!file) {
+            std::cout << "Could not write probe cache " << getCachePath(".sh") << std::endl;
+            return false;
+        }
+
+        file.write((const char*)&cacheMagic, sizeof(cacheMagic));
+        file.write((const char*)&cacheVersion, sizeof(cacheVersion));
+        file.write((const char*)&cacheKey, sizeof(cacheKey));
+        file.write((const char*)irradianceSH.coefficients, sizeof(irradianceSH.coefficients));
+
+        return true;
+    }
+
+    bool Probe::load() {
+        if (specularMaps) {
+            Cubemap loadedIrradiance;
+            Cubemap loadedSpecular;
+
+            if (!loadedIrradiance.loadBinary(getCachePath("_irradiance.cubemap"), cacheKey)) {
+                return false;
+            }
+            if (!loadedSpecular.loadBinary(getCachePath("_specular.cubemap"), cacheKey)) {
+                deleteCubemap(loadedIrradiance);
+                return false;
+            }
+
+            deleteCubemap(irradiance);
+            deleteCubemap(specular);
+
+            irradiance = loadedIrradiance;
+            specular = loadedSpecular;
+
+            return true;
+        }
+
+        std::ifstream file(getCachePath(".sh"), std::ios::binary);
+
+        if (!file) {
+            return false;
+        }
+
+        unsigned int header[3] = {0, 0, 0};
+        file.read((char*)header, sizeof(header));
+
+        if (!file || header[0] != cacheMagic || header[1] != cacheVersion || header[2] != cacheKey) {
+            return false;
+        }
+
+        SH9 sh;
+        file.read((char*)sh.coefficients, sizeof(sh.coefficients));
+
+        if (!file) {
+            std::cout << "Probe cache " << getCachePath(".sh") << " is truncated" << std::endl;
+            return false;
+        }
+
+        irradianceSH = sh;
+        return true;
+    }
+
+    bool Probe::bake(float budget) {
+        int numSteps = getNumSteps();
+
+        if (step == numSteps) {
+            return true;
+        }
+
+        PROFILE_SCOPE("IBL::Probe::bake");
+
+        if (step == 0) {
+            cacheKey = Renderer::getSceneHash();
+            cacheKey = Hash::fnv1a(cacheKey, &position, sizeof(vec3));
+            cacheKey = Hash::fnv1a(cacheKey, &specularMaps, sizeof(bool));
+
+            if (!cacheDirectory.empty() && load()) {
+                deleteCubemap(environment);
+                deleteCubemap(bakingIrradiance);
+                deleteCubemap(bakingSpecular);
+
+                step = numSteps;
+                baked = true;
+                return true;
+            }
+
+            if (specularMaps && bakingIrradiance.getID() == 0) {
+                bakingIrradiance.setID(createCubemap(irradianceResolution, false));
+                bakingSpecular.setID(createCubemap(prefilterResolution, true));
+            }
+
+            if (environment.getID() == 0) {
+                environment.setID(createCubemap(environmentResolution, false));
             }
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-       irradiance.setID(irradianceMap);
-       specular.setID(prefilterMap);
+        GpuProfiler::beginScope("probe bake");
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // GL calls only queue work, so the budget bounds submission rather than GPU time
+        do {
+            runStep(step);
+            step++;
+        } while (step < numSteps &&
+                 std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() < budget);
+
+        GpuProfiler::endScope();
+
+        if (step == numSteps) {
+            baked = true;
+
+            // only needed while baking, probes without specular are down to their 27 floats after this
+            deleteCubemap(environment);
+
+            if (specularMaps) {
+                deleteCubemap(irradiance);
+                deleteCubemap(specular);
+
+                irradiance = bakingIrradiance;
+                specular = bakingSpecular;
+
+                bakingIrradiance.setID(0);
+                bakingSpecular.setID(0);
+            }
+
+            if (!cacheDirectory.empty()) {
+                save();
+            }
+        }
+
+        return step == numSteps;
+    }
+
+    void Probe::rebake() {
+        step = 0;
+    }
+
+    void Probe::destroy() {
+        deleteCubemap(environment);
+        deleteCubemap(irradiance);
+        deleteCubemap(specular);
+        deleteCubemap(bakingIrradiance);
+        deleteCubemap(bakingSpecular);
+
+        step = 0;
+        baked = false;
+    }
+
+    bool Probe::isBaked() const {
+        return baked;
+    }
+
+    float Probe::getProgress() const {
+        return (float)step / (float)getNumSteps();
+    }
+
+    const vec3 &Probe::getPosition() const {
+        return position;
+    }
+
+    float Probe::getRadius() const {
+        return radius;
+    }
+
+    bool Probe::hasSpecular() const {
+        return specularMaps;
+    }
+
+    const SH9 &Probe::getIrradianceSH() const {
+        return irradianceSH;
+    }
+
+    const Cubemap &Probe::getIrradiance() const {
+        return irradiance;
+    }
 
-       glDeleteFramebuffers(1, &captureFBO);
-       glDeleteRenderbuffers(1, &captureRBO);
+    const Cubemap &Probe::getSpecular() const {
+        return specular;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,346 @@
+#include <crucible/LightClusters.hpp>
+#include <crucible/Camera.hpp>
+#include <crucible/PointLight.hpp>
+#include <crucible/Shader.hpp>
+#include <crucible/ShadowAtlas.hpp>
+#include <crucible/Profiler.hpp>
+#include <crucible/Simd.hpp>
+#include <crucible/ThreadPool.hpp>
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+
+// fewer lights are binned faster than the pool wakes up
+static const size_t minLightsForThreading = 64;
+
+namespace {
+    /**
+     * Lights in structure of arrays form so four can be tested against a cluster at once. Padded to a multiple of
+     * four with entries that never pass the test.
+     */
+    struct LightSoA {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radiusSquared;
+        std::vector<unsigned int> index;
+
+        void push(const vec4 &light, unsigned int i) {
+            x.push_back(light.x);
+            y.push_back(light.y);
+            z.push_back(light.z);
+            radiusSquared.push_back(light.w * light.w);
+            index.push_back(i);
+        }
+
+        void pad() {
+            while (x.size() % 4 != 0) {
+                push(vec4(0.0f, 0.0f, 0.0f, 0.0f), 0);
+                radiusSquared.back() = -1.0f;
+            }
+        }
+    };
+
+    struct SliceResult {
+        // per tile of the slice: offset into indices and light count
+        std::vector<unsigned int> grid;
+        std::vector<unsigned int> indices;
+    };
+
+    struct ClusterParams {
+        float nearPlane;
+        float logDepthRatio;
+
+        // view space extent of a unit of ndc, divided by depth for perspective cameras
+        float scaleX;
+        float scaleY;
+        bool orthographic;
+    };
+
+    float sliceDepth(const ClusterParams &p, int z) {
+        return p.nearPlane * std::exp(p.logDepthRatio * (float)z / (float)LightClusters::GRID_Z);
+    }
+
+    /**
+     * Bins all lights that overlap depth slice z into its tiles.
+     */
+    void binSlice(int z, const ClusterParams &p, const std::vector<vec4> &lights, SliceResult &out) {
+        out.grid.assign(LightClusters::GRID_X * LightClusters::GRID_Y * 2, 0);
+        out.indices.clear();
+
+        float depthNear = sliceDepth(p, z);
+        float depthFar = sliceDepth(p, z + 1);
+
+        // the camera looks down -z
+        float minZ = -depthFar;
+        float maxZ = -depthNear;
+
+        LightSoA soa;
+        for (size_t i = 0; i < lights.size(); i++) {
+            const vec4 &l = lights[i];
+
+            if (l.z - l.w < maxZ && l.z + l.w > minZ) {
+                soa.push(l, (unsigned int)i);
+            }
+        }
+
+        if (soa.x.empty()) {
+            return;
+        }
+
+        soa.pad();
+
+        float extentNear = p.orthographic ? 1.0f : depthNear;
+        float extentFar = p.orthographic ? 1.0f : depthFar;
+
+        for (int y = 0; y < LightClusters::GRID_Y; y++) {
+            float ndcY0 = -1.0f + 2.0f * (float)y / (float)LightClusters::GRID_Y;
+            float ndcY1 = -1.0f + 2.0f * (float)(y + 1) / (float)LightClusters::GRID_Y;
+
+            float minY = std::min(ndcY0 * extentNear, ndcY0 * extentFar) * p.scaleY;
+            float maxY = std::max(ndcY1 * extentNear, ndcY1 * extentFar) * p.scaleY;
+
+            for (int x = 0; x < LightClusters::GRID_X; x++) {
+                float ndcX0 = -1.0f + 2.0f * (float)x / (float)LightClusters::GRID_X;
+                float ndcX1 = -1.0f + 2.0f * (float)(x + 1) / (float)LightClusters::GRID_X;
+
+                float minX = std::min(ndcX0 * extentNear, ndcX0 * extentFar) * p.scaleX;
+                float maxX = std::max(ndcX1 * extentNear, ndcX1 * extentFar) * p.scaleX;
+
+                size_t offset = out.indices.size();
+
+#ifdef CRUCIBLE_SSE
+                __m128 boxMinX = _mm_set1_ps(minX);
+                __m128 boxMaxX = _mm_set1_ps(maxX);
+                __m128 boxMinY = _mm_set1_ps(minY);
+                __m128 boxMaxY = _mm_set1_ps(maxY);
+                __m128 boxMinZ = _mm_set1_ps(minZ);
+                __m128 boxMaxZ = _mm_set1_ps(maxZ);
+
+                for (size_t i = 0; i < soa.x.size(); i += 4) {
+                    __m128 cx = _mm_loadu_ps(&soa.x[i]);
+                    __m128 cy = _mm_loadu_ps(&soa.y[i]);
+                    __m128 cz = _mm_loadu_ps(&soa.z[i]);
+
+                    // distance from the sphere center to the closest point of the box
+                    __m128 dx = _mm_sub_ps(cx, _mm_min_ps(_mm_max_ps(cx, boxMinX), boxMaxX));
+                    __m128 dy = _mm_sub_ps(cy, _mm_min_ps(_mm_max_ps(cy, boxMinY), boxMaxY));
+                    __m128 dz = _mm_sub_ps(cz, _mm_min_ps(_mm_max_ps(cz, boxMinZ), boxMaxZ));
+
+                    __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+                    int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&soa.radiusSquared[i])));
+
+                    for (int j = 0; j < 4; j++) {
+                        if (mask & (1 << j)) {
+                            out.indices.push_back(soa.index[i + j]);
+                        }
+                    }
+                }
+#else
+                for (size_t i = 0; i < soa.x.size(); i++) {
+                    float dx = soa.x[i] - std::min(std::max(soa.x[i], minX), maxX);
+                    float dy = soa.y[i] - std::min(std::max(soa.y[i], minY), maxY);
+                    float dz = soa.z[i] - std::min(std::max(soa.z[i], minZ), maxZ);
+
+                    if (dx * dx + dy * dy + dz * dz <= soa.radiusSquared[i]) {
+                        out.indices.push_back(soa.index[i]);
+                    }
+                }
+#endif
+
+                int tile = y * LightClusters::GRID_X + x;
+                out.grid[tile * 2 + 0] = (unsigned int)offset;
+                out.grid[tile * 2 + 1] = (unsigned int)(out.indices.size() - offset);
+            }
+        }
+    }
+}
+
+void LightClusters::setup() {
+    glGenBuffers(1, &lightBuffer);
+    glGenBuffers(1, &gridBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &shadowBuffer);
+
+    glGenTextures(1, &lightTexture);
+    glGenTextures(1, &gridTexture);
+    glGenTextures(1, &indexTexture);
+    glGenTextures(1, &shadowTexture);
+
+    // allocate something so the textures are complete before the first update
+    lightData.assign(2, vec4(0.0f));
+    grid.assign(NUM_CLUSTERS * 2, 0);
+    indices.assign(1, 0);
+    shadowMatrices.assign(4, 0.0f);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, lightData.size() * sizeof(vec4), &lightData[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned int), &grid[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, shadowBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, shadowMatrices.size() * sizeof(float), &shadowMatrices[0], GL_STREAM_DRAW);
+
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, shadowTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, shadowBuffer);
+}
+
+void LightClusters::destroy() {
+    glDeleteTextures(1, &lightTexture);
+    glDeleteTextures(1, &gridTexture);
+    glDeleteTextures(1, &indexTexture);
+    glDeleteTextures(1, &shadowTexture);
+
+    glDeleteBuffers(1, &lightBuffer);
+    glDeleteBuffers(1, &gridBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &shadowBuffer);
+
+    lightTexture = gridTexture = indexTexture = shadowTexture = 0;
+    lightBuffer = gridBuffer = indexBuffer = shadowBuffer = 0;
+}
+
+void LightClusters::update(const Camera &cam, const std::vector<PointLight*> &lights, const ShadowAtlas *shadows) {
+    PROFILE_SCOPE("LightClusters::update");
+
+    mat4 view = cam.getView();
+    mat4 projection = cam.getProjection();
+
+    nearPlane = cam.nearPlane;
+    farPlane = cam.farPlane;
+
+    ClusterParams params;
+    params.nearPlane = nearPlane;
+    params.logDepthRatio = std::log(farPlane / nearPlane);
+    params.scaleX = 1.0f / projection.m00;
+    params.scaleY = 1.0f / projection.m11;
+    params.orthographic = cam.orthographic;
+
+    std::vector<vec4> viewLights(lights.size());
+
+    mat4 inverseView = inverse(view);
+    shadowMatrices.clear();
+
+    lightData.resize(lights.size() * 2);
+    for (size_t i = 0; i < lights.size(); i++) {
+        vec3 position = vec3(vec4(lights[i]->m_position, 1.0f) * view);
+
+        viewLights[i] = vec4(position, lights[i]->m_radius);
+
+        const PointLightShadow *shadow = shadows ? shadows->getShadow(lights[i]) : nullptr;
+        float shadowIndex = -1.0f;
+
+        if (shadow) {
+            shadowIndex = (float)(shadowMatrices.size() / 96);
+
+            mat4 matrices[6];
+            shadows->getShadowMatrices(*shadow, inverseView, matrices);
+
+            for (int face = 0; face < 6; face++) {
+                const mat4 &m = matrices[face];
+                float columns[16] = {
+                    m.m00, m.m10, m.m20, m.m30,
+                    m.m01, m.m11, m.m21, m.m31,
+                    m.m02, m.m12, m.m22, m.m32,
+                    m.m03, m.m13, m.m23, m.m33
+                };
+
+                shadowMatrices.insert(shadowMatrices.end(), columns, columns + 16);
+            }
+        }
+
+        lightData[i * 2 + 0] = viewLights[i];
+        lightData[i * 2 + 1] = vec4(lights[i]->m_color, shadowIndex);
+    }
+
+    SliceResult slices[GRID_Z];
+
+    if (lights.size() < minLightsForThreading) {
+        for (int z = 0; z < GRID_Z; z++) {
+            binSlice(z, params, viewLights, slices[z]);
+        }
+    }
+    else {
+        ThreadPool::parallelFor(GRID_Z, [&params, &viewLights, &slices](int z) {
+            PROFILE_SCOPE("bin light cluster slice");
+
+            binSlice(z, params, viewLights, slices[z]);
+        });
+    }
+
+    // concatenate the slices into one compact list
+    indices.clear();
+    for (int z = 0; z < GRID_Z; z++) {
+        unsigned int base = (unsigned int)indices.size();
+        const SliceResult &slice = slices[z];
+
+        for (int tile = 0; tile < GRID_X * GRID_Y; tile++) {
+            int cluster = z * GRID_X * GRID_Y + tile;
+
+            grid[cluster * 2 + 0] = slice.grid.empty() ? 0 : base + slice.grid[tile * 2 + 0];
+            grid[cluster * 2 + 1] = slice.grid.empty() ? 0 : slice.grid[tile * 2 + 1];
+        }
+
+        indices.insert(indices.end(), slice.indices.begin(), slice.indices.end());
+    }
+
+    numLights = (int)lights.size();
+    numIndices = (int)indices.size();
+
+    // buffer textures can't be empty
+    if (lightData.empty()) {
+        lightData.push_back(vec4(0.0f));
+    }
+    if (indices.empty()) {
+        indices.push_back(0);
+    }
+    if (shadowMatrices.empty()) {
+        shadowMatrices.assign(4, 0.0f);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, lightData.size() * sizeof(vec4), &lightData[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned int), &grid[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, shadowBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, shadowMatrices.size() * sizeof(float), &shadowMatrices[0], GL_STREAM_DRAW);
+}
+
+void LightClusters::bind(const Shader &shader, int firstUnit) const {
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 3);
+    glBindTexture(GL_TEXTURE_BUFFER, shadowTexture);
+
+    shader.uniformInt("lightData", firstUnit);
+    shader.uniformInt("clusterGrid", firstUnit + 1);
+    shader.uniformInt("lightIndices", firstUnit + 2);
+    shader.uniformInt("shadowMatrices", firstUnit + 3);
+
+    shader.uniformFloat("clusterNear", nearPlane);
+    shader.uniformFloat("clusterDepthScale", (float)GRID_Z / std::log(farPlane / nearPlane));
+}
+
+int LightClusters::getNumLights() const {
+    return numLights;
+}
+
+int LightClusters::getNumIndices() const {
+    return numIndices;
+}
@@ -2,6 +2,57 @@
 #include <glad/glad.h>
 
 #include <sstream>
+#include <algorithm>
+
+Mesh::Buffers::Buffers(const Buffers &) {
+
+}
+
+Mesh::Buffers::Buffers(Buffers &&other) noexcept : VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), allocation(other.allocation) {
+    other.VAO = 0;
+    other.VBO = 0;
+    other.EBO = 0;
+    other.allocation = GeometryAllocation();
+}
+
+Mesh::Buffers &Mesh::Buffers::operator=(const Buffers &) {
+    return *this;
+}
+
+Mesh::Buffers &Mesh::Buffers::operator=(Buffers &&other) noexcept {
+    if (this != &other) {
+        release();
+
+        VAO = other.VAO;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        allocation = other.allocation;
+
+        other.VAO = 0;
+        other.VBO = 0;
+        other.EBO = 0;
+        other.allocation = GeometryAllocation();
+    }
+
+    return *this;
+}
+
+void Mesh::Buffers::release() {
+    if (allocation.pool) {
+        allocation.pool->free(allocation);
+    }
+
+    if (VAO) {
+        GeometryPool::bindVertexArray(0);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+
+        VAO = 0;
+        VBO = 0;
+        EBO = 0;
+    }
+}
 
 Mesh::Mesh() {
 
@@ -34,13 +85,6 @@ Mesh::Mesh(const std::vector<vec3> &positions, const std::vector<vec3> &normals,
 }
 
 void Mesh::generate() {
-
-
-    if (!VBO) {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-    }
-
     std::vector<float> data;
     for (unsigned int i = 0; i < positions.size(); ++i)
     {
@@ -100,63 +144,152 @@ void Mesh::generate() {
 
     length = positions.size();
 
-	if (data.size() > 0) {
-
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-		if (indices.size() > 0)
-		{
-		    if (!EBO)
-			    glGenBuffers(1, &EBO);
-
-
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-			length = indices.size();
-		}
-
-		int stride = 3 * sizeof(float);
-		if (uvs.size() > 0) stride += 2 * sizeof(float);
-		if (normals.size() > 0) stride += 3 * sizeof(float);
-		if (tangents.size() > 0) stride += 3 * sizeof(float);
-		if (boneIDs.size() > 0) stride += 4 * sizeof(float);
-		if (boneWeights.size() > 0) stride += 4 * sizeof(float);
-
-
-		long offset = 0;
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
-		offset += 3 * sizeof(float);
-
-		if (normals.size() > 0)
-		{
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
-			offset += 3 * sizeof(float);
-		}
-		if (uvs.size() > 0)
-		{
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
-			offset += 2 * sizeof(float);
-		}
-		if (tangents.size() > 0) {
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
-			offset += 3 * sizeof(float);
-		}
-		if (boneIDs.size() > 0) {
-		    glEnableVertexAttribArray(4);
-		    glVertexAttribIPointer(4, 4, GL_INT, stride, (GLvoid*)offset);
-            offset += 4 * sizeof(float);
-		}
-        if (boneWeights.size() > 0) {
-            glEnableVertexAttribArray(5);
-            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
-            offset += 4 * sizeof(float);
+    if (positions.size() > 0) {
+        vec3 min = positions[0];
+        vec3 max = positions[0];
+
+        for (const vec3 &p : positions) {
+            min = vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+            max = vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
         }
-	}
+
+        bounds = AABB(min, max);
+    }
+
+    if (data.size() == 0) {
+        return;
+    }
+
+    int layout = 0;
+    if (normals.size() > 0) layout |= VERTEX_NORMALS;
+    if (uvs.size() > 0) layout |= VERTEX_UVS;
+    if (tangents.size() > 0) layout |= VERTEX_TANGENTS;
+    if (boneIDs.size() > 0) layout |= VERTEX_BONE_IDS;
+    if (boneWeights.size() > 0) layout |= VERTEX_BONE_WEIGHTS;
+
+    // lods share the vertices of the base mesh, so they are appended to the same element buffer
+    std::vector<unsigned int> allIndices = indices;
+    lodOffsets.clear();
+    lodLengths.clear();
+    lodErrors.clear();
+
+    for (const MeshLod &lod : lods) {
+        lodOffsets.push_back(allIndices.size());
+        lodLengths.push_back(lod.indices.size());
+        lodErrors.push_back(lod.error);
+        allIndices.insert(allIndices.end(), lod.indices.begin(), lod.indices.end());
+    }
+
+    // any mesh with 65536 vertices or less can be addressed with 16 bit indices, which halves the index buffer
+    std::vector<unsigned short> shortIndices;
+    const void *indexData = nullptr;
+    size_t indexBytes = 0;
+
+    if (allIndices.size() > 0) {
+        if (positions.size() <= 65536) {
+            shortIndices.assign(allIndices.begin(), allIndices.end());
+
+            indexData = &shortIndices[0];
+            indexBytes = shortIndices.size() * sizeof(unsigned short);
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        else {
+            indexData = &allIndices[0];
+            indexBytes = allIndices.size() * sizeof(unsigned int);
+            indexType = GL_UNSIGNED_INT;
+        }
+
+        length = indices.size();
+    }
+
+    if (pooled && indexBytes > 0) {
+        // indexed meshes live in the shared buffers of their vertex layout
+        GeometryPool &pool = GeometryPool::get(layout);
+
+        if (buffers.allocation.pool) {
+            buffers.allocation.pool->free(buffers.allocation);
+        }
+
+        // switching from own buffers to the pool
+        if (buffers.VAO) {
+            GeometryPool::bindVertexArray(0);
+            glDeleteVertexArrays(1, &buffers.VAO);
+            glDeleteBuffers(1, &buffers.VBO);
+            glDeleteBuffers(1, &buffers.EBO);
+
+            buffers.VAO = 0;
+            buffers.VBO = 0;
+            buffers.EBO = 0;
+        }
+
+        buffers.allocation = pool.allocate(positions.size(), indexBytes);
+        pool.uploadVertices(buffers.allocation, &data[0]);
+        pool.uploadIndices(buffers.allocation, indexData, indexBytes);
+
+        return;
+    }
+
+    // regenerated without indices or unpooled, the old range would keep being drawn otherwise
+    if (buffers.allocation.pool) {
+        buffers.allocation.pool->free(buffers.allocation);
+    }
+
+    if (!buffers.VBO) {
+        glGenVertexArrays(1, &buffers.VAO);
+        glGenBuffers(1, &buffers.VBO);
+    }
+
+    GeometryPool::bindVertexArray(buffers.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+
+    if (indexBytes > 0) {
+        if (!buffers.EBO)
+            glGenBuffers(1, &buffers.EBO);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+    }
+    else if (buffers.EBO) {
+        // drawn with glDrawArrays from now on
+        glDeleteBuffers(1, &buffers.EBO);
+        buffers.EBO = 0;
+    }
+
+    int stride = GeometryPool::getStride(layout);
+
+    long offset = 0;
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+    offset += 3 * sizeof(float);
+
+    if (normals.size() > 0)
+    {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 3 * sizeof(float);
+    }
+    if (uvs.size() > 0)
+    {
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 2 * sizeof(float);
+    }
+    if (tangents.size() > 0) {
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 3 * sizeof(float);
+    }
+    if (boneIDs.size() > 0) {
+        glEnableVertexAttribArray(4);
+        glVertexAttribIPointer(4, 4, GL_INT, stride, (GLvoid*)offset);
+        offset += 4 * sizeof(float);
+    }
+    if (boneWeights.size() > 0) {
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += 4 * sizeof(float);
+    }
 }
 
 void Mesh::clear() {
@@ -165,21 +298,88 @@ void Mesh::clear() {
     normals.clear();
     tangents.clear();
     indices.clear();
+    lods.clear();
 }
 
 void Mesh::render() const {
-    glBindVertexArray(VAO);
+    renderLod(0);
+}
 
-    if (EBO) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+int Mesh::getNumLods() const {
+    return 1 + lodOffsets.size();
+}
 
-        glDrawElements(renderMode, length, GL_UNSIGNED_INT, 0);
+float Mesh::getLodError(int lod) const {
+    if (lod <= 0 || lodErrors.size() == 0) {
+        return 0.0f;
     }
-    else {
-        glDrawArrays(renderMode, 0, length);
+
+    return lodErrors[std::min(lod, (int)lodErrors.size()) - 1];
+}
+
+const AABB *Mesh::getBounds() const {
+    return &bounds;
+}
+
+bool Mesh::getIndirectCommand(int lod, DrawElementsIndirectCommand &command) const {
+    if (!buffers.allocation.pool) {
+        return false;
+    }
+
+    long indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    lod = std::min(lod, (int)lodOffsets.size());
+
+    command.count = lod > 0 ? lodLengths[lod - 1] : length;
+    command.instanceCount = 1;
+    command.firstIndex = buffers.allocation.indexOffset / indexSize + (lod > 0 ? lodOffsets[lod - 1] : 0);
+    command.baseVertex = buffers.allocation.firstVertex;
+    command.baseInstance = 0;
+
+    return true;
+}
+
+GeometryPool *Mesh::getPool() const {
+    return buffers.allocation.pool;
+}
+
+int Mesh::getIndexType() const {
+    return indexType;
+}
+
+void Mesh::renderLod(int lod) const {
+    // never generated, or a copy that wasn't
+    if (!buffers.allocation.pool && !buffers.VAO) {
+        return;
+    }
+
+    int count = length;
+    long firstIndex = 0;
+
+    lod = std::min(lod, (int)lodOffsets.size());
+
+    if (lod > 0) {
+        count = lodLengths[lod - 1];
+        firstIndex = lodOffsets[lod - 1];
     }
 
-    glBindVertexArray(0);
+    long indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    if (buffers.allocation.pool) {
+        buffers.allocation.pool->bind();
+
+        glDrawElementsBaseVertex(renderMode, count, indexType, (GLvoid*)(buffers.allocation.indexOffset + firstIndex * indexSize), buffers.allocation.firstVertex);
+    }
+    else {
+        GeometryPool::bindVertexArray(buffers.VAO);
+
+        if (buffers.EBO) {
+            glDrawElements(renderMode, count, indexType, (GLvoid*)(firstIndex * indexSize));
+        }
+        else {
+            glDrawArrays(renderMode, 0, length);
+        }
+    }
 }
 
 // https://stackoverflow.com/questions/236129/the-most-elegant-way-to-iterate-the-words-of-a-string
@@ -261,6 +461,21 @@ json Mesh::toJson() const {
     }
     j["indices"] = sIndices;
 
+    json jLods = json::array();
+    for (const MeshLod &lod : lods) {
+        std::string sLodIndices;
+        for (size_t i = 0; i < lod.indices.size(); i++) {
+            sLodIndices += std::to_string(lod.indices[i]);
+            sLodIndices += ",";
+        }
+
+        json jLod;
+        jLod["indices"] = sLodIndices;
+        jLod["error"] = lod.error;
+        jLods.push_back(jLod);
+    }
+    j["lods"] = jLods;
+
     return j;
 }
 
@@ -308,11 +523,29 @@ void Mesh::fromJson(const json &j) {
             indices.push_back(stoi(sIndices[i]));
         }
     }
+
+    if (j.find("lods") != j.end() && j["lods"].is_array()) {
+        for (const json &jLod : j["lods"]) {
+            MeshLod lod;
+
+            if (jLod["indices"].is_string()) {
+                std::vector<std::string> sLodIndices = split(jLod["indices"], ',');
+
+                for (size_t i = 0; i < sLodIndices.size(); i++) {
+                    lod.indices.push_back(stoi(sLodIndices[i]));
+                }
+            }
+            if (jLod["error"].is_number()) {
+                lod.error = jLod["error"];
+            }
+
+            lods.push_back(lod);
+        }
+    }
 }
 
 void Mesh::destroy() {
     clear();
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+
+    buffers.release();
 }
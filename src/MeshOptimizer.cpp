@@ -0,0 +1,650 @@
+#include <crucible/MeshOptimizer.hpp>
+
+#include <algorithm>
+#include <type_traits>
+#include <math.h>
+
+// Forsyth scoring constants, see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+static const int kCacheSize = 32;
+static const float kCacheDecayPower = 1.5f;
+static const float kLastTriScore = 0.75f;
+static const float kValenceBoostScale = 2.0f;
+static const float kValenceBoostPower = 0.5f;
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+    if (remainingTriangles == 0) {
+        // no triangles left need this vertex, so it shouldn't influence anything
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // the vertices of the last triangle get a fixed score so the algorithm doesn't favor strips too much
+            score = kLastTriScore;
+        }
+        else {
+            float scaler = 1.0f / (kCacheSize - 3);
+            score = 1.0f - (cachePosition - 3) * scaler;
+            score = powf(score, kCacheDecayPower);
+        }
+    }
+
+    // boost vertices with few triangles left so lone triangles get cleared out instead of left for the end
+    score += kValenceBoostScale * powf((float)remainingTriangles, -kValenceBoostPower);
+
+    return score;
+}
+
+namespace MeshOptimizer {
+    VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize) {
+        VertexCacheStats stats;
+
+        if (indices.size() < 3 || vertexCount == 0) {
+            return stats;
+        }
+
+        // timestamp of when each vertex entered the cache, a vertex is a hit if it entered less than cacheSize misses ago
+        std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        unsigned int timestamp = cacheSize + 1;
+        unsigned int misses = 0;
+        unsigned int uniqueVertices = 0;
+
+        for (unsigned int index : indices) {
+            if (index >= vertexCount) continue;
+
+            if (!referenced[index]) {
+                referenced[index] = true;
+                uniqueVertices++;
+            }
+
+            if (timestamp - cacheTimestamps[index] > cacheSize) {
+                cacheTimestamps[index] = timestamp++;
+                misses++;
+            }
+        }
+
+        stats.acmr = (float)misses / (float)(indices.size() / 3);
+        stats.atvr = uniqueVertices > 0 ? (float)misses / (float)uniqueVertices : 0.0f;
+
+        return stats;
+    }
+
+    void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount) {
+        size_t triangleCount = indices.size() / 3;
+
+        if (triangleCount == 0 || vertexCount == 0) {
+            return;
+        }
+
+        // build vertex to triangle adjacency
+        std::vector<unsigned int> remaining(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            remaining[indices[i]]++;
+        }
+
+        std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+        }
+
+        std::vector<unsigned int> adjacency(adjacencyOffsets[vertexCount]);
+        std::vector<unsigned int> adjacencyCounts(vertexCount, 0);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                adjacency[adjacencyOffsets[v] + adjacencyCounts[v]++] = (unsigned int)t;
+            }
+        }
+
+        std::vector<float> vertexScores(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+
+        std::vector<unsigned int> cache;
+        std::vector<unsigned int> newCache;
+        cache.reserve(kCacheSize + 3);
+        newCache.reserve(kCacheSize + 3);
+
+        long bestTriangle = -1;
+        size_t deadEndCursor = 0;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            if (bestTriangle < 0) {
+                // nothing useful in the cache, restart from the next triangle that hasn't been emitted
+                while (emitted[deadEndCursor]) deadEndCursor++;
+                bestTriangle = (long)deadEndCursor;
+            }
+
+            unsigned int tri[3] = {indices[bestTriangle * 3], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2]};
+
+            result.push_back(tri[0]);
+            result.push_back(tri[1]);
+            result.push_back(tri[2]);
+            emitted[bestTriangle] = true;
+
+            // remove this triangle from the adjacency of its vertices
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = tri[k];
+                unsigned int *begin = &adjacency[adjacencyOffsets[v]];
+                unsigned int *end = begin + remaining[v];
+                unsigned int *found = std::find(begin, end, (unsigned int)bestTriangle);
+
+                if (found != end) {
+                    *found = *(end - 1);
+                    remaining[v]--;
+                }
+            }
+
+            // move the triangle's vertices to the front of the LRU cache
+            newCache.clear();
+            newCache.push_back(tri[0]);
+            newCache.push_back(tri[1]);
+            newCache.push_back(tri[2]);
+
+            for (unsigned int v : cache) {
+                if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                    newCache.push_back(v);
+                }
+            }
+
+            if (newCache.size() > (size_t)kCacheSize) {
+                // evicted vertices still need their scores lowered, so update them before truncating
+                for (size_t i = kCacheSize; i < newCache.size(); i++) {
+                    vertexScores[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+                }
+                newCache.resize(kCacheSize);
+            }
+
+            std::swap(cache, newCache);
+
+            for (size_t i = 0; i < cache.size(); i++) {
+                vertexScores[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+            }
+
+            // rescore triangles touching the cache and pick the best one for the next iteration
+            bestTriangle = -1;
+            float bestScore = -1.0f;
+
+            for (unsigned int v : cache) {
+                for (unsigned int i = 0; i < remaining[v]; i++) {
+                    unsigned int t = adjacency[adjacencyOffsets[v] + i];
+                    float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestTriangle = t;
+                    }
+                }
+            }
+        }
+
+        indices.swap(result);
+    }
+
+    void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<vec3> &positions, unsigned int cacheSize) {
+        size_t triangleCount = indices.size() / 3;
+
+        if (triangleCount < 2 || positions.size() == 0) {
+            return;
+        }
+
+        // split the triangle list wherever the simulated cache gets fully flushed (a triangle with 3 misses),
+        // reordering whole clusters then keeps almost all of the cache efficiency within them
+        std::vector<size_t> clusterStarts;
+        std::vector<unsigned int> cacheTimestamps(positions.size(), 0);
+        unsigned int timestamp = cacheSize + 1;
+
+        for (size_t t = 0; t < triangleCount; t++) {
+            int misses = 0;
+
+            for (int k = 0; k < 3; k++) {
+                unsigned int index = indices[t * 3 + k];
+
+                if (timestamp - cacheTimestamps[index] > cacheSize) {
+                    cacheTimestamps[index] = timestamp++;
+                    misses++;
+                }
+            }
+
+            if (t == 0 || misses == 3) {
+                clusterStarts.push_back(t);
+            }
+        }
+
+        if (clusterStarts.size() < 2) {
+            return;
+        }
+
+        vec3 meshCentroid;
+        for (const vec3 &p : positions) {
+            meshCentroid = meshCentroid + p;
+        }
+        meshCentroid = meshCentroid / (float)positions.size();
+
+        struct Cluster {
+            size_t start;
+            size_t end;
+            float sortKey;
+        };
+
+        std::vector<Cluster> clusters;
+        clusters.reserve(clusterStarts.size());
+
+        for (size_t c = 0; c < clusterStarts.size(); c++) {
+            size_t start = clusterStarts[c];
+            size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+            // area weighted centroid and normal of the cluster
+            vec3 centroid;
+            vec3 normal;
+            float area = 0.0f;
+
+            for (size_t t = start; t < end; t++) {
+                const vec3 &a = positions[indices[t * 3]];
+                const vec3 &b = positions[indices[t * 3 + 1]];
+                const vec3 &d = positions[indices[t * 3 + 2]];
+
+                vec3 n = cross(b - a, d - a);
+                float triangleArea = length(n);
+
+                centroid = centroid + (a + b + d) * (triangleArea / 3.0f);
+                normal = normal + n;
+                area += triangleArea;
+            }
+
+            if (area > 0.0f) {
+                centroid = centroid / area;
+            }
+
+            float normalLength = length(normal);
+            if (normalLength > 0.0f) {
+                normal = normal / normalLength;
+            }
+
+            // clusters that sit far out along their own normal are likely to occlude the rest, draw them first
+            clusters.push_back({start, end, dot(centroid - meshCentroid, normal)});
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) {
+            return a.sortKey > b.sortKey;
+        });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        for (const Cluster &cluster : clusters) {
+            result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+        }
+
+        indices.swap(result);
+    }
+
+    void optimizeVertexFetch(Mesh &mesh) {
+        size_t vertexCount = mesh.positions.size();
+
+        if (mesh.indices.size() == 0 || vertexCount == 0) {
+            return;
+        }
+
+        std::vector<unsigned int> remap(vertexCount, 0xFFFFFFFF);
+        std::vector<unsigned int> order;
+        order.reserve(vertexCount);
+
+        for (unsigned int &index : mesh.indices) {
+            if (remap[index] == 0xFFFFFFFF) {
+                remap[index] = (unsigned int)order.size();
+                order.push_back(index);
+            }
+
+            index = remap[index];
+        }
+
+        auto permute = [&order](auto &attribute) {
+            if (attribute.size() == 0) return;
+
+            typename std::remove_reference<decltype(attribute)>::type reordered(order.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                reordered[i] = attribute[order[i]];
+            }
+            attribute.swap(reordered);
+        };
+
+        permute(mesh.positions);
+        permute(mesh.normals);
+        permute(mesh.uvs);
+        permute(mesh.tangents);
+        permute(mesh.boneIDs);
+        permute(mesh.boneWeights);
+    }
+
+    void optimize(Mesh &mesh) {
+        // only plain triangle lists (GL_TRIANGLES) can be reordered freely
+        if (mesh.renderMode != 0x0004 || mesh.indices.size() < 3 || mesh.indices.size() % 3 != 0) {
+            return;
+        }
+
+        optimizeVertexCache(mesh.indices, (unsigned int)mesh.positions.size());
+        optimizeOverdraw(mesh.indices, mesh.positions);
+        optimizeVertexFetch(mesh);
+    }
+}
+
+namespace {
+    /**
+     * Symmetric 4x4 quadric stored as its 10 unique coefficients, in double precision since plane quadrics of
+     * large coordinates lose precision quickly in float.
+     */
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0;
+        double b2 = 0, bc = 0, bd = 0;
+        double c2 = 0, cd = 0;
+        double d2 = 0;
+
+        void addPlane(double a, double b, double c, double d) {
+            a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+            b2 += b * b; bc += b * c; bd += b * d;
+            c2 += c * c; cd += c * d;
+            d2 += d * d;
+        }
+
+        void add(const Quadric &q) {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+        }
+
+        double evaluate(const vec3 &p) const {
+            double x = p.x, y = p.y, z = p.z;
+
+            return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z
+                 + d2;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+}
+
+namespace MeshOptimizer {
+    std::vector<unsigned int> simplify(const std::vector<unsigned int> &indices, const std::vector<vec3> &positions, size_t targetIndexCount, float targetError, float *resultError) {
+        std::vector<unsigned int> result(indices.begin(), indices.begin() + (indices.size() / 3) * 3);
+        size_t vertexCount = positions.size();
+        double maxError = 0.0;
+
+        if (resultError) *resultError = 0.0f;
+
+        if (result.size() <= targetIndexCount || vertexCount == 0) {
+            return result;
+        }
+
+        // weld vertices that share a position, the simplifier works on the welded topology
+        std::vector<unsigned int> sorted(vertexCount);
+        for (unsigned int i = 0; i < vertexCount; i++) sorted[i] = i;
+
+        std::sort(sorted.begin(), sorted.end(), [&positions](unsigned int a, unsigned int b) {
+            const vec3 &pa = positions[a];
+            const vec3 &pb = positions[b];
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            return pa.z < pb.z;
+        });
+
+        std::vector<unsigned int> welded(vertexCount);
+        std::vector<bool> locked(vertexCount, false);
+
+        for (size_t i = 0; i < vertexCount;) {
+            size_t j = i + 1;
+            while (j < vertexCount && positions[sorted[j]] == positions[sorted[i]]) j++;
+
+            for (size_t k = i; k < j; k++) {
+                welded[sorted[k]] = sorted[i];
+
+                // a position shared by several vertices means their normals or uvs differ, collapsing one side
+                // of that seam would tear the other, so leave all of them in place
+                if (j - i > 1) locked[sorted[k]] = true;
+            }
+
+            i = j;
+        }
+
+        // lock vertices on open borders: a welded edge that has no opposite directed edge
+        {
+            std::vector<std::pair<unsigned long long, int>> edges;
+            edges.reserve(result.size());
+
+            for (size_t t = 0; t < result.size(); t += 3) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int a = welded[result[t + k]];
+                    unsigned int b = welded[result[t + (k + 1) % 3]];
+                    unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+                    edges.push_back({key, a < b ? 1 : -1});
+                }
+            }
+
+            std::sort(edges.begin(), edges.end());
+
+            for (size_t i = 0; i < edges.size();) {
+                size_t j = i;
+                int balance = 0;
+
+                while (j < edges.size() && edges[j].first == edges[i].first) {
+                    balance += edges[j].second;
+                    j++;
+                }
+
+                if (j - i == 1 || balance != 0) {
+                    unsigned int a = (unsigned int)(edges[i].first >> 32);
+                    unsigned int b = (unsigned int)(edges[i].first & 0xFFFFFFFF);
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+
+                i = j;
+            }
+
+            for (size_t v = 0; v < vertexCount; v++) {
+                if (locked[welded[v]]) locked[v] = true;
+            }
+        }
+
+        // accumulate plane quadrics, error stays in squared distance units
+        std::vector<Quadric> quadrics(vertexCount);
+
+        for (size_t t = 0; t < result.size(); t += 3) {
+            const vec3 &p0 = positions[result[t]];
+            const vec3 &p1 = positions[result[t + 1]];
+            const vec3 &p2 = positions[result[t + 2]];
+
+            vec3 n = cross(p1 - p0, p2 - p0);
+            float area = length(n);
+            if (area <= 0.0f) continue;
+            n = n / area;
+
+            Quadric q;
+            q.addPlane(n.x, n.y, n.z, -dot(n, p0));
+
+            for (int k = 0; k < 3; k++) {
+                quadrics[result[t + k]].add(q);
+            }
+        }
+
+        double errorLimit = (double)targetError * (double)targetError;
+
+        std::vector<unsigned int> remap(vertexCount);
+        std::vector<bool> touched(vertexCount);
+        std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+        std::vector<unsigned int> adjacency;
+        std::vector<Collapse> collapses;
+
+        while (result.size() > targetIndexCount) {
+            // vertex to triangle adjacency of the current triangle list
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (unsigned int index : result) adjacencyOffsets[index + 1]++;
+            for (size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+            adjacency.resize(result.size());
+            std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+            }
+
+            // cheapest direction of every edge
+            collapses.clear();
+            for (size_t t = 0; t < result.size(); t += 3) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int a = result[t + k];
+                    unsigned int b = result[t + (k + 1) % 3];
+
+                    // each interior edge is seen twice, only handle it from one side
+                    if (a > b) continue;
+
+                    Quadric q = quadrics[a];
+                    q.add(quadrics[b]);
+
+                    double costAB = locked[a] ? -1.0 : q.evaluate(positions[b]);
+                    double costBA = locked[b] ? -1.0 : q.evaluate(positions[a]);
+
+                    if (costAB < 0.0 && costBA < 0.0) continue;
+
+                    if (costBA < 0.0 || (costAB >= 0.0 && costAB <= costBA)) {
+                        collapses.push_back({a, b, std::max(costAB, 0.0)});
+                    }
+                    else {
+                        collapses.push_back({b, a, std::max(costBA, 0.0)});
+                    }
+                }
+            }
+
+            if (collapses.empty()) break;
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+                return a.cost < b.cost;
+            });
+
+            for (size_t v = 0; v < vertexCount; v++) remap[v] = (unsigned int)v;
+            std::fill(touched.begin(), touched.end(), false);
+
+            // each collapse removes about 2 triangles, don't overshoot the target in a single pass
+            size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+            size_t collapseBudget = std::max<size_t>(1, trianglesToRemove / 2 + 1);
+            size_t collapsed = 0;
+
+            for (const Collapse &c : collapses) {
+                if (collapsed >= collapseBudget) break;
+                if (c.cost > errorLimit) break;
+                if (touched[c.from] || touched[c.to]) continue;
+
+                const vec3 &target = positions[c.to];
+                bool flips = false;
+
+                for (unsigned int i = adjacencyOffsets[c.from]; i < adjacencyOffsets[c.from + 1] && !flips; i++) {
+                    unsigned int t = adjacency[i] * 3;
+                    unsigned int v0 = result[t], v1 = result[t + 1], v2 = result[t + 2];
+
+                    // triangles containing both endpoints become degenerate and disappear
+                    if (v0 == c.to || v1 == c.to || v2 == c.to) continue;
+
+                    vec3 before = cross(positions[v1] - positions[v0], positions[v2] - positions[v0]);
+
+                    vec3 p0 = v0 == c.from ? target : positions[v0];
+                    vec3 p1 = v1 == c.from ? target : positions[v1];
+                    vec3 p2 = v2 == c.from ? target : positions[v2];
+                    vec3 after = cross(p1 - p0, p2 - p0);
+
+                    if (dot(before, after) <= 0.0f) flips = true;
+                }
+
+                if (flips) continue;
+
+                remap[c.from] = c.to;
+                quadrics[c.to].add(quadrics[c.from]);
+                maxError = std::max(maxError, c.cost);
+                collapsed++;
+
+                // freeze the whole neighbourhood so flip checks in this pass stay valid
+                for (unsigned int i = adjacencyOffsets[c.from]; i < adjacencyOffsets[c.from + 1]; i++) {
+                    unsigned int t = adjacency[i] * 3;
+                    touched[result[t]] = true;
+                    touched[result[t + 1]] = true;
+                    touched[result[t + 2]] = true;
+                }
+                for (unsigned int i = adjacencyOffsets[c.to]; i < adjacencyOffsets[c.to + 1]; i++) {
+                    unsigned int t = adjacency[i] * 3;
+                    touched[result[t]] = true;
+                    touched[result[t + 1]] = true;
+                    touched[result[t + 2]] = true;
+                }
+            }
+
+            if (collapsed == 0) break;
+
+            size_t write = 0;
+            for (size_t t = 0; t < result.size(); t += 3) {
+                unsigned int v0 = remap[result[t]];
+                unsigned int v1 = remap[result[t + 1]];
+                unsigned int v2 = remap[result[t + 2]];
+
+                if (v0 == v1 || v1 == v2 || v0 == v2) continue;
+
+                result[write++] = v0;
+                result[write++] = v1;
+                result[write++] = v2;
+            }
+            result.resize(write);
+        }
+
+        if (resultError) *resultError = (float)sqrt(maxError);
+
+        return result;
+    }
+
+    void generateLods(Mesh &mesh, int maxLods, float reduction, float maxError) {
+        mesh.lods.clear();
+
+        if (mesh.renderMode != 0x0004 || mesh.indices.size() < 3 || mesh.positions.size() == 0) {
+            return;
+        }
+
+        vec3 min = mesh.positions[0];
+        vec3 max = mesh.positions[0];
+        for (const vec3 &p : mesh.positions) {
+            min = vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+            max = vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+        }
+        float radius = length(max - min) * 0.5f;
+
+        size_t previousCount = mesh.indices.size();
+
+        for (int i = 1; i < maxLods; i++) {
+            size_t target = (size_t)(previousCount * reduction) / 3 * 3;
+
+            // always simplify from the base mesh so errors don't compound between levels
+            MeshLod lod;
+            lod.indices = simplify(mesh.indices, mesh.positions, target, radius * maxError, &lod.error);
+
+            if (lod.indices.size() < 3 || lod.indices.size() > previousCount * 0.9f) {
+                break;
+            }
+
+            optimizeVertexCache(lod.indices, (unsigned int)mesh.positions.size());
+
+            previousCount = lod.indices.size();
+            mesh.lods.push_back(lod);
+        }
+    }
+}
@@ -0,0 +1,300 @@
+#include <crucible/OcclusionCuller.hpp>
+#include <crucible/AABB.hpp>
+#include <crucible/Mesh.hpp>
+#include <crucible/Profiler.hpp>
+#include <crucible/Simd.hpp>
+#include <crucible/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// a few hundred triangles are rasterized before the pool is even awake
+static const size_t minTrianglesForThreading = 256;
+
+// edge function of the edge from a to b, positive on the inside of a counter clockwise triangle
+struct Edge {
+    float a, b, c;
+
+    Edge(float ax, float ay, float bx, float by) {
+        a = ay - by;
+        b = bx - ax;
+        c = -(a * ax + b * ay);
+    }
+};
+
+void OcclusionCuller::setup(int width, int height) {
+    this->width = std::max(width, 1);
+    this->height = std::max(height, 1);
+    this->stride = (this->width + 3) & ~3;
+
+    depth.assign(stride * this->height, 0.0f);
+}
+
+void OcclusionCuller::begin(const mat4 &viewProjection) {
+    this->viewProjection = viewProjection;
+
+    std::fill(depth.begin(), depth.end(), 0.0f);
+    triangles.clear();
+
+    numTested = 0;
+    numCulled = 0;
+}
+
+void OcclusionCuller::addTriangle(const vec4 &a, const vec4 &b, const vec4 &c) {
+    const vec4 *v[3] = {&a, &b, &c};
+
+    Triangle t;
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+
+    for (int i = 0; i < 3; i++) {
+        t.invW[i] = 1.0f / v[i]->w;
+        t.x[i] = (v[i]->x * t.invW[i] * 0.5f + 0.5f) * width;
+        t.y[i] = (v[i]->y * t.invW[i] * 0.5f + 0.5f) * height;
+
+        minX = std::min(minX, t.x[i]);
+        maxX = std::max(maxX, t.x[i]);
+        minY = std::min(minY, t.y[i]);
+        maxY = std::max(maxY, t.y[i]);
+    }
+
+    float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+    if (std::abs(area) < 1e-6f) {
+        return;
+    }
+
+    // occluders are drawn from both sides, make every triangle counter clockwise
+    if (area < 0.0f) {
+        std::swap(t.x[1], t.x[2]);
+        std::swap(t.y[1], t.y[2]);
+        std::swap(t.invW[1], t.invW[2]);
+    }
+
+    // pixels whose centers can be inside
+    t.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+    t.maxX = std::min(width - 1, (int)std::floor(maxX - 0.5f));
+    t.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+    t.maxY = std::min(height - 1, (int)std::floor(maxY - 0.5f));
+
+    if (t.minX > t.maxX || t.minY > t.maxY) {
+        return;
+    }
+
+    triangles.push_back(t);
+}
+
+void OcclusionCuller::addOccluder(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices, const mat4 &model) {
+    mat4 mvp = viewProjection * model;
+
+    std::vector<vec4> clip(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        clip[i] = mvp * vec4(positions[i], 1.0f);
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const vec4 *v[3] = {&clip[indices[i]], &clip[indices[i + 1]], &clip[indices[i + 2]]};
+
+        // clip against the near plane (z > -w), a triangle becomes at most a quad
+        vec4 polygon[4];
+        int count = 0;
+
+        for (int j = 0; j < 3; j++) {
+            const vec4 &current = *v[j];
+            const vec4 &next = *v[(j + 1) % 3];
+
+            float dCurrent = current.z + current.w;
+            float dNext = next.z + next.w;
+
+            if (dCurrent >= 0.0f) {
+                polygon[count++] = current;
+            }
+            if ((dCurrent >= 0.0f) != (dNext >= 0.0f)) {
+                float t = dCurrent / (dCurrent - dNext);
+                polygon[count++] = current + (next - current) * t;
+            }
+        }
+
+        for (int j = 1; j + 1 < count; j++) {
+            addTriangle(polygon[0], polygon[j], polygon[j + 1]);
+        }
+    }
+}
+
+void OcclusionCuller::addOccluder(const Mesh &mesh, const mat4 &model) {
+    addOccluder(mesh.positions, mesh.indices, model);
+}
+
+void OcclusionCuller::rasterizeRows(int firstRow, int lastRow) {
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const Triangle &t = triangles[i];
+
+        int minY = std::max(t.minY, firstRow);
+        int maxY = std::min(t.maxY, lastRow - 1);
+
+        if (minY > maxY) {
+            continue;
+        }
+
+        Edge e0(t.x[1], t.y[1], t.x[2], t.y[2]);
+        Edge e1(t.x[2], t.y[2], t.x[0], t.y[0]);
+        Edge e2(t.x[0], t.y[0], t.x[1], t.y[1]);
+
+        // 1/w as a plane over the screen, from the barycentric weights the edge functions give
+        float area = e2.a * t.x[2] + e2.b * t.y[2] + e2.c;
+        float za = (e0.a * t.invW[0] + e1.a * t.invW[1] + e2.a * t.invW[2]) / area;
+        float zb = (e0.b * t.invW[0] + e1.b * t.invW[1] + e2.b * t.invW[2]) / area;
+        float zc = (e0.c * t.invW[0] + e1.c * t.invW[1] + e2.c * t.invW[2]) / area;
+
+        // aligned so four pixel blocks never cross the padded end of a row
+        int startX = t.minX & ~3;
+
+        for (int y = minY; y <= maxY; y++) {
+            float py = y + 0.5f;
+            float *row = &depth[y * stride];
+
+#ifdef CRUCIBLE_SSE
+            __m128 e0Row = _mm_set1_ps(e0.b * py + e0.c);
+            __m128 e1Row = _mm_set1_ps(e1.b * py + e1.c);
+            __m128 e2Row = _mm_set1_ps(e2.b * py + e2.c);
+            __m128 zRow = _mm_set1_ps(zb * py + zc);
+
+            __m128 e0a = _mm_set1_ps(e0.a);
+            __m128 e1a = _mm_set1_ps(e1.a);
+            __m128 e2a = _mm_set1_ps(e2.a);
+            __m128 zA = _mm_set1_ps(za);
+            __m128 zero = _mm_setzero_ps();
+
+            __m128 minPixel = _mm_set1_ps((float)t.minX);
+            __m128 maxPixel = _mm_set1_ps((float)t.maxX);
+
+            for (int x = startX; x <= t.maxX; x += 4) {
+                __m128 pixel = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                __m128 px = _mm_add_ps(pixel, _mm_set1_ps(0.5f));
+
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(pixel, minPixel), _mm_cmple_ps(pixel, maxPixel));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e0a, px), e0Row), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e1a, px), e1Row), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e2a, px), e2Row), zero));
+
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_max_ps(current, _mm_add_ps(_mm_mul_ps(zA, px), zRow));
+
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+#else
+            for (int x = startX; x <= t.maxX; x++) {
+                float px = x + 0.5f;
+
+                if (x < t.minX ||
+                    e0.a * px + e0.b * py + e0.c < 0.0f ||
+                    e1.a * px + e1.b * py + e1.c < 0.0f ||
+                    e2.a * px + e2.b * py + e2.c < 0.0f) {
+                    continue;
+                }
+
+                row[x] = std::max(row[x], za * px + zb * py + zc);
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::rasterize() {
+    PROFILE_SCOPE("OcclusionCuller::rasterize");
+
+    int bands = std::min(ThreadPool::getThreadCount(), height);
+
+    if (bands == 1 || triangles.size() < minTrianglesForThreading) {
+        rasterizeRows(0, height);
+        return;
+    }
+
+    // bands of rows never share pixels, so no synchronization is needed
+    int rowsPerBand = (height + bands - 1) / bands;
+
+    ThreadPool::parallelFor(bands, [this, rowsPerBand](int band) {
+        PROFILE_SCOPE("rasterize occluders");
+
+        int firstRow = band * rowsPerBand;
+        rasterizeRows(firstRow, std::min(firstRow + rowsPerBand, height));
+    });
+}
+
+bool OcclusionCuller::isOccluded(const AABB &box) {
+    numTested++;
+
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+    float nearest = 0.0f;
+
+    for (int i = 0; i < 8; i++) {
+        vec4 clip = viewProjection * vec4(box.getCorner(i), 1.0f);
+
+        if (clip.z < -clip.w || clip.w <= 0.0f) {
+            return false;
+        }
+
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * width;
+        float y = (clip.y * invW * 0.5f + 0.5f) * height;
+
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::max(nearest, invW);
+    }
+
+    // a little nearer, so occluders never hide their own bounds
+    nearest *= 1.001f;
+
+    int x0 = std::max(0, (int)std::floor(minX));
+    int x1 = std::min(width - 1, (int)std::floor(maxX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int y1 = std::min(height - 1, (int)std::floor(maxY));
+
+    // off screen, frustum culling is responsible for that
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+
+    for (int y = y0; y <= y1; y++) {
+        const float *row = &depth[y * stride];
+
+        for (int x = x0; x <= x1; x++) {
+            if (row[x] <= nearest) {
+                return false;
+            }
+        }
+    }
+
+    numCulled++;
+    return true;
+}
+
+int OcclusionCuller::getWidth() const {
+    return width;
+}
+
+int OcclusionCuller::getHeight() const {
+    return height;
+}
+
+float OcclusionCuller::getDepth(int x, int y) const {
+    return depth[y * stride + x];
+}
+
+int OcclusionCuller::getNumOccluderTriangles() const {
+    return (int)triangles.size();
+}
+
+int OcclusionCuller::getNumTested() const {
+    return numTested;
+}
+
+int OcclusionCuller::getNumCulled() const {
+    return numCulled;
+}
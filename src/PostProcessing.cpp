@@ -3,12 +3,136 @@
 #include <crucible/Window.hpp>
 #include <crucible/Resources.hpp>
 #include <crucible/Resource.h>
+#include <crucible/FramebufferPool.hpp>
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <map>
 #include <random>
+#include <regex>
+
+// keyed by the generated source, steps that appear in several stacks share programs
+static std::map<std::string, Shader> fusedShaders;
+
+static const Shader *getFusedShader(const std::vector<PostProcessor*> &steps, std::vector<std::string> &prefixes) {
+    std::string code = "uniform sampler2D source;\n\n";
+    std::string body;
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        std::string prefix = "stage" + std::to_string(i) + "_";
+        prefixes.push_back(prefix);
+
+        code += std::regex_replace(steps[i]->getFusedSource(), std::regex("STAGE_"), prefix) + "\n\n";
+        body += "    color = " + prefix + "apply(color, texCoord);\n";
+    }
+
+    code += "vec3 postProcess(vec2 texCoord) {\n    vec3 color = texture(source, texCoord).rgb;\n" + body + "    return color;\n}\n";
+
+    auto it = fusedShaders.find(code);
+
+    if (it == fusedShaders.end()) {
+        Shader shader;
+        shader.loadPostProcessing(code);
+
+        it = fusedShaders.insert(std::make_pair(code, shader)).first;
+    }
+
+    return &it->second;
+}
+
+void PostProcessPass::render(const Camera &cam, const Framebuffer &source, const Framebuffer *destination) const {
+    if (!shader) {
+        steps[0]->postProcess(cam, source, *destination);
+        return;
+    }
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        steps[i]->prepareFused(cam, source);
+    }
+
+    // preparing may have drawn into smaller framebuffers
+    if (destination) {
+        destination->bind();
+        glViewport(0, 0, destination->getWidth(), destination->getHeight());
+    }
+    else {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, Window::getWindowSize().x, Window::getWindowSize().y);
+    }
+
+    shader->bind();
+    shader->uniformInt("source", 0);
+    source.getAttachment(0).bind(0);
+
+    int textureUnit = 1;
+    for (size_t i = 0; i < steps.size(); i++) {
+        textureUnit = steps[i]->setFusedUniforms(*shader, prefixes[i], textureUnit);
+    }
+
+    Resources::framebufferMesh.render();
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        steps[i]->finishFused();
+    }
+}
+
+namespace PostProcessing {
+    std::vector<PostProcessPass> buildPasses(const std::vector<PostProcessor*> &steps) {
+        std::vector<PostProcessPass> passes;
+        std::vector<PostProcessor*> run;
+
+        // flushes the run of fusible steps collected so far into one pass
+        auto endRun = [&]() {
+            if (run.empty()) {
+                return;
+            }
+
+            PostProcessPass pass;
+            pass.steps = run;
+            pass.shader = getFusedShader(run, pass.prefixes);
+            passes.push_back(pass);
+
+            run.clear();
+        };
+
+        for (size_t i = 0; i < steps.size(); i++) {
+            PostProcessor *step = steps[i];
+
+            if (step->getFusedSource().empty()) {
+                endRun();
+
+                PostProcessPass pass;
+                pass.steps.push_back(step);
+                passes.push_back(pass);
+            }
+            else {
+                if (step->needsSourceTexture()) {
+                    endRun();
+                }
+
+                run.push_back(step);
+            }
+        }
+
+        endRun();
+
+        return passes;
+    }
+}
+
+PostProcessor::~PostProcessor() {
+}
+
+void PostProcessor::postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination) {
+    if (!getFusedSource().empty()) {
+        std::vector<PostProcessor*> steps;
+        steps.push_back(this);
+
+        PostProcessing::buildPasses(steps)[0].render(cam, source, &destination);
+        return;
+    }
 
-void PostProcessor::postProcess(const Camera &, const Framebuffer &source, const Framebuffer &destination) {
     destination.bind();
     Resources::getPostProcessingShader("resources/invert.glsl").bind();
 
@@ -20,22 +144,40 @@ void PostProcessor::resize() {
 
 }
 
-void FxaaPostProcessor::postProcess(const Camera &, const Framebuffer &source, const Framebuffer &destination) {
-    destination.bind();
-    Resources::fxaaShader.bind();
-    Resources::fxaaShader.uniformInt("source", 0);
+std::string PostProcessor::getFusedSource() const {
+    return "";
+}
 
-    source.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+bool PostProcessor::needsSourceTexture() const {
+    return false;
 }
 
-void TonemapPostProcessor::postProcess(const Camera &, const Framebuffer &source, const Framebuffer &destination) {
-    destination.bind();
-    Resources::tonemapShader.bind();
-    Resources::tonemapShader.uniformInt("source", 0);
+void PostProcessor::prepareFused(const Camera &, const Framebuffer &) {
 
-    source.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+}
+
+int PostProcessor::setFusedUniforms(const Shader &, const std::string &, int textureUnit) {
+    return textureUnit;
+}
+
+void PostProcessor::finishFused() {
+
+}
+
+std::string FxaaPostProcessor::getFusedSource() const {
+    return LOAD_RESOURCE(src_shaders_fxaa_glsl).data();
+}
+
+bool FxaaPostProcessor::needsSourceTexture() const {
+    return true;
+}
+
+std::string TonemapPostProcessor::getFusedSource() const {
+    return LOAD_RESOURCE(src_shaders_tonemap_glsl).data();
+}
+
+std::string GammaCorrectPostProcessor::getFusedSource() const {
+    return LOAD_RESOURCE(src_shaders_gammaCorrect_glsl).data();
 }
 
 
@@ -75,200 +217,206 @@ SsaoPostProcessor::SsaoPostProcessor() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     noiseTex.setID(noiseTexture);
 
-    resize();
+    // std140 pads every array element to a vec4
+    std::vector<vec4> kernel;
+    for (size_t i = 0; i < ssaoKernel.size(); i++) {
+        kernel.push_back(vec4(ssaoKernel[i], 0.0f));
+    }
+
+    glGenBuffers(1, &kernelBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, kernelBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, kernel.size() * sizeof(vec4), &kernel[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void SsaoPostProcessor::postProcess(const Camera &cam, const Framebuffer &source, const Framebuffer &destination) {
-    Framebuffer &gBuffer = Renderer::getGBuffer();
+SsaoPostProcessor::~SsaoPostProcessor() {
+    if (history[0]) {
+        FramebufferPool::release(*history[0]);
+        FramebufferPool::release(*history[1]);
+    }
+
+    glDeleteBuffers(1, &kernelBuffer);
+    noiseTex.destroy();
+}
+
+std::string SsaoPostProcessor::getFusedSource() const {
+    return LOAD_RESOURCE(src_shaders_ssaoBlur_glsl).data();
+}
+
+void SsaoPostProcessor::prepareFused(const Camera &cam, const Framebuffer &) {
     vec2i resolution = Renderer::getResolution();
+    inverseProjection = inverse(cam.getProjection());
+
+    vec2i ssaoResolution = highQuality ? resolution : resolution / 2;
+    FramebufferDesc desc = FramebufferDesc(ssaoResolution.x, ssaoResolution.y).color(GL_RG16F, GL_RG, GL_FLOAT);
+    ssaoBuffer = &FramebufferPool::acquire(desc);
 
-    // render the g-buffers for SSAO
+    // render the g-buffers for SSAO, the upsample and multiply happen in the merged pass
     // ---------------------------------------------
-    glViewport(0, 0, ssaoBuffer.getWidth(), ssaoBuffer.getHeight());
-    ssaoBuffer.bind();
+    glViewport(0, 0, ssaoBuffer->getWidth(), ssaoBuffer->getHeight());
+    ssaoBuffer->bind();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     Resources::ssaoShader.bind();
 
-    Resources::ssaoShader.uniformInt("gPosition", 0);
-    gBuffer.getAttachment(0).bind(0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, KERNEL_BINDING, kernelBuffer);
 
-    Resources::ssaoShader.uniformInt("gNormal", 1);
-    gBuffer.getAttachment(1).bind(1);
+    Renderer::bindGBuffer(Resources::ssaoShader);
 
-    Resources::ssaoShader.uniformInt("texNoise", 2);
-    noiseTex.bind(2);
+    Resources::ssaoShader.uniformInt("texNoise", 4);
+    noiseTex.bind(4);
 
     Resources::ssaoShader.uniformMat4("projection", cam.getProjection());
     Resources::ssaoShader.uniformFloat("radius", ssaoRadius);
     Resources::ssaoShader.uniformFloat("strength", strength);
-    Resources::ssaoShader.uniformInt("kernelSize", ssaoKernelSize);
+    Resources::ssaoShader.uniformInt("kernelSize", std::min(ssaoKernelSize, (int)ssaoKernel.size()));
 
-    Resources::ssaoShader.uniformVec3("noiseScale",  vec3(ssaoBuffer.getWidth()/4.0f, ssaoBuffer.getHeight()/4.0f, 0.0f));
+    Resources::ssaoShader.uniformVec3("noiseScale",  vec3(ssaoBuffer->getWidth()/4.0f, ssaoBuffer->getHeight()/4.0f, 0.0f));
 
-    for (int i = 0; i < ssaoKernelSize; i++) {
-        Resources::ssaoShader.uniformVec3(std::string("samples[") + std::to_string(i) + std::string("]"), ssaoKernel[i]);
-    }
-    Resources::framebufferMesh.render();
+    // the golden angle spreads consecutive rotations evenly
+    float angle = temporal ? (frame % 64) * 2.39996323f : 0.0f;
+    Resources::ssaoShader.uniformVec2("rotation", vec2(cos(angle), sin(angle)));
+    frame++;
 
-    glViewport(0, 0, resolution.x, resolution.y);
-    destination.bind();
-    Resources::ssaoBlurShader.bind();
-    ssaoBuffer.getAttachment(0).bind(0);
-    Resources::ssaoBlurShader.uniformInt("ssao", 0);
-    source.getAttachment(0).bind(1);
-    Resources::ssaoBlurShader.uniformInt("source", 1);
     Resources::framebufferMesh.render();
-}
 
-void SsaoPostProcessor::resize() {
-    vec2i resolution = Renderer::getResolution();
+    if (!temporal) {
+        if (history[0]) {
+            FramebufferPool::release(*history[0]);
+            FramebufferPool::release(*history[1]);
+            history[0] = history[1] = nullptr;
+        }
 
-    ssaoBuffer.destroy();
-    if (highQuality) {
-        ssaoBuffer.setup(resolution.x, resolution.y);
+        hasHistory = false;
+        return;
     }
-    else {
-        ssaoBuffer.setup(resolution.x/2, resolution.y/2);
+
+    if (history[0] && (history[0]->getWidth() != desc.width || history[0]->getHeight() != desc.height)) {
+        FramebufferPool::release(*history[0]);
+        FramebufferPool::release(*history[1]);
+        history[0] = history[1] = nullptr;
+    }
+    if (!history[0]) {
+        history[0] = &FramebufferPool::acquire(desc);
+        history[1] = &FramebufferPool::acquire(desc);
+        hasHistory = false;
     }
-    
-    ssaoBuffer.attachTexture(GL_RED, GL_RED, GL_UNSIGNED_BYTE);
-}
 
+    // accumulate into the older history buffer
+    // ---------------------------------------------
+    history[1]->bind();
+    Resources::ssaoTemporalShader.bind();
 
-static float gaussianDistribution (float x, float sigma)
-{
-    float d = x;
-    float n = 1.0f / (sqrt(2.0f * PI) * sigma);
+    Resources::ssaoTemporalShader.uniformInt("current", 0);
+    ssaoBuffer->getAttachment(0).bind(0);
 
-    return exp(-d*d/(2.0f * sigma * sigma)) * n;
-};
+    Resources::ssaoTemporalShader.uniformInt("history", 1);
+    history[0]->getAttachment(0).bind(1);
 
-static void uniformGaussians(const Shader &s, std::string name, int radius) {
-    for (int i = 0; i < radius; i++) {
-        s.uniformFloat(name + "[" + std::to_string(i) + "]", gaussianDistribution(i, 1.0f));
-    }
+    Renderer::bindGBuffer(Resources::ssaoTemporalShader, 2);
 
-    s.uniformInt(name + "_length", radius);
-}
+    Resources::ssaoTemporalShader.uniformBool("hasHistory", hasHistory);
+    Resources::ssaoTemporalShader.uniformMat4("reprojection", previousView * inverse(cam.getView()));
+    Resources::ssaoTemporalShader.uniformMat4("previousProjection", previousProjection);
+    Resources::ssaoTemporalShader.uniformFloat("blend", temporalBlend);
 
-BloomPostProcessor::BloomPostProcessor() {
-    resize();
+    Resources::framebufferMesh.render();
+
+    std::swap(history[0], history[1]);
+
+    previousView = cam.getView();
+    previousProjection = cam.getProjection();
+    hasHistory = true;
 }
 
-void BloomPostProcessor::postProcess(const Camera &, const Framebuffer &source, const Framebuffer &destination) {
-    vec2i resolution = Renderer::getResolution();
+int SsaoPostProcessor::setFusedUniforms(const Shader &shader, const std::string &prefix, int textureUnit) {
+    Framebuffer *ao = temporal ? history[0] : ssaoBuffer;
 
-    int blurRadius = 8;
+    ao->getAttachment(0).bind(textureUnit);
+    shader.uniformInt(prefix + "ssao", textureUnit);
 
-    glViewport(0, 0, bloomBuffer0.getWidth(), bloomBuffer0.getHeight());
-    bloomBuffer1.bind();
-    Resources::passthroughShader.bind();
-    source.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+    Renderer::getGBufferPosition().bind(textureUnit + 1);
+    shader.uniformInt(prefix + "position", textureUnit + 1);
+    shader.uniformBool(prefix + "compact", Renderer::isGBufferCompact());
+    shader.uniformMat4(prefix + "inverseProjection", inverseProjection);
 
-    bloomBuffer0.bind();
-    Resources::gaussianBlurShader.bind();
-    Resources::gaussianBlurShader.uniformBool("horizontal", true);
-    uniformGaussians(Resources::gaussianBlurShader, "weights", blurRadius);
-    bloomBuffer1.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+    shader.uniformFloat(prefix + "depthSharpness", depthSharpness);
 
-    bloomBuffer1.bind();
-    Resources::gaussianBlurShader.bind();
-    Resources::gaussianBlurShader.uniformBool("horizontal", false);
-    uniformGaussians(Resources::gaussianBlurShader, "weights", blurRadius);
-    bloomBuffer0.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+    return textureUnit + 2;
+}
 
-    // -------------------------------------------------------------------------
+void SsaoPostProcessor::finishFused() {
+    FramebufferPool::release(*ssaoBuffer);
+    ssaoBuffer = nullptr;
+}
 
-    glViewport(0, 0, bloomBuffer3.getWidth(), bloomBuffer3.getHeight());
-    bloomBuffer3.bind();
-    Resources::passthroughShader.bind();
-    bloomBuffer1.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
 
-    bloomBuffer2.bind();
-    Resources::gaussianBlurShader.bind();
-    Resources::gaussianBlurShader.uniformBool("horizontal", true);
-    uniformGaussians(Resources::gaussianBlurShader, "weights", blurRadius);
-    bloomBuffer3.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+BloomPostProcessor::BloomPostProcessor() {
+}
 
-    bloomBuffer3.bind();
-    Resources::gaussianBlurShader.bind();
-    Resources::gaussianBlurShader.uniformBool("horizontal", false);
-    uniformGaussians(Resources::gaussianBlurShader, "weights", blurRadius);
-    bloomBuffer2.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+std::string BloomPostProcessor::getFusedSource() const {
+    return LOAD_RESOURCE(src_shaders_bloom_glsl).data();
+}
+
+bool BloomPostProcessor::needsSourceTexture() const {
+    return true;
+}
 
-    // -------------------------------------------------------------------------
+void BloomPostProcessor::prepareFused(const Camera &, const Framebuffer &source) {
+    vec2i size = Renderer::getResolution();
 
-    glViewport(0, 0, bloomBuffer5.getWidth(), bloomBuffer5.getHeight());
-    bloomBuffer5.bind();
-    Resources::passthroughShader.bind();
-    bloomBuffer3.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+    for (int i = 0; i < std::max(mipLevels, 1); i++) {
+        size = vec2i(std::max(size.x / 2, 1), std::max(size.y / 2, 1));
+        levels.push_back(&FramebufferPool::acquire(FramebufferDesc(size.x, size.y).color(GL_RGB16F, GL_RGB, GL_FLOAT)));
+    }
 
-    bloomBuffer4.bind();
-    Resources::gaussianBlurShader.bind();
-    Resources::gaussianBlurShader.uniformBool("horizontal", true);
-    uniformGaussians(Resources::gaussianBlurShader, "weights", blurRadius);
-    bloomBuffer5.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+    Resources::bloomDownsampleShader.bind();
+    Resources::bloomDownsampleShader.uniformInt("source", 0);
 
-    bloomBuffer5.bind();
-    Resources::gaussianBlurShader.bind();
-    Resources::gaussianBlurShader.uniformBool("horizontal", false);
-    uniformGaussians(Resources::gaussianBlurShader, "weights", blurRadius);
-    bloomBuffer4.getAttachment(0).bind();
-    Resources::framebufferMesh.render();
+    const Framebuffer *previous = &source;
+    for (size_t i = 0; i < levels.size(); i++) {
+        glViewport(0, 0, levels[i]->getWidth(), levels[i]->getHeight());
+        levels[i]->bind();
+        previous->getAttachment(0).bind(0);
+        Resources::framebufferMesh.render();
 
+        previous = levels[i];
+    }
 
-    
-    glViewport(0, 0, resolution.x, resolution.y);
-    destination.bind();
-    Resources::bloomShader.bind();
+    // each level ends up holding itself plus everything below it blurred up
+    GLboolean blending = glIsEnabled(GL_BLEND);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
 
-    source.getAttachment(0).bind(0);
-    Resources::bloomShader.uniformInt("source", 0);
+    Resources::bloomUpsampleShader.bind();
+    Resources::bloomUpsampleShader.uniformInt("source", 0);
+    Resources::bloomUpsampleShader.uniformFloat("radius", upsampleRadius);
 
-    bloomBuffer1.getAttachment(0).bind(1);
-    Resources::bloomShader.uniformInt("bloom0", 1);
+    for (size_t i = levels.size() - 1; i > 0; i--) {
+        glViewport(0, 0, levels[i - 1]->getWidth(), levels[i - 1]->getHeight());
+        levels[i - 1]->bind();
+        levels[i]->getAttachment(0).bind(0);
+        Resources::framebufferMesh.render();
+    }
 
-    bloomBuffer3.getAttachment(0).bind(2);
-    Resources::bloomShader.uniformInt("bloom1", 2);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (!blending) {
+        glDisable(GL_BLEND);
+    }
+}
 
-    bloomBuffer5.getAttachment(0).bind(3);
-    Resources::bloomShader.uniformInt("bloom2", 3);
+int BloomPostProcessor::setFusedUniforms(const Shader &shader, const std::string &prefix, int textureUnit) {
+    levels[0]->getAttachment(0).bind(textureUnit);
+    shader.uniformInt(prefix + "bloom", textureUnit);
 
-    Resources::bloomShader.uniformFloat("bloomStrength", bloomStrength);
+    shader.uniformFloat(prefix + "bloomStrength", bloomStrength);
 
-    Resources::framebufferMesh.render();
+    return textureUnit + 1;
 }
 
-void BloomPostProcessor::resize() {
-    vec2i resolution = Renderer::getResolution();
+void BloomPostProcessor::finishFused() {
+    for (size_t i = 0; i < levels.size(); i++) {
+        FramebufferPool::release(*levels[i]);
+    }
 
-    //bloom framebuffers
-    bloomBuffer0.destroy();
-    bloomBuffer0.setup(resolution.x/2, resolution.y/2);
-    bloomBuffer0.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-    bloomBuffer1.destroy();
-    bloomBuffer1.setup(resolution.x/2, resolution.y/2);
-    bloomBuffer1.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-
-    bloomBuffer2.destroy();
-    bloomBuffer2.setup(resolution.x/8, resolution.y/8);
-    bloomBuffer2.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-    bloomBuffer3.destroy();
-    bloomBuffer3.setup(resolution.x/8, resolution.y/8);
-    bloomBuffer3.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-
-    bloomBuffer4.destroy();
-    bloomBuffer4.setup(resolution.x/16, resolution.y/16);
-    bloomBuffer4.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-    bloomBuffer5.destroy();
-    bloomBuffer5.setup(resolution.x/16, resolution.y/16);
-    bloomBuffer5.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-}
\ No newline at end of file
+    levels.clear();
+}
@@ -0,0 +1,338 @@
+#include <crucible/Profiler.hpp>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+// events a thread can record between two calls to newFrame before the rest of the frame is dropped
+static const uint32_t BUFFER_SIZE = 16384;
+
+/**
+ * Single producer, single consumer ring. The owning thread only writes head, newFrame only writes tail.
+ */
+struct ThreadBuffer {
+    ProfileEvent events[BUFFER_SIZE];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+
+    // cleared when the owning thread exits, the buffer is handed to a new thread once drained
+    std::atomic<bool> active;
+
+    // reused buffers keep their id so short lived workers show up in the same lanes every frame
+    uint32_t thread;
+};
+
+struct ThreadBufferHandle {
+    ThreadBuffer *buffer = nullptr;
+
+    ~ThreadBufferHandle() {
+        if (buffer) {
+            buffer->active.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+// only taken when a thread records its first event and while draining
+static std::mutex buffersMutex;
+static std::vector<ThreadBuffer*> buffers;
+
+static thread_local ThreadBufferHandle threadBuffer;
+static thread_local uint32_t threadDepth = 0;
+
+static ProfileFrame frames[Profiler::MAX_FRAMES];
+static int newestFrame = -1;
+static int numFrames = 0;
+static uint64_t frameStart = 0;
+
+static bool paused = false;
+
+static int selectedAge = 0;
+
+static ThreadBuffer *registerThread() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    ThreadBuffer *buffer = nullptr;
+
+    // threads come and go, reuse the buffers of finished ones
+    for (size_t i = 0; i < buffers.size(); i++) {
+        ThreadBuffer *b = buffers[i];
+
+        if (!b->active.load(std::memory_order_acquire) && b->head.load(std::memory_order_acquire) == b->tail.load(std::memory_order_relaxed)) {
+            buffer = b;
+            break;
+        }
+    }
+
+    if (!buffer) {
+        buffer = new ThreadBuffer();
+        buffer->head.store(0);
+        buffer->tail.store(0);
+        buffer->thread = (uint32_t)buffers.size();
+        buffers.push_back(buffer);
+    }
+
+    buffer->active.store(true, std::memory_order_release);
+
+    threadBuffer.buffer = buffer;
+
+    return buffer;
+}
+
+static ImU32 getColor(const char *name) {
+    // names are literals, hashing the pointer gives every scope a stable color
+    uintptr_t hash = (uintptr_t)name;
+    hash ^= hash >> 13;
+    hash *= 0x5bd1e995u;
+    hash ^= hash >> 15;
+
+    return IM_COL32(90 + (hash & 0x7f), 90 + ((hash >> 8) & 0x7f), 90 + ((hash >> 16) & 0x7f), 255);
+}
+
+static void writeJsonString(std::ofstream &file, const char *str) {
+    file << '"';
+
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            file << '\\' << *c;
+        }
+        else if ((unsigned char)*c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)*c);
+            file << escaped;
+        }
+        else {
+            file << *c;
+        }
+    }
+
+    file << '"';
+}
+
+namespace Profiler {
+    bool enabled = true;
+
+    uint64_t now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void record(const char *name, uint64_t start, uint64_t end, uint32_t depth) {
+        ThreadBuffer *buffer = threadBuffer.buffer;
+
+        if (!buffer) {
+            buffer = registerThread();
+        }
+
+        uint32_t head = buffer->head.load(std::memory_order_relaxed);
+        uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+
+        if (head - tail >= BUFFER_SIZE) {
+            return;
+        }
+
+        ProfileEvent &event = buffer->events[head % BUFFER_SIZE];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        event.thread = buffer->thread;
+        event.depth = depth;
+
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    void newFrame() {
+        uint64_t frameEnd = now();
+
+        ProfileFrame *frame = nullptr;
+
+        if (!paused && frameStart != 0) {
+            newestFrame = (newestFrame + 1) % MAX_FRAMES;
+            numFrames = std::min(numFrames + 1, (int)MAX_FRAMES);
+
+            frame = &frames[newestFrame];
+            frame->start = frameStart;
+            frame->end = frameEnd;
+            frame->events.clear();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+
+            // drained even while paused so threads never run out of space
+            for (size_t i = 0; i < buffers.size(); i++) {
+                ThreadBuffer *buffer = buffers[i];
+
+                uint32_t head = buffer->head.load(std::memory_order_acquire);
+                uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+
+                if (frame) {
+                    for (uint32_t j = tail; j != head; j++) {
+                        frame->events.push_back(buffer->events[j % BUFFER_SIZE]);
+                    }
+                }
+
+                buffer->tail.store(head, std::memory_order_release);
+            }
+        }
+
+        if (frame) {
+            std::sort(frame->events.begin(), frame->events.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+                if (a.thread != b.thread) {
+                    return a.thread < b.thread;
+                }
+
+                return a.start < b.start;
+            });
+        }
+
+        frameStart = frameEnd;
+    }
+
+    void setPaused(bool p) {
+        paused = p;
+    }
+
+    bool isPaused() {
+        return paused;
+    }
+
+    int getNumFrames() {
+        return numFrames;
+    }
+
+    const ProfileFrame &getFrame(int age) {
+        static ProfileFrame empty;
+
+        if (age < 0 || age >= numFrames) {
+            return empty;
+        }
+
+        return frames[(newestFrame - age + MAX_FRAMES) % MAX_FRAMES];
+    }
+
+    void renderImGui() {
+        if (ImGui::Button(paused ? "resume" : "pause")) {
+            paused = !paused;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("export trace")) {
+            exportChromeTrace("profile.json");
+        }
+
+        if (numFrames == 0) {
+            return;
+        }
+
+        ImGui::SliderInt("frame age", &selectedAge, 0, numFrames - 1);
+        selectedAge = std::min(selectedAge, numFrames - 1);
+
+        const ProfileFrame &frame = getFrame(selectedAge);
+        double frameLength = (double)std::max(frame.end - frame.start, (uint64_t)1);
+
+        ImGui::Text("frame: %.3f ms, %d events", frameLength * 0.000001, (int)frame.events.size());
+
+        ImDrawList *drawList = ImGui::GetWindowDrawList();
+        float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+        float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+
+        size_t i = 0;
+        while (i < frame.events.size()) {
+            uint32_t thread = frame.events[i].thread;
+
+            ImGui::Text("thread %u", thread);
+
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            uint32_t maxDepth = 0;
+
+            for (; i < frame.events.size() && frame.events[i].thread == thread; i++) {
+                const ProfileEvent &event = frame.events[i];
+                maxDepth = std::max(maxDepth, event.depth);
+
+                // events of worker threads may start before the frame they were collected in
+                double start = std::max((double)event.start - (double)frame.start, 0.0);
+                double end = std::max((double)event.end - (double)frame.start, start);
+
+                ImVec2 min(origin.x + (float)(start / frameLength) * width, origin.y + event.depth * rowHeight);
+                ImVec2 max(std::max(origin.x + (float)(end / frameLength) * width, min.x + 1.0f), min.y + rowHeight - 1.0f);
+
+                drawList->AddRectFilled(min, max, getColor(event.name));
+
+                if (max.x - min.x > 20.0f) {
+                    drawList->PushClipRect(min, max, true);
+                    drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+                    drawList->PopClipRect();
+                }
+
+                if (ImGui::IsMouseHoveringRect(min, max)) {
+                    ImGui::SetTooltip("%s: %.3f ms", event.name, (event.end - event.start) * 0.000001);
+                }
+            }
+
+            ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+        }
+    }
+
+    bool exportChromeTrace(const std::string &path) {
+        std::ofstream file(path);
+
+        if (!file.is_open()) {
+            std::cout << "Could not write profile trace " << path << std::endl;
+            return false;
+        }
+
+        file << "{\"traceEvents\":[";
+
+        bool first = true;
+        char number[64];
+
+        for (int age = numFrames - 1; age >= 0; age--) {
+            const ProfileFrame &frame = getFrame(age);
+
+            for (size_t i = 0; i < frame.events.size(); i++) {
+                const ProfileEvent &event = frame.events[i];
+
+                file << (first ? "\n" : ",\n") << "{\"name\":";
+                writeJsonString(file, event.name);
+
+                // trace timestamps are in microseconds
+                snprintf(number, sizeof(number), "%.3f", event.start * 0.001);
+                file << ",\"ph\":\"X\",\"ts\":" << number;
+                snprintf(number, sizeof(number), "%.3f", (event.end - event.start) * 0.001);
+                file << ",\"dur\":" << number << ",\"pid\":1,\"tid\":" << event.thread << "}";
+
+                first = false;
+            }
+        }
+
+        file << "\n]}\n";
+
+        return true;
+    }
+}
+
+ProfileScope::ProfileScope(const char *name) {
+    if (!Profiler::enabled) {
+        this->name = nullptr;
+        return;
+    }
+
+    this->name = name;
+    this->depth = threadDepth++;
+    this->start = Profiler::now();
+}
+
+ProfileScope::~ProfileScope() {
+    if (!name) {
+        return;
+    }
+
+    threadDepth--;
+    Profiler::record(name, start, Profiler::now(), depth);
+}
@@ -1,5 +1,6 @@
 #include <crucible/Renderer.hpp>
 #include <crucible/Framebuffer.hpp>
+#include <crucible/FramebufferPool.hpp>
 #include <crucible/Window.hpp>
 #include <crucible/Camera.hpp>
 #include <crucible/AABB.hpp>
@@ -13,45 +14,442 @@
 #include <crucible/DebugRenderer.hpp>
 #include <crucible/Resources.hpp>
 #include <crucible/Resource.h>
+#include <crucible/LightClusters.hpp>
+#include <crucible/ShadowAtlas.hpp>
+#include <crucible/HiZBuffer.hpp>
+#include <crucible/OcclusionCuller.hpp>
+#include <crucible/GpuProfiler.hpp>
+#include <crucible/Profiler.hpp>
+#include <crucible/Hash.hpp>
 
 #include <glad/glad.h>
 
 #include <imgui.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
 
 static std::vector<RenderCall> renderQueue;
 static std::vector<RenderCall> renderQueueForward;
 static std::vector<PointLight*> pointLights;
+static std::vector<PointLight*> clusteredLights;
+static std::vector<PointLight*> volumeLights;
 static std::vector<DirectionalLight*> directionalLights;
 
-static Framebuffer gBuffer;
+// both are held from the framebuffer pool, sized to the current render resolution
+static Framebuffer *gBuffer = nullptr;
+static Framebuffer *HDRbuffer = nullptr;
+
+// layout the g-buffer was allocated with, compactGBuffer only takes effect in resize
+static bool gBufferCompact = false;
+static mat4 gBufferInverseProjection;
+
+static LightClusters lightClusters;
+static ShadowAtlas shadowAtlas;
+static HiZBuffer hiZBuffer;
+static OcclusionCuller occlusionCuller;
+
+struct Occluder {
+    const Mesh *mesh;
+    const Transform *transform;
+};
+
+static std::vector<Occluder> occluders;
+
+static std::vector<const IBL::Probe*> probes;
+
+// units of the two blended probes' irradiance and prefiltered maps in the ambient pass
+static const int ambientProbeUnit = 7;
+
+// spherical harmonics probes blended in the ambient pass, must match deferred_ambient.glsl
+static const int maxSHProbes = 16;
+
+// the software depth buffer only needs to be fine enough for object sized bounds
+static const int occlusionBufferWidth = 256;
+static const int occlusionBufferHeight = 128;
+
+// first of the four texture units the cluster buffers are bound to, after the g-buffer attachments
+static const int lightClusterUnit = 4;
+static const int shadowAtlasUnit = 8;
+
+// the 16x16 sphere mesh is inscribed in the unit sphere, scaled up so its faces enclose the whole light radius
+static const float lightVolumeScale = 1.05f;
 
 static vec2i resolution;
 
 static vec3 clearColor;
 
-static GLuint queries[4]; // The unique query id
-static GLuint queryResults[4]; // Save the time, in nanoseconds
+// glad only loads GL 3.3, multi draw indirect is looked up at runtime
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+static PFNMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+
+static GLuint indirectBuffer = 0;
+static GLuint modelMatrixBuffer = 0;
+static GLuint modelMatrixTexture = 0;
+
+// texture unit the per draw model matrices are bound to, kept clear of material textures
+static const int modelMatrixUnit = 15;
+
+struct IndirectDraw {
+    const Material *material;
+    GeometryPool *pool;
+    int indexType;
+    DrawElementsIndirectCommand command;
+    mat4 model;
+};
+
+struct IndirectBatch {
+    const Material *material;
+    GeometryPool *pool;
+    int indexType;
+    size_t first;
+    size_t count;
+};
+
+static std::vector<IndirectDraw> indirectDraws;
+static std::vector<IndirectBatch> indirectBatches;
+static std::vector<DrawElementsIndirectCommand> indirectCommands;
+static std::vector<float> indirectMatrices;
+
+static int indirectDrawCount = 0;
+static int indirectBatchCount = 0;
+
+static bool usedDepthPrepass = false;
+static float estimatedOverdraw = 0.0f;
+
+static int selectLod(const RenderCall &call, const Camera &cam) {
+    int numLods = call.mesh->getNumLods();
+
+    if (numLods <= 1) {
+        return 0;
+    }
+    if (call.lodOverride >= 0) {
+        return std::min(call.lodOverride, numLods - 1);
+    }
+
+    const AABB *bounds = call.mesh->getBounds();
+    mat4 model = call.transform ? call.transform->getMatrix() : mat4();
+
+    // errors are in object space, scale them by the largest axis of the model matrix
+    float scale = std::max(length(vec3(model.m00, model.m10, model.m20)), std::max(length(vec3(model.m01, model.m11, model.m21)), length(vec3(model.m02, model.m12, model.m22))));
+
+    vec3 center = vec3(model.m03, model.m13, model.m23);
+    float radius = 0.0f;
+
+    if (bounds) {
+        center = vec3(model * vec4((bounds->min + bounds->max) * 0.5f, 1.0f));
+        radius = length(bounds->max - bounds->min) * 0.5f * scale;
+    }
+
+    float pixelsPerUnit;
+
+    if (cam.orthographic) {
+        pixelsPerUnit = resolution.y / cam.dimensions.y;
+    }
+    else {
+        float distance = std::max(length(center - cam.position) - radius, cam.nearPlane);
+
+        pixelsPerUnit = resolution.y / (2.0f * tanf(radians(cam.fov) * 0.5f) * distance);
+    }
+
+    int previous = call.lodState ? *call.lodState : numLods - 1;
+    int lod = 0;
+
+    for (int i = 1; i < numLods; i++) {
+        float threshold = Renderer::lodThreshold;
+
+        if (i > previous) {
+            threshold *= 1.0f - Renderer::lodHysteresis;
+        }
+
+        if (call.mesh->getLodError(i) * scale * pixelsPerUnit > threshold) {
+            break;
+        }
+
+        lod = i;
+    }
+
+    return lod;
+}
+
+// only the main view keeps the selection for next frame's hysteresis, other views would make it jump between theirs
+static void selectLods(std::vector<RenderCall> &buffer, const Camera &cam, bool persist) {
+    for (RenderCall &call : buffer) {
+        call.lod = selectLod(call, cam);
+
+        if (persist && call.lodState) {
+            *call.lodState = call.lod;
+        }
+    }
+}
+
+/**
+ * Summed fraction of the screen covered by the bounds of the visible draws, roughly how many fragments the g-buffer
+ * pass shades per pixel. Draws without bounds aren't counted.
+ */
+static float estimateOverdraw(const std::vector<RenderCall> &buffer, const Camera &cam, const Frustum &f, bool doFrustumCulling) {
+    mat4 viewProjection = cam.getProjection() * cam.getView();
+    float coverage = 0.0f;
+
+    for (const RenderCall &call : buffer) {
+        if (!call.hasBounds || (doFrustumCulling && !f.isBoxInside(call.bounds))) {
+            continue;
+        }
+
+        float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+        int behind = 0;
+
+        for (int i = 0; i < 8; i++) {
+            vec4 clip = viewProjection * vec4(call.bounds.getCorner(i), 1.0f);
+
+            if (clip.z < -clip.w || clip.w <= 0.0f) {
+                behind++;
+                continue;
+            }
+
+            minX = std::min(minX, clip.x / clip.w);
+            maxX = std::max(maxX, clip.x / clip.w);
+            minY = std::min(minY, clip.y / clip.w);
+            maxY = std::max(maxY, clip.y / clip.w);
+        }
+
+        if (behind == 8) {
+            continue;
+        }
+
+        // the camera is inside or right in front of it
+        if (behind > 0) {
+            coverage += 1.0f;
+            continue;
+        }
+
+        float width = std::min(maxX, 1.0f) - std::max(minX, -1.0f);
+        float height = std::min(maxY, 1.0f) - std::max(minY, -1.0f);
+
+        if (width > 0.0f && height > 0.0f) {
+            coverage += width * height * 0.25f;
+        }
+    }
+
+    return coverage;
+}
+
+static bool hasExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (GLint i = 0; i < count; i++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void loadMultiDrawIndirect() {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+    // the draw id comes from baseInstance, so base instance support is needed as well
+    bool supported = major > 4 || (major == 4 && minor >= 3) ||
+            (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance"));
+
+    if (supported) {
+        multiDrawElementsIndirect = (PFNMULTIDRAWELEMENTSINDIRECTPROC)Window::getProcAddress("glMultiDrawElementsIndirect");
+    }
+
+    if (!multiDrawElementsIndirect) {
+        std::cout << "multi draw indirect is not available, falling back to individual draw calls" << std::endl;
+        return;
+    }
+
+    glGenBuffers(1, &indirectBuffer);
+    glGenBuffers(1, &modelMatrixBuffer);
+    glGenTextures(1, &modelMatrixTexture);
+}
+
+/**
+ * Radius of a point light's bounding sphere projected to the screen, as a fraction of the screen height. Returns a
+ * negative value if the light is entirely behind the camera and a very large one if the sphere crosses the near plane.
+ */
+static float getProjectedLightRadius(const PointLight &light, const Camera &cam, const mat4 &view, const mat4 &projection) {
+    vec3 center = vec3(vec4(light.m_position, 1.0f) * view);
+    float depth = -center.z;
+
+    if (depth + light.m_radius < cam.nearPlane) {
+        return -1.0f;
+    }
+    if (cam.orthographic) {
+        return light.m_radius * projection.m11 * 0.5f;
+    }
+    if (depth - light.m_radius <= cam.nearPlane) {
+        return 1000.0f;
+    }
+
+    return light.m_radius * projection.m11 / sqrt(depth * depth - light.m_radius * light.m_radius) * 0.5f;
+}
+
+/**
+ * Smallest world space box around object space bounds moved by model.
+ */
+static AABB transformBounds(const AABB &bounds, const mat4 &model) {
+    vec3 center = vec3(model * vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+    vec3 extents = (bounds.max - bounds.min) * 0.5f;
+
+    vec3 worldExtents = vec3(
+        std::abs(model.m00) * extents.x + std::abs(model.m01) * extents.y + std::abs(model.m02) * extents.z,
+        std::abs(model.m10) * extents.x + std::abs(model.m11) * extents.y + std::abs(model.m12) * extents.z,
+        std::abs(model.m20) * extents.x + std::abs(model.m21) * extents.y + std::abs(model.m22) * extents.z
+    );
+
+    return AABB(center - worldExtents, center + worldExtents);
+}
+
+/**
+ * Returns the mesh of a render call if it can be drawn through multi draw indirect, or nullptr.
+ */
+static const Mesh *getIndirectMesh(const RenderCall &call) {
+    if (!multiDrawElementsIndirect || !Renderer::useMultiDrawIndirect || call.bones) {
+        return nullptr;
+    }
+
+    const Mesh *mesh = dynamic_cast<const Mesh*>(call.mesh);
+
+    if (!mesh || !mesh->getPool() || mesh->renderMode != GL_TRIANGLES) {
+        return nullptr;
+    }
+
+    return mesh;
+}
+
+static void addIndirectDraw(const RenderCall &call, const Mesh *mesh, const Material *material) {
+    IndirectDraw draw;
+    draw.material = material;
+    draw.pool = mesh->getPool();
+    draw.indexType = mesh->getIndexType();
+    draw.model = call.transform ? call.transform->getMatrix() : mat4();
+    mesh->getIndirectCommand(call.lod, draw.command);
+
+    indirectDraws.push_back(draw);
+}
+
+/**
+ * Sorts the collected indirect draws into batches that can share one multi draw call and uploads their commands and
+ * model matrices. The draw index is stored in baseInstance so shaders can fetch their matrix with it.
+ */
+static void uploadIndirectDraws() {
+    indirectBatches.clear();
+
+    if (indirectDraws.empty()) {
+        return;
+    }
+
+    std::stable_sort(indirectDraws.begin(), indirectDraws.end(), [](const IndirectDraw &a, const IndirectDraw &b) {
+        if (a.material != b.material) return a.material < b.material;
+        if (a.pool != b.pool) return a.pool < b.pool;
+        return a.indexType < b.indexType;
+    });
+
+    indirectCommands.resize(indirectDraws.size());
+    indirectMatrices.resize(indirectDraws.size() * 16);
+
+    for (size_t i = 0; i < indirectDraws.size(); i++) {
+        const IndirectDraw &draw = indirectDraws[i];
+
+        indirectCommands[i] = draw.command;
+        indirectCommands[i].baseInstance = (unsigned int)i;
+
+        // one column per texel
+        const mat4 &m = draw.model;
+        float columns[16] = {
+            m.m00, m.m10, m.m20, m.m30,
+            m.m01, m.m11, m.m21, m.m31,
+            m.m02, m.m12, m.m22, m.m32,
+            m.m03, m.m13, m.m23, m.m33
+        };
+        memcpy(&indirectMatrices[i * 16], columns, sizeof(columns));
+
+        if (indirectBatches.empty() || indirectBatches.back().material != draw.material || indirectBatches.back().pool != draw.pool || indirectBatches.back().indexType != draw.indexType) {
+            indirectBatches.push_back({draw.material, draw.pool, draw.indexType, i, 0});
+        }
+        indirectBatches.back().count++;
+    }
+
+    GeometryPool::reserveDrawIds(indirectDraws.size());
+
+    glBindBuffer(GL_TEXTURE_BUFFER, modelMatrixBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, indirectMatrices.size() * sizeof(float), &indirectMatrices[0], GL_STREAM_DRAW);
+
+    glActiveTexture(GL_TEXTURE0 + modelMatrixUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, modelMatrixTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, modelMatrixBuffer);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCommands.size() * sizeof(DrawElementsIndirectCommand), &indirectCommands[0], GL_STREAM_DRAW);
 
-static void beginQuery(int id) {
-    glGetQueryObjectuiv(queries[id], GL_QUERY_RESULT, &queryResults[id]);
-    glBeginQuery(GL_TIME_ELAPSED, queries[id]);
+    indirectDrawCount += indirectDraws.size();
+    indirectBatchCount += indirectBatches.size();
+
+    indirectDraws.clear();
+}
+
+static void drawIndirectBatch(const IndirectBatch &batch) {
+    batch.pool->bind();
+
+    multiDrawElementsIndirect(GL_TRIANGLES, batch.indexType, (const void*)(batch.first * sizeof(DrawElementsIndirectCommand)), batch.count, 0);
 }
 
-static void endQuery() {
-    glEndQuery(GL_TIME_ELAPSED);
+/**
+ * Draws that went through the depth prepass only pass where they match it and leave depth alone, the others test and
+ * write depth as usual.
+ */
+static void setDepthEqual(bool equal) {
+    glDepthFunc(equal ? GL_EQUAL : GL_LEQUAL);
+    glDepthMask(equal ? GL_FALSE : GL_TRUE);
 }
 
-static void iterateCommandBuffer(std::vector<RenderCall> &buffer, const Camera &cam, const Frustum &f, bool doFrustumCulling) {
+static void iterateCommandBuffer(std::vector<RenderCall> &buffer, const Camera &cam, const Frustum &f, bool doFrustumCulling, bool allowIndirect = false, OcclusionCuller *culler = nullptr) {
     const Material *lastMaterial = nullptr;
+    bool depthEqual = false;
+    bool indirectPrepassed = false;
 
     for (RenderCall &call : buffer) {
-        if (doFrustumCulling) {
-            if (!f.isBoxInside(*call.aabb)) {
+        if (doFrustumCulling && call.hasBounds) {
+            if (!f.isBoxInside(call.bounds)) {
+                continue;
+            }
+
+            if (culler && culler->isOccluded(call.bounds)) {
                 continue;
             }
         }
 
+        // static pooled meshes with the standard shader are collected and drawn in batches below
+        if (allowIndirect && call.material->getShader().getID() == Resources::standardShader.getID()) {
+            const Mesh *mesh = getIndirectMesh(call);
+
+            if (mesh) {
+                addIndirectDraw(call, mesh, call.material);
+                indirectPrepassed |= call.depthPrepassed;
+                continue;
+            }
+        }
+
+        if (call.depthPrepassed != depthEqual) {
+            depthEqual = call.depthPrepassed;
+            setDepthEqual(depthEqual);
+        }
+
         Shader s = call.material->getShader();
 
         if (call.material != lastMaterial) {
@@ -62,6 +460,9 @@ static void iterateCommandBuffer(std::vector<RenderCall> &buffer, const Camera &
             s.uniformMat4("view", cam.getView());
             s.uniformMat4("projection", cam.getProjection());
 
+            s.uniformBool("indirect", false);
+            s.uniformInt("modelMatrices", modelMatrixUnit);
+            s.uniformBool("compactGBuffer", gBufferCompact);
         }
 
         if (call.bones) {
@@ -87,29 +488,153 @@ static void iterateCommandBuffer(std::vector<RenderCall> &buffer, const Camera &
         }
         
 
-        call.mesh->render();
+        call.mesh->renderLod(call.lod);
 
         lastMaterial = call.material;
     }
+
+    if (allowIndirect) {
+        uploadIndirectDraws();
+
+        // uniforms have to be rebound even for the last material of the loop above, it drew with indirect off
+        lastMaterial = nullptr;
+
+        // the prepass draws every standard shader call, so either all batched draws were in it or none
+        if (indirectPrepassed != depthEqual) {
+            depthEqual = indirectPrepassed;
+            setDepthEqual(depthEqual);
+        }
+
+        for (const IndirectBatch &batch : indirectBatches) {
+            Shader s = batch.material->getShader();
+
+            if (batch.material != lastMaterial) {
+                s.bind();
+                batch.material->bindUniforms();
+
+                s.uniformVec3("cameraPos", cam.position);
+                s.uniformMat4("view", cam.getView());
+                s.uniformMat4("projection", cam.getProjection());
+
+                s.uniformBool("doAnimation", false);
+                s.uniformBool("indirect", true);
+                s.uniformInt("modelMatrices", modelMatrixUnit);
+                s.uniformBool("compactGBuffer", gBufferCompact);
+            }
+
+            drawIndirectBatch(batch);
+
+            lastMaterial = batch.material;
+        }
+
+        if (!indirectBatches.empty()) {
+            Resources::standardShader.bind();
+            Resources::standardShader.uniformBool("indirect", false);
+        }
+    }
+
+    if (depthEqual) {
+        setDepthEqual(false);
+    }
 }
 
-static void iterateCommandBufferDepthOnly(std::vector<RenderCall> &buffer, const Camera &cam, const Frustum &f, bool doFrustumCulling) {
-    Resources::ShadowShader.bind();
+/**
+ * With prepass set, draws the standard shader calls of the g-buffer queue with the alpha cutout of their albedo and
+ * marks them, so iterateCommandBuffer can draw them with an equal depth test. Otherwise draws everything for shadows.
+ */
+static void iterateCommandBufferDepthOnly(std::vector<RenderCall> &buffer, const Camera &cam, const Frustum &f, bool doFrustumCulling, bool prepass = false) {
+    const Shader &shader = prepass ? Resources::depthPrepassShader : Resources::ShadowShader;
+
+    shader.bind();
+
+    shader.uniformMat4("view", cam.getView());
+    shader.uniformMat4("projection", cam.getProjection());
+    shader.uniformBool("indirect", false);
+    shader.uniformInt("modelMatrices", modelMatrixUnit);
+    shader.uniformBool("albedoTextured", false);
+    shader.uniformInt("albedoTex", 0);
+
+    for (RenderCall &c : buffer) {
+        if (doFrustumCulling && c.hasBounds) {
+            if (!f.isBoxInside(c.bounds)) {
+                continue;
+            }
+        }
+
+        if (prepass) {
+            // other shaders may move vertices or discard differently, they are left to the g-buffer pass
+            if (c.material->getShader().getID() != Resources::standardShader.getID()) {
+                continue;
+            }
+
+            c.depthPrepassed = true;
 
-    Resources::ShadowShader.uniformMat4("view", cam.getView());
-    Resources::ShadowShader.uniformMat4("projection", cam.getProjection());
-    
-    for (RenderCall c : buffer) {
-        if (doFrustumCulling) {
-            if (!f.isBoxInside(*c.aabb)) {
+            const std::map<std::string, bool> &bools = c.material->getBoolUniforms();
+            const std::map<std::string, UniformTexture> &textures = c.material->getTextureUniforms();
+
+            auto textured = bools.find("albedoTextured");
+            auto albedo = textures.find("albedoTex");
+
+            // cutouts need the texture, they are drawn on their own
+            if (textured != bools.end() && textured->second && albedo != textures.end()) {
+                albedo->second.tex.bind(0);
+
+                shader.uniformBool("albedoTextured", true);
+                shader.uniformMat4("model", c.transform ? c.transform->getMatrix() : mat4());
+
+                c.mesh->renderLod(c.lod);
+
+                shader.uniformBool("albedoTextured", false);
                 continue;
             }
         }
 
-        Resources::ShadowShader.uniformMat4("model", c.transform->getMatrix());
+        const Mesh *mesh = getIndirectMesh(c);
+
+        if (mesh) {
+            // materials don't matter for depth, so everything in the same pool ends up in one batch
+            addIndirectDraw(c, mesh, nullptr);
+            continue;
+        }
+
+        shader.uniformMat4("model", c.transform ? c.transform->getMatrix() : mat4());
 
-        c.mesh->render();
+        c.mesh->renderLod(c.lod);
     }
+
+    uploadIndirectDraws();
+
+    if (!indirectBatches.empty()) {
+        shader.uniformBool("indirect", true);
+
+        for (const IndirectBatch &batch : indirectBatches) {
+            drawIndirectBatch(batch);
+        }
+
+        shader.uniformBool("indirect", false);
+    }
+}
+
+static FramebufferDesc getGBufferDesc(int width, int height, bool compact) {
+    if (compact) {
+        // position comes from the depth texture
+        return FramebufferDesc(width, height)
+            .color(GL_RG16, GL_RG, GL_UNSIGNED_SHORT) //octahedral normal
+            .color(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE) //color + specular
+            .color(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE) //roughness + metallic + ao + emission
+            .depthTexture();
+    }
+
+    return FramebufferDesc(width, height)
+        .color(GL_RGB16F, GL_RGB, GL_FLOAT) //position
+        .color(GL_RGB16F, GL_RGB, GL_FLOAT) //normal
+        .color(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE) //color + specular
+        .color(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE) //roughness + metallic + 2 extra channels
+        .depth();
+}
+
+static FramebufferDesc getHDRDesc(int width, int height) {
+    return FramebufferDesc(width, height).color(GL_RGB16F, GL_RGB, GL_FLOAT).depth();
 }
 
 namespace Renderer {
@@ -118,18 +643,40 @@ namespace Renderer {
     Cubemap irradiance;
     Cubemap specular;
 
-    
-    Framebuffer HDRbuffer;
-    Framebuffer HDRbuffer2;
 
     std::vector<std::shared_ptr<PostProcessor>> postProcessingStack;
 
+    float lodThreshold = 1.0f;
+    float lodHysteresis = 0.25f;
+
+    bool useMultiDrawIndirect = true;
+
+    bool useOcclusionCulling = true;
+
+    bool compactGBuffer = false;
+
+    PointLightMode pointLightMode = POINT_LIGHTS_AUTO;
+
+    DepthPrepassMode depthPrepassMode = DEPTH_PREPASS_AUTO;
+
+    float depthPrepassThreshold = 2.5f;
+
+    float lightVolumeThreshold = 0.25f;
+
+    int shadowAtlasSize = 4096;
+
+    bool buildHiZBuffer = false;
+
     void init(int resolutionX, int resolutionY) {
         resolution = vec2i(resolutionX, resolutionY);
 
         Resources::loadDefaultResources();
 
-        glGenQueries(4, queries);
+        loadMultiDrawIndirect();
+
+        lightClusters.setup();
+        shadowAtlas.setup(shadowAtlasSize);
+        occlusionCuller.setup(occlusionBufferWidth, occlusionBufferHeight);
 
         glEnable(GL_CULL_FACE);
         glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
@@ -141,23 +688,18 @@ namespace Renderer {
     void resize(int resolutionX, int resolutionY) {
         resolution = vec2i(resolutionX, resolutionY);
 
-        HDRbuffer.destroy();
-        HDRbuffer.setup(resolution.x, resolution.y);
-        HDRbuffer.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-        HDRbuffer.attachRBO();
+        // the old targets stay in the pool for a few frames, resizing back to a recent size costs nothing
+        if (gBuffer) {
+            FramebufferPool::release(*gBuffer);
+            FramebufferPool::release(*HDRbuffer);
+        }
 
-        HDRbuffer2.destroy();
-        HDRbuffer2.setup(resolution.x, resolution.y);
-        HDRbuffer2.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT);
-        HDRbuffer2.attachRBO();
+        gBufferCompact = compactGBuffer;
+        gBuffer = &FramebufferPool::acquire(getGBufferDesc(resolution.x, resolution.y, gBufferCompact));
+        HDRbuffer = &FramebufferPool::acquire(getHDRDesc(resolution.x, resolution.y));
 
-        gBuffer.destroy();
-        gBuffer.setup(resolution.x, resolution.y);
-        gBuffer.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT); //position
-        gBuffer.attachTexture(GL_RGB16F, GL_RGB, GL_FLOAT); //normal
-        gBuffer.attachTexture(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE); //color + specular
-        gBuffer.attachTexture(GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE); //roughness + metallic + 2 extra channels
-        gBuffer.attachRBO();
+        // allocated again by the next flush that builds it
+        hiZBuffer.destroy();
 
         for (size_t i = 0; i < postProcessingStack.size(); i++) {
             postProcessingStack[i]->resize();
@@ -178,13 +720,31 @@ namespace Renderer {
         directionalLights.push_back(light);
     }
 
-    void render(const IRenderable *mesh, const Material *material, const Transform *transform, const AABB *aabb, const Bone *bones) {
+    void render(const IRenderable *mesh, const Material *material, const Transform *transform, const AABB *aabb, const Bone *bones, int lodOverride, int *lodState) {
         RenderCall call;
         call.mesh = mesh;
         call.material = material;
         call.transform = transform;
-        call.aabb = aabb;
         call.bones = bones;
+        call.hasBounds = false;
+        call.lodOverride = lodOverride;
+        call.lodState = lodState;
+        call.lod = 0;
+        call.depthPrepassed = false;
+
+        if (aabb) {
+            call.bounds = *aabb;
+            call.hasBounds = true;
+        }
+        else if (!bones) {
+            // skinned meshes move away from their bind pose bounds
+            const AABB *meshBounds = mesh->getBounds();
+
+            if (meshBounds) {
+                call.bounds = transformBounds(*meshBounds, transform ? transform->getMatrix() : mat4());
+                call.hasBounds = true;
+            }
+        }
 
         if (material->deferred) {
             renderQueue.push_back(call);
@@ -201,6 +761,20 @@ namespace Renderer {
         }
     }
 
+    void renderOccluder(const Mesh *mesh, const Transform *transform) {
+        occluders.push_back({mesh, transform});
+    }
+
+    void renderOccluder(const Model *model, const Transform *transform) {
+        for (unsigned int i = 0; i < model->nodes.size(); i++) {
+            renderOccluder(model->nodes[i].mesh, transform);
+        }
+    }
+
+    void renderProbe(const IBL::Probe *probe) {
+        probes.push_back(probe);
+    }
+
     void renderSkybox(const Material *material) {
         render(&Resources::cubemapMesh, material, nullptr, nullptr, nullptr);
     }
@@ -214,44 +788,204 @@ namespace Renderer {
         iterateCommandBufferDepthOnly(renderQueue, cam, f, doFrustumCulling);        
     }
 
-    void renderToFramebuffer(const Camera &cam, const Frustum &f, bool doFrustumCulling) {
+    void renderToDepth(const Framebuffer &target, const vec4i &viewport, const Camera &cam, const Frustum &f, bool doFrustumCulling) {
+        target.bind();
+        glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(viewport.x, viewport.y, viewport.z, viewport.w);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+
+        iterateCommandBufferDepthOnly(renderQueue, cam, f, doFrustumCulling);
+    }
+
+    unsigned int getShadowCasterHash(const Frustum &f, bool doFrustumCulling) {
+        // bone poses are left out since the depth pass draws skinned meshes in their bind pose
+        unsigned int hash = Hash::OFFSET_BASIS;
+
+        for (const RenderCall &c : renderQueue) {
+            if (doFrustumCulling && c.hasBounds) {
+                if (!f.isBoxInside(c.bounds)) {
+                    continue;
+                }
+            }
+
+            hash = Hash::fnv1a(hash, &c.mesh, sizeof(c.mesh));
+            hash = Hash::fnv1a(hash, &c.lod, sizeof(c.lod));
+
+            if (c.transform) {
+                hash = Hash::fnv1a(hash, &c.transform->position, sizeof(vec3));
+                hash = Hash::fnv1a(hash, &c.transform->rotation, sizeof(quaternion));
+                hash = Hash::fnv1a(hash, &c.transform->scale, sizeof(vec3));
+            }
+        }
+
+        return hash;
+    }
+
+    unsigned int getSceneHash() {
+        // pointers and GL names change between launches, so only values are hashed
+        unsigned int hash = Hash::OFFSET_BASIS;
+
+        const std::vector<RenderCall> *queues[] = {&renderQueue, &renderQueueForward};
+
+        for (const std::vector<RenderCall> *queue : queues) {
+            for (const RenderCall &c : *queue) {
+                const AABB *bounds = c.mesh->getBounds();
+                if (bounds) {
+                    hash = Hash::fnv1a(hash, &bounds->min, sizeof(vec3));
+                    hash = Hash::fnv1a(hash, &bounds->max, sizeof(vec3));
+                }
+
+                if (c.transform) {
+                    hash = Hash::fnv1a(hash, &c.transform->position, sizeof(vec3));
+                    hash = Hash::fnv1a(hash, &c.transform->rotation, sizeof(quaternion));
+                    hash = Hash::fnv1a(hash, &c.transform->scale, sizeof(vec3));
+                }
+
+                for (const auto &uniform : c.material->getVec3Uniforms()) {
+                    hash = Hash::fnv1a(hash, uniform.first.data(), uniform.first.size());
+                    hash = Hash::fnv1a(hash, &uniform.second, sizeof(vec3));
+                }
+                for (const auto &uniform : c.material->getFloatUniforms()) {
+                    hash = Hash::fnv1a(hash, uniform.first.data(), uniform.first.size());
+                    hash = Hash::fnv1a(hash, &uniform.second, sizeof(float));
+                }
+                for (const auto &uniform : c.material->getBoolUniforms()) {
+                    hash = Hash::fnv1a(hash, uniform.first.data(), uniform.first.size());
+                    hash = Hash::fnv1a(hash, &uniform.second, sizeof(bool));
+                }
+            }
+        }
+
+        for (const DirectionalLight *light : directionalLights) {
+            hash = Hash::fnv1a(hash, &light->m_direction, sizeof(vec3));
+            hash = Hash::fnv1a(hash, &light->m_color, sizeof(vec3));
+        }
+
+        for (const PointLight *light : pointLights) {
+            hash = Hash::fnv1a(hash, &light->m_position, sizeof(vec3));
+            hash = Hash::fnv1a(hash, &light->m_color, sizeof(vec3));
+            hash = Hash::fnv1a(hash, &light->m_radius, sizeof(float));
+        }
+
+        hash = Hash::fnv1a(hash, &clearColor, sizeof(vec3));
+
+        return hash;
+    }
+
+    bool wantsDepthPrepass(const Camera &cam, const Frustum &f, bool doFrustumCulling) {
+        if (depthPrepassMode != DEPTH_PREPASS_AUTO) {
+            return depthPrepassMode == DEPTH_PREPASS_ALWAYS;
+        }
+
+        estimatedOverdraw = estimateOverdraw(renderQueue, cam, f, doFrustumCulling);
+
+        return estimatedOverdraw > depthPrepassThreshold;
+    }
+
+    float getEstimatedOverdraw() {
+        return estimatedOverdraw;
+    }
+
+    void renderToFramebuffer(const Camera &cam, const Frustum &f, bool doFrustumCulling, bool mainView) {
+        PROFILE_SCOPE("Renderer::renderToFramebuffer");
+
         glDisable(GL_BLEND);
 
-        beginQuery(0);
-        // render objects in scene into g-buffer
-        // -------------------------------------
-        gBuffer.bind();
+        selectLods(renderQueue, cam, mainView);
+        selectLods(renderQueueForward, cam, mainView);
+
+        gBufferInverseProjection = inverse(cam.getProjection());
+
+        bool occlusionCulling = useOcclusionCulling && doFrustumCulling && !occluders.empty();
+
+        if (occlusionCulling) {
+            PROFILE_SCOPE("occlusion culling");
+
+            occlusionCuller.begin(cam.getProjection() * cam.getView());
+
+            for (const Occluder &o : occluders) {
+                occlusionCuller.addOccluder(*o.mesh, o.transform ? o.transform->getMatrix() : mat4());
+            }
+
+            occlusionCuller.rasterize();
+        }
+
+        // probes render the same queue several times, a call is only prepassed for the view it was prepassed in
+        for (RenderCall &call : renderQueue) {
+            call.depthPrepassed = false;
+        }
+
+        usedDepthPrepass = wantsDepthPrepass(cam, f, doFrustumCulling);
+
+        gBuffer->bind();
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glViewport(0, 0, resolution.x, resolution.y);
+        glDepthFunc(GL_LEQUAL);
+
+        if (usedDepthPrepass) {
+            GpuProfiler::beginScope("depth prepass");
+
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            iterateCommandBufferDepthOnly(renderQueue, cam, f, doFrustumCulling, true);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+            GpuProfiler::endScope();
+        }
 
-        iterateCommandBuffer(renderQueue, cam, f, doFrustumCulling);
-        endQuery();
+        GpuProfiler::beginScope("geometry");
+        // render objects in scene into g-buffer
+        // -------------------------------------
+        iterateCommandBuffer(renderQueue, cam, f, doFrustumCulling, true, occlusionCulling ? &occlusionCuller : nullptr);
+        GpuProfiler::endScope();
+
+        // only built for the main view, probes render at their own size and nothing reads it for them
+        if (buildHiZBuffer && mainView) {
+            if (hiZBuffer.getID() == 0) {
+                hiZBuffer.setup(resolution.x, resolution.y);
+            }
+
+            GpuProfiler::beginScope("hi-z");
+            hiZBuffer.build();
+            GpuProfiler::endScope();
+        }
         
         // apply lighting to g-buffers
         // -------------------------------
-        beginQuery(1);
+        GpuProfiler::beginScope("shadow pass");
 
         for (int i = 0; i < directionalLights.size(); i++) {
-            directionalLights[i]->preRender(cam);
+            directionalLights[i]->preRender(cam, mainView);
+        }
+
+        // tiles are ranked by the main view, other views sample the shadows it left in the atlas
+        if (mainView) {
+            shadowAtlas.update(cam, pointLights);
         }
         
 
-        endQuery();
-        beginQuery(2);
+        GpuProfiler::endScope();
+        GpuProfiler::beginScope("deferred lighting");
 
-        HDRbuffer.bind();
+        HDRbuffer->bind();
         glViewport(0, 0, resolution.x, resolution.y);
         glClearColor(clearColor.x, clearColor.y, clearColor.z, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        glDepthFunc(GL_ALWAYS);
-        glDepthMask(GL_TRUE);
+        // copy depth and stencil buffer, the light volumes are depth tested against it
+        // -------------------------------
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer->fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, HDRbuffer->fbo);
+        glBlitFramebuffer(0, 0, resolution.x, resolution.y, 0, 0, resolution.x, resolution.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBlitFramebuffer(0, 0, resolution.x, resolution.y, 0, 0, resolution.x, resolution.y, GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        HDRbuffer->bind();
 
-        gBuffer.getAttachment(0).bind(0);
-        gBuffer.getAttachment(1).bind(1);
-        gBuffer.getAttachment(2).bind(2);
-        gBuffer.getAttachment(3).bind(3);
+        // the full screen passes must not overwrite the copied depth
+        glDepthFunc(GL_ALWAYS);
+        glDepthMask(GL_FALSE);
 
         mat4 inverseView = inverse(cam.getView());
 
@@ -259,10 +993,7 @@ namespace Renderer {
         // ---------------------------------------------
         Resources::deferredShader.bind();
 
-        Resources::deferredShader.uniformInt("gPosition", 0);
-        Resources::deferredShader.uniformInt("gNormal", 1);
-        Resources::deferredShader.uniformInt("gAlbedo", 2);
-        Resources::deferredShader.uniformInt("gRoughnessMetallic", 3);
+        bindGBuffer(Resources::deferredShader);
 
         Resources::framebufferMesh.render();
 
@@ -275,61 +1006,213 @@ namespace Renderer {
             directionalLights[i]->render(cam);
         }
 
+        // sort point lights into the full screen and light volume paths
+        // ---------------------------------------------
+        clusteredLights.clear();
+        volumeLights.clear();
+
+        mat4 view = cam.getView();
+        mat4 projection = cam.getProjection();
+
+        for (size_t i = 0; i < pointLights.size(); i++) {
+            if (pointLightMode == POINT_LIGHTS_FULLSCREEN) {
+                clusteredLights.push_back(pointLights[i]);
+                continue;
+            }
+
+            float projectedRadius = getProjectedLightRadius(*pointLights[i], cam, view, projection);
+
+            if (projectedRadius < 0.0f) {
+                continue;
+            }
+
+            if (pointLightMode == POINT_LIGHTS_VOLUMES || projectedRadius <= lightVolumeThreshold) {
+                volumeLights.push_back(pointLights[i]);
+            }
+            else {
+                clusteredLights.push_back(pointLights[i]);
+            }
+        }
+
         // Render point light lighting to the buffer
         // ---------------------------------------------
-        if (pointLights.size() > 0) {
+        if (clusteredLights.size() > 0) {
             Resources::deferredPointShader.bind();
 
-            Resources::deferredPointShader.uniformInt("gPosition", 0);
-            Resources::deferredPointShader.uniformInt("gNormal", 1);
-            Resources::deferredPointShader.uniformInt("gAlbedo", 2);
-            Resources::deferredPointShader.uniformInt("gRoughnessMetallic", 3);
+            bindGBuffer(Resources::deferredPointShader);
 
-            Resources::deferredPointShader.uniformInt("pointLightCount", (int) pointLights.size());
-            for (unsigned int i = 0; i < pointLights.size(); i++) {
-                Resources::deferredPointShader.uniformVec3("pointLights[" + std::to_string(i) + "].position",
-                                                    vec3(vec4(pointLights[i]->m_position, 1.0f) * cam.getView()));
-                Resources::deferredPointShader.uniformVec3("pointLights[" + std::to_string(i) + "].color", pointLights[i]->m_color);
+            lightClusters.update(cam, clusteredLights, &shadowAtlas);
+            lightClusters.bind(Resources::deferredPointShader, lightClusterUnit);
 
-                Resources::deferredPointShader.uniformFloat("pointLights[" + std::to_string(i) + "].radius", pointLights[i]->m_radius);
-            }
+            shadowAtlas.getTexture().bind(shadowAtlasUnit);
+            Resources::deferredPointShader.uniformInt("shadowAtlas", shadowAtlasUnit);
+            Resources::deferredPointShader.uniformMat4("inverseView", inverseView);
 
             Resources::framebufferMesh.render();
         }
 
+        // Render the remaining point lights as bounding spheres. Only back faces are drawn and they pass where they
+        // lie behind the g-buffer surface, so the camera may be inside a volume and each pixel is lit once per light.
+        // ---------------------------------------------
+        if (volumeLights.size() > 0) {
+            Resources::deferredPointVolumeShader.bind();
+
+            bindGBuffer(Resources::deferredPointVolumeShader);
+
+            Resources::deferredPointVolumeShader.uniformMat4("view", view);
+            Resources::deferredPointVolumeShader.uniformMat4("projection", projection);
+            Resources::deferredPointVolumeShader.uniformVec2("resolution", vec2((float)resolution.x, (float)resolution.y));
+
+            shadowAtlas.getTexture().bind(shadowAtlasUnit);
+            Resources::deferredPointVolumeShader.uniformInt("shadowAtlas", shadowAtlasUnit);
+            Resources::deferredPointVolumeShader.uniformMat4("inverseView", inverseView);
+
+            glDepthFunc(GL_GEQUAL);
+            glCullFace(GL_FRONT);
+
+            for (size_t i = 0; i < volumeLights.size(); i++) {
+                const PointLight *light = volumeLights[i];
+
+                Resources::deferredPointVolumeShader.uniformVec3("volumeCenter", light->m_position);
+                Resources::deferredPointVolumeShader.uniformFloat("volumeRadius", light->m_radius * lightVolumeScale);
+
+                Resources::deferredPointVolumeShader.uniformVec3("light.position", vec3(vec4(light->m_position, 1.0f) * view));
+                Resources::deferredPointVolumeShader.uniformVec3("light.color", light->m_color);
+                Resources::deferredPointVolumeShader.uniformFloat("light.radius", light->m_radius);
+
+                const PointLightShadow *shadow = shadowAtlas.getShadow(light);
+                Resources::deferredPointVolumeShader.uniformBool("shadowed", shadow != nullptr);
+
+                if (shadow) {
+                    mat4 shadowMatrices[6];
+                    shadowAtlas.getShadowMatrices(*shadow, inverseView, shadowMatrices);
+
+                    for (int face = 0; face < 6; face++) {
+                        Resources::deferredPointVolumeShader.uniformMat4("shadowMatrices[" + std::to_string(face) + "]", shadowMatrices[face]);
+                    }
+                }
+
+                Resources::sphereMesh.render();
+            }
+
+            glCullFace(GL_BACK);
+            glDepthFunc(GL_ALWAYS);
+        }
+
         // Render ambient lighting to the buffer
         // ---------------------------------------------
-        if (irradiance.getID() != 0 && specular.getID() != 0) {
+
+        // the two baked probes nearest the camera relative to their radius are blended per pixel, the global maps light
+        // whatever they don't reach
+        const IBL::Probe *nearestProbes[2] = {nullptr, nullptr};
+        float nearestDistances[2] = {FLT_MAX, FLT_MAX};
+
+        // probes without specular are only irradiance, the nearest of those are blended as well
+        std::vector<std::pair<float, const IBL::Probe*>> shProbes;
+
+        for (const IBL::Probe *probe : probes) {
+            if (!probe->isBaked()) {
+                continue;
+            }
+
+            float distance = length(probe->getPosition() - cam.position) / probe->getRadius();
+
+            if (!probe->hasSpecular()) {
+                shProbes.push_back({distance, probe});
+                continue;
+            }
+
+            if (distance < nearestDistances[0]) {
+                nearestProbes[1] = nearestProbes[0];
+                nearestDistances[1] = nearestDistances[0];
+                nearestProbes[0] = probe;
+                nearestDistances[0] = distance;
+            }
+            else if (distance < nearestDistances[1]) {
+                nearestProbes[1] = probe;
+                nearestDistances[1] = distance;
+            }
+        }
+
+        int numProbes = nearestProbes[1] ? 2 : (nearestProbes[0] ? 1 : 0);
+
+        const Cubemap *ambientIrradiance = &irradiance;
+        const Cubemap *ambientSpecular = &specular;
+
+        if ((irradiance.getID() == 0 || specular.getID() == 0) && numProbes > 0) {
+            ambientIrradiance = &nearestProbes[0]->getIrradiance();
+            ambientSpecular = &nearestProbes[0]->getSpecular();
+        }
+
+        int numSHProbes = std::min((int)shProbes.size(), maxSHProbes);
+        std::partial_sort(shProbes.begin(), shProbes.begin() + numSHProbes, shProbes.end(),
+                          [](const std::pair<float, const IBL::Probe*> &a, const std::pair<float, const IBL::Probe*> &b) {
+            return a.first < b.first;
+        });
+
+        if ((ambientIrradiance->getID() != 0 && ambientSpecular->getID() != 0) || numSHProbes > 0) {
             Resources::deferredAmbientShader.bind();
 
-            Resources::deferredAmbientShader.uniformInt("gPosition", 0);
-            Resources::deferredAmbientShader.uniformInt("gNormal", 1);
-            Resources::deferredAmbientShader.uniformInt("gAlbedo", 2);
-            Resources::deferredAmbientShader.uniformInt("gRoughnessMetallic", 3);
-            
+            bindGBuffer(Resources::deferredAmbientShader);
 
             Resources::deferredAmbientShader.uniformInt("irradiance", 4);
-            irradiance.bind(4);
+            ambientIrradiance->bind(4);
             Resources::deferredAmbientShader.uniformInt("prefilter", 5);
-            specular.bind(5);
+            ambientSpecular->bind(5);
             Resources::deferredAmbientShader.uniformInt("brdf", 6);
             Resources::brdf.bind(6);
 
+            Resources::deferredAmbientShader.uniformInt("numProbes", numProbes);
+
+            for (int i = 0; i < 2; i++) {
+                std::string index = "[" + std::to_string(i) + "]";
+
+                // unused slots still get a cubemap bound, samplers of one type can't share a unit with another
+                const IBL::Probe *probe = nearestProbes[i] ? nearestProbes[i] : nearestProbes[0];
+                const Cubemap &probeIrradiance = probe ? probe->getIrradiance() : *ambientIrradiance;
+                const Cubemap &probeSpecular = probe ? probe->getSpecular() : *ambientSpecular;
+
+                Resources::deferredAmbientShader.uniformInt("probeIrradiance" + index, ambientProbeUnit + i * 2);
+                probeIrradiance.bind(ambientProbeUnit + i * 2);
+                Resources::deferredAmbientShader.uniformInt("probePrefilter" + index, ambientProbeUnit + i * 2 + 1);
+                probeSpecular.bind(ambientProbeUnit + i * 2 + 1);
+
+                if (probe) {
+                    Resources::deferredAmbientShader.uniformVec3("probePositions" + index, probe->getPosition());
+                    Resources::deferredAmbientShader.uniformFloat("probeRadii" + index, probe->getRadius());
+                }
+            }
+
+            vec3 shCoefficients[maxSHProbes * 9];
+            vec3 shPositions[maxSHProbes];
+            float shRadii[maxSHProbes];
+
+            for (int i = 0; i < numSHProbes; i++) {
+                const IBL::Probe *probe = shProbes[i].second;
+
+                for (int j = 0; j < 9; j++) {
+                    shCoefficients[i * 9 + j] = probe->getIrradianceSH().coefficients[j];
+                }
+                shPositions[i] = probe->getPosition();
+                shRadii[i] = probe->getRadius();
+            }
+
+            Resources::deferredAmbientShader.uniformInt("numSHProbes", numSHProbes);
+            if (numSHProbes > 0) {
+                Resources::deferredAmbientShader.uniformVec3Array("shCoefficients", shCoefficients, numSHProbes * 9);
+                Resources::deferredAmbientShader.uniformVec3Array("shPositions", shPositions, numSHProbes);
+                Resources::deferredAmbientShader.uniformFloatArray("shRadii", shRadii, numSHProbes);
+            }
+
             Resources::deferredAmbientShader.uniformMat4("inverseView", inverseView);
 
             Resources::framebufferMesh.render();
         }
         
 
-        endQuery();
-
-        // copy depth and stencil buffer
-        // -------------------------------
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.fbo);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, HDRbuffer.fbo);
-        glBlitFramebuffer(0, 0, resolution.x, resolution.y, 0, 0, resolution.x, resolution.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-        glBlitFramebuffer(0, 0, resolution.x, resolution.y, 0, 0, resolution.x, resolution.y, GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        GpuProfiler::endScope();
 
+        glDepthMask(GL_TRUE);
 
         // render the forward pass
         // -------------------------------
@@ -339,19 +1222,16 @@ namespace Renderer {
         iterateCommandBuffer(renderQueueForward, cam, f, doFrustumCulling);
     }
 
+    static Framebuffer *flushFrame(const Camera &cam, const Frustum &f, bool doFrustumCulling, bool toWindow);
+
     void flush(const Camera &cam) {
         Frustum f;
         flush(cam, f, false);
     }
 
     void flush(const Camera &cam, const Frustum &f, bool doFrustumCulling) {
-        const Texture &t = flushToTexture(cam, f, doFrustumCulling);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, Window::getWindowSize().x, Window::getWindowSize().y);
-        Resources::gammaCorrectShader.bind();
-        t.bind();
-        Resources::framebufferMesh.render();
+        // gamma correction is merged into the last post processing pass, which draws straight into the window
+        flushFrame(cam, f, doFrustumCulling, true);
     }
 
     const Texture &flushToTexture(const Camera &cam) {
@@ -360,29 +1240,75 @@ namespace Renderer {
     }
 
     const Texture &flushToTexture(const Camera &cam, const Frustum &f, bool doFrustumCulling) {
-        renderToFramebuffer(cam, f, doFrustumCulling);
-        
-        glDepthFunc(GL_ALWAYS);
-        // post processing
-        beginQuery(3);
-        Framebuffer *source = &HDRbuffer;
-        Framebuffer *destination = &HDRbuffer2;
+        return flushFrame(cam, f, doFrustumCulling, false)->getAttachment(0);
+    }
+
+    static Framebuffer *runPostProcessing(const Camera &cam, bool toWindow) {
+        static GammaCorrectPostProcessor gammaCorrection;
+
+        // the grouping only changes with the stack, holding on to the steps keeps their addresses from being reused
+        static std::vector<std::shared_ptr<PostProcessor>> builtStack;
+        static bool builtToWindow = false;
+        static bool built = false;
+        static std::vector<PostProcessPass> passes;
+
+        if (!built || builtStack != postProcessingStack || builtToWindow != toWindow) {
+            std::vector<PostProcessor*> steps;
 
-        if (postProcessingStack.size() > 0) {
             for (size_t i = 0; i < postProcessingStack.size(); i++) {
-                std::shared_ptr<PostProcessor> step = postProcessingStack[i];
+                steps.push_back(postProcessingStack[i].get());
+            }
+            if (toWindow) {
+                steps.push_back(&gammaCorrection);
+            }
+
+            passes = PostProcessing::buildPasses(steps);
+            builtStack = postProcessingStack;
+            builtToWindow = toWindow;
+            built = true;
+        }
 
-                step->postProcess(cam, *source, *destination);
+        // ping-pong with a pooled buffer that stays valid until the next frame, the returned texture may be in it
+        Framebuffer *source = HDRbuffer;
+        Framebuffer *destination = nullptr;
 
-                Framebuffer *temp = destination;
-                destination = source;
-                source = temp;
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (toWindow && i == passes.size() - 1) {
+                passes[i].render(cam, *source, nullptr);
+                return nullptr;
             }
+
+            if (!destination) {
+                destination = &FramebufferPool::acquireForFrame(getHDRDesc(resolution.x, resolution.y));
+            }
+
+            passes[i].render(cam, *source, destination);
+
+            Framebuffer *temp = destination;
+            destination = source;
+            source = temp;
         }
-        else {
-            destination = &HDRbuffer;
+
+        return source;
+    }
+
+    static Framebuffer *flushFrame(const Camera &cam, const Frustum &f, bool doFrustumCulling, bool toWindow) {
+        PROFILE_SCOPE("Renderer::flush");
+
+        GpuProfiler::newFrame();
+        FramebufferPool::newFrame();
+
+        renderToFramebuffer(cam, f, doFrustumCulling, true);
+        
+        glDepthFunc(GL_ALWAYS);
+        // post processing
+        GpuProfiler::beginScope("post processing");
+        Framebuffer *result;
+        {
+            PROFILE_SCOPE("post processing");
+            result = runPostProcessing(cam, toWindow);
         }
-        endQuery();
+        GpuProfiler::endScope();
 
         glDepthFunc(GL_LEQUAL);
 
@@ -403,27 +1329,38 @@ namespace Renderer {
                             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
                             ImGui::GetIO().Framerate);
 
-                            ImGui::Text("geometry: %.2f ms", queryResults[0]*0.000001f);
-                            ImGui::Text("shadow pass: %.2f ms", queryResults[1]*0.000001f);
-                            ImGui::Text("deferred lighting: %.2f ms", queryResults[2]*0.000001f);
-                            ImGui::Text("post processing: %.2f ms", queryResults[3]*0.000001f);
+                            GpuProfiler::renderImGui();
+                            ImGui::Text("indirect draws: %d in %d batches", indirectDrawCount, indirectBatchCount);
+                            ImGui::Text("depth prepass: %s, estimated overdraw %.2f", usedDepthPrepass ? "on" : "off", estimatedOverdraw);
+                            ImGui::Text("occlusion culling: %d of %d culled, %d occluder triangles", occlusionCuller.getNumCulled(), occlusionCuller.getNumTested(), occlusionCuller.getNumOccluderTriangles());
+                            ImGui::Text("point lights: %d clustered, %d as volumes, %d cluster light references", (int)clusteredLights.size(), (int)volumeLights.size(), lightClusters.getNumIndices());
+                            ImGui::Text("point light shadows: %d, %d updated", shadowAtlas.getNumShadows(), shadowAtlas.getNumUpdated());
+                            ImGui::Text("framebuffer pool: %d framebuffers, %d in use, %.1f MB", FramebufferPool::getNumFramebuffers(), FramebufferPool::getNumAcquired(), FramebufferPool::getMemoryUsage() / (1024.0f * 1024.0f));
                 ImGui::End();
             }
 
+            if (ImGui::Begin("CPU profiler")) {
+                Profiler::renderImGui();
+            }
+            ImGui::End();
+
             ImGui::ShowDemoWindow();
         }
 
+        indirectDrawCount = 0;
+        indirectBatchCount = 0;
+
         pointLights.clear();
         directionalLights.clear();
         renderQueue.clear();
         renderQueueForward.clear();
+        occluders.clear();
+        probes.clear();
 
-        return destination->getAttachment(0);
+        return result;
     }
 
-    Cubemap renderToProbe(const vec3 &position) {
-        static const int resolution = 128;
-
+    void renderToProbe(const vec3 &position, const Cubemap &target, int face, int probeResolution) {
         static vec3 forwards[] = {
                 vec3(1.0f,  0.0f,  0.0f),
                 vec3(-1.0f,  0.0f,  0.0f),
@@ -442,14 +1379,51 @@ namespace Renderer {
                 vec3(0.0f,  -1.0f, 0.0f)
         };
 
-        unsigned int captureFBO, captureRBO;
+        unsigned int captureFBO;
         glGenFramebuffers(1, &captureFBO);
-        glGenRenderbuffers(1, &captureRBO);
 
+        // render into probe sized targets from the pool rather than resizing the main ones twice
+        Framebuffer *mainGBuffer = gBuffer;
+        Framebuffer *mainHDRbuffer = HDRbuffer;
+        vec2i mainResolution = resolution;
+
+        resolution = vec2i(probeResolution, probeResolution);
+        gBuffer = &FramebufferPool::acquire(getGBufferDesc(probeResolution, probeResolution, gBufferCompact));
+        HDRbuffer = &FramebufferPool::acquire(getHDRDesc(probeResolution, probeResolution));
+
+        Camera cam;
+        cam.dimensions = {(float)probeResolution, (float)probeResolution};
+        cam.position = position;
+
+        cam.direction = forwards[face];
+        cam.up = ups[face];
+        cam.fov = 90.0f;
+
+        renderToFramebuffer(cam, Frustum(), false, false);
+
+        glViewport(0, 0, probeResolution, probeResolution);
         glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, resolution, resolution);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target.getID(), 0);
+        glClearColor(clearColor.x, clearColor.y, clearColor.z, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        Resources::passthroughShader.bind();
+        HDRbuffer->getAttachment(0).bind();
+        Resources::framebufferMesh.render();
+
+        FramebufferPool::release(*gBuffer);
+        FramebufferPool::release(*HDRbuffer);
+
+        gBuffer = mainGBuffer;
+        HDRbuffer = mainHDRbuffer;
+        resolution = mainResolution;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &captureFBO);
+    }
+
+    Cubemap renderToProbe(const vec3 &position) {
+        static const int probeResolution = 128;
 
         unsigned int envCubemap;
 
@@ -459,7 +1433,7 @@ namespace Renderer {
         {
             // note that we store each face with 16 bit floating point values
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F,
-                         resolution, resolution, 0, GL_RGB, GL_FLOAT, nullptr);
+                         probeResolution, probeResolution, 0, GL_RGB, GL_FLOAT, nullptr);
         }
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -467,59 +1441,73 @@ namespace Renderer {
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        vec2i internalResolution = getResolution();
-        resize(resolution, resolution);
+        Cubemap c;
+        c.setID(envCubemap);
 
-        glViewport(0, 0, resolution, resolution);
-        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        for (unsigned int i = 0; i < 6; ++i)
-        {
-            Texture gPosition;
-            Texture gNormal;
-            Texture gAlbedo;
-            Texture gRoughnessMetallic;
+        for (int i = 0; i < 6; i++) {
+            renderToProbe(position, c, i, probeResolution);
+        }
 
-            Camera cam;
-            cam.dimensions = {(float)resolution, (float)resolution};
-            cam.position = position;
+        return c;
+    }
 
-            cam.direction = forwards[i];
-            cam.up = ups[i];
-            cam.fov = 90.0f;
+    void setClearColor(vec3 color) {
+        clearColor = color;
+    }
 
-            renderToFramebuffer(cam, Frustum(), false);
+    vec2i getResolution() {
+        return resolution;
+    }
 
-            glViewport(0, 0, resolution, resolution);
-            glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-            glClearColor(clearColor.x, clearColor.y, clearColor.z, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Framebuffer &getGBuffer() {
+        return *gBuffer;
+    }
 
-            Resources::passthroughShader.bind();
-            HDRbuffer.getAttachment(0).bind();
-            Resources::framebufferMesh.render();
+    void bindGBuffer(const Shader &shader, int firstUnit) {
+        // the compact layout has no position target, the depth texture takes its unit
+        if (gBufferCompact) {
+            gBuffer->getAttachment(3).bind(firstUnit);
+            gBuffer->getAttachment(0).bind(firstUnit + 1);
+            gBuffer->getAttachment(1).bind(firstUnit + 2);
+            gBuffer->getAttachment(2).bind(firstUnit + 3);
+        }
+        else {
+            for (int i = 0; i < 4; i++) {
+                gBuffer->getAttachment(i).bind(firstUnit + i);
+            }
         }
 
-        resize(internalResolution.x, internalResolution.y);
+        shader.uniformInt("gPosition", firstUnit);
+        shader.uniformInt("gDepth", firstUnit);
+        shader.uniformInt("gNormal", firstUnit + 1);
+        shader.uniformInt("gAlbedo", firstUnit + 2);
+        shader.uniformInt("gRoughnessMetallic", firstUnit + 3);
 
-        glDeleteFramebuffers(1, &captureFBO);
-        glDeleteRenderbuffers(1, &captureRBO);
+        shader.uniformBool("compactGBuffer", gBufferCompact);
+        shader.uniformMat4("inverseProjection", gBufferInverseProjection);
+    }
 
-        Cubemap c;
-        c.setID(envCubemap);
+    bool isGBufferCompact() {
+        return gBufferCompact;
+    }
 
-        return c;
+    const Texture &getGBufferPosition() {
+        return gBuffer->getAttachment(gBufferCompact ? 3 : 0);
     }
 
-    void setClearColor(vec3 color) {
-        clearColor = color;
+    Framebuffer &getHDRBuffer() {
+        return *HDRbuffer;
     }
 
-    vec2i getResolution() {
-        return resolution;
+    const HiZBuffer &getHiZBuffer() {
+        return hiZBuffer;
     }
 
-    Framebuffer &getGBuffer() {
-        return gBuffer;
+    const OcclusionCuller &getOcclusionCuller() {
+        return occlusionCuller;
+    }
+
+    bool isMultiDrawIndirectSupported() {
+        return multiDrawElementsIndirect != nullptr;
     }
 }
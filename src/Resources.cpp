@@ -4,9 +4,12 @@
 #include <crucible/Path.hpp>
 #include <crucible/Resource.h>
 #include <crucible/Primitives.hpp>
+#include <crucible/PostProcessing.hpp>
 
 #include <glad/glad.h>
 
+#include <cstring>
+#include <iostream>
 #include <map>
 #include <string>
 
@@ -68,24 +71,25 @@ static void load() {
     Resources::spriteShader.load(LOAD_RESOURCE(src_shaders_sprite_vsh).data(), LOAD_RESOURCE(src_shaders_sprite_fsh).data());
     Resources::textShader.load(LOAD_RESOURCE(src_shaders_text_vsh).data(), LOAD_RESOURCE(src_shaders_text_fsh).data());
     Resources::ShadowShader.load(LOAD_RESOURCE(src_shaders_shadow_vsh).data(), LOAD_RESOURCE(src_shaders_shadow_fsh).data());
+    Resources::depthPrepassShader.load(LOAD_RESOURCE(src_shaders_depthPrepass_vsh).data(), LOAD_RESOURCE(src_shaders_depthPrepass_fsh).data());
     Resources::deferredShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_deferred_glsl).data());
     Resources::deferredAmbientShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_deferred_ambient_glsl).data());
     Resources::deferredPointShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_deferred_point_glsl).data());
+    Resources::deferredPointVolumeShader.load(LOAD_RESOURCE(src_shaders_deferred_point_volume_vsh).data(), LOAD_RESOURCE(src_shaders_deferred_point_volume_fsh).data());
     Resources::deferredDirectionalShadowShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_deferred_directional_shadow_glsl).data());
     Resources::deferredDirectionalShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_deferred_directional_glsl).data());
-    Resources::brdfShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_brdf_glsl).data());
 
     Resources::debugShader.load(LOAD_RESOURCE(src_shaders_debug_vsh).data(), LOAD_RESOURCE(src_shaders_debug_fsh).data());
     Resources::particleShader.load(LOAD_RESOURCE(src_shaders_particle_vsh).data(), LOAD_RESOURCE(src_shaders_particle_fsh).data(), LOAD_RESOURCE(src_shaders_particle_gsh).data());
 
-    Resources::tonemapShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_tonemap_glsl).data());
-    Resources::fxaaShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_fxaa_glsl).data());
     Resources::gaussianBlurShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_gaussianBlur_glsl).data());
+    Resources::bloomDownsampleShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_bloomDownsample_glsl).data());
+    Resources::bloomUpsampleShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_bloomUpsample_glsl).data());
     Resources::ssaoShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_ssao_glsl).data());
-    Resources::ssaoBlurShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_ssaoBlur_glsl).data());
+    glUniformBlockBinding(Resources::ssaoShader.getID(), glGetUniformBlockIndex(Resources::ssaoShader.getID(), "SsaoKernel"), SsaoPostProcessor::KERNEL_BINDING);
+    Resources::ssaoTemporalShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_ssaoTemporal_glsl).data());
     Resources::ssrShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_ssr_glsl).data());
-    Resources::gammaCorrectShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_gammaCorrect_glsl).data());
-    Resources::bloomShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_bloom_glsl).data());
+    Resources::hiZShader.loadPostProcessing(LOAD_RESOURCE(src_shaders_hiZBuild_glsl).data());
 
     /*Resources::standardShader = Resources::getShader("src/shaders/standard.vsh", "src/shaders/standard.fsh");
     Resources::eq2cubeShader = Resources::getShader("src/shaders/cubemap.vsh", "src/shaders/eq2cube.fsh");
@@ -98,52 +102,42 @@ static void load() {
     Resources::ShadowShader = Resources::getShader("src/shaders/shadow.vsh", "src/shaders/shadow.fsh");
     Resources::deferredShader = Resources::getPostProcessingShader("src/shaders/deferred.glsl");
     Resources::deferredAmbientShader = Resources::getPostProcessingShader("src/shaders/deferred_ambient.glsl");
-    Resources::brdfShader = Resources::getPostProcessingShader("src/shaders/brdf.glsl");
     Resources::debugShader = Resources::getShader("src/shaders/debug.vsh", "src/shaders/debug.fsh");
 
-    Resources::tonemapShader = Resources::getPostProcessingShader("src/shaders/tonemap.glsl");
-    Resources::fxaaShader = Resources::getPostProcessingShader("src/shaders/fxaa.glsl");
     Resources::gaussianBlurShader = Resources::getPostProcessingShader("src/shaders/gaussianBlur.glsl");
     Resources::ssaoShader = Resources::getPostProcessingShader("src/shaders/ssao.glsl");
-    Resources::ssaoBlurShader = Resources::getPostProcessingShader("src/shaders/ssaoBlur.glsl");
     Resources::ssrShader = Resources::getPostProcessingShader("src/shaders/ssr.glsl");*/
 
     Resources::framebufferMesh = Primitives::framebuffer();
     Resources::cubemapMesh = Primitives::skybox();
     Resources::spriteMesh = Primitives::sprite();
+    Resources::sphereMesh = Primitives::sphere(16, 16);
 
 
-    // create brdf texture
+    // upload the brdf lookup table brdf-lut generated at build time, width and height followed by RG16F texels
+    Resource brdfLUT = LOAD_RESOURCE(brdf_lut_bin);
+
+    unsigned int brdfSize[2] = {0, 0};
+    if (brdfLUT.size() >= sizeof(brdfSize)) {
+        memcpy(brdfSize, brdfLUT.data(), sizeof(brdfSize));
+    }
+
+    if (brdfLUT.size() < sizeof(brdfSize) + brdfSize[0] * brdfSize[1] * 4) {
+        std::cout << "Embedded BRDF lookup table is truncated" << std::endl;
+        return;
+    }
+
     unsigned int brdfLUTTexture;
     glGenTextures(1, &brdfLUTTexture);
 
-    // pre-allocate enough memory for the LUT texture.
     glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, brdfSize[0], brdfSize[1], 0, GL_RG, GL_HALF_FLOAT, brdfLUT.data() + sizeof(brdfSize));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    unsigned int captureFBO, captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-
-    glViewport(0, 0, 512, 512);
-    Resources::brdfShader.bind();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    Resources::framebufferMesh.render();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    glDeleteFramebuffers(1, &captureFBO);
-    glDeleteRenderbuffers(1, &captureRBO);
-
     Resources::brdf.setID(brdfLUTTexture);
 }
 
@@ -151,34 +145,35 @@ namespace Resources {
     Mesh cubemapMesh;
     Mesh framebufferMesh;
     Mesh spriteMesh;
+    Mesh sphereMesh;
 
     Shader standardShader;
     Shader eq2cubeShader;
     Shader cubemapShader;
     Shader irradianceShader;
     Shader prefilterShader;
-    Shader brdfShader;
     Shader passthroughShader;
     Shader spriteShader;
     Shader textShader;
     Shader ShadowShader;
+    Shader depthPrepassShader;
     Shader deferredShader;
     Shader deferredAmbientShader;
     Shader deferredPointShader;
+    Shader deferredPointVolumeShader;
     Shader deferredDirectionalShadowShader;
     Shader deferredDirectionalShader;
     
     Shader debugShader;
     Shader particleShader;
 
-    Shader tonemapShader;
-    Shader fxaaShader;
     Shader gaussianBlurShader;
+    Shader bloomDownsampleShader;
+    Shader bloomUpsampleShader;
     Shader ssaoShader;
-    Shader ssaoBlurShader;
+    Shader ssaoTemporalShader;
     Shader ssrShader;
-    Shader gammaCorrectShader;
-    Shader bloomShader;
+    Shader hiZShader;
 
     Texture brdf;
 
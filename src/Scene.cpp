@@ -1,5 +1,6 @@
 #include <crucible/Scene.hpp>
 #include <crucible/Renderer.hpp>
+#include <crucible/Profiler.hpp>
 
 #include <btBulletDynamicsCommon.h>
 
@@ -59,6 +60,8 @@ GameObject &Scene::createMeshObject(Mesh &mesh, Material &material, const Transf
 }
 
 void Scene::render() {
+    PROFILE_SCOPE("Scene::render");
+
     if (physicsEnabled) {
         //dynamicsWorld->debugDrawWorld();
     }
@@ -69,7 +72,12 @@ void Scene::render() {
 }
 
 void Scene::update(float delta) {
-    dynamicsWorld->stepSimulation(delta, 10);
+    PROFILE_SCOPE("Scene::update");
+
+    {
+        PROFILE_SCOPE("physics");
+        dynamicsWorld->stepSimulation(delta, 10);
+    }
 
     for (size_t i = 0; i < objects.size(); i++) {
         objects[i]->update(delta);
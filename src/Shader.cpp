@@ -6,6 +6,7 @@
 
 #include <string>
 #include <regex>
+#include <vector>
 
 std::string str_replace( std::string const & in, std::string const & from, std::string const & to )
 {
@@ -16,6 +17,8 @@ void loadLibraries(std::string &in) {
     //allow 5 levels of recursion
     for (int i = 0; i < 5; i++) {
         in = str_replace(in, "#include <lighting>", LOAD_RESOURCE(src_shaders_lighting_glsl).data());
+        in = str_replace(in, "#include <hiz>", LOAD_RESOURCE(src_shaders_hiz_glsl).data());
+        in = str_replace(in, "#include <gbuffer>", LOAD_RESOURCE(src_shaders_gbuffer_glsl).data());
     }
 }
 
@@ -126,6 +129,10 @@ void Shader::bind() const {
     glUseProgram(this->id);
 }
 
+unsigned int Shader::getID() const {
+    return id;
+}
+
 void Shader::uniformMat4(const std::string &location, const mat4 &mat) const {
     unsigned int transformLoc = glGetUniformLocation(this->id, location.c_str());
 
@@ -138,6 +145,11 @@ void Shader::uniformMat4(const std::string &location, const mat4 &mat) const {
     glUniformMatrix4fv(transformLoc, 1, GL_FALSE, matrixArray);
 }
 
+void Shader::uniformVec2(const std::string &location, const vec2 &vec) const {
+    unsigned int transformLoc = glGetUniformLocation(this->id, location.c_str());
+    glUniform2f(transformLoc, vec.x, vec.y);
+}
+
 void Shader::uniformVec3(const std::string &location, const vec3 &vec) const {
     unsigned int transformLoc = glGetUniformLocation(this->id, location.c_str());
     glUniform3f(transformLoc, vec.x, vec.y, vec.z);
@@ -148,6 +160,24 @@ void Shader::uniformVec4(const std::string &location, const vec4 &vec) const {
     glUniform4f(transformLoc, vec.x, vec.y, vec.z, vec.w);
 }
 
+void Shader::uniformVec3Array(const std::string &location, const vec3 *values, int count) const {
+    unsigned int transformLoc = glGetUniformLocation(this->id, location.c_str());
+
+    std::vector<float> floats(count * 3);
+    for (int i = 0; i < count; i++) {
+        floats[i * 3] = values[i].x;
+        floats[i * 3 + 1] = values[i].y;
+        floats[i * 3 + 2] = values[i].z;
+    }
+
+    glUniform3fv(transformLoc, count, floats.data());
+}
+
+void Shader::uniformFloatArray(const std::string &location, const float *values, int count) const {
+    unsigned int transformLoc = glGetUniformLocation(this->id, location.c_str());
+    glUniform1fv(transformLoc, count, values);
+}
+
 void Shader::uniformInt(const std::string &location, int value) const {
     unsigned int transformLoc = glGetUniformLocation(this->id, location.c_str());
     glUniform1i(transformLoc,value);
@@ -0,0 +1,381 @@
+#include <crucible/ShadowAtlas.hpp>
+#include <crucible/PointLight.hpp>
+#include <crucible/Camera.hpp>
+#include <crucible/Frustum.hpp>
+#include <crucible/Renderer.hpp>
+#include <crucible/Profiler.hpp>
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+
+int ShadowAtlas::updateBudget = 2;
+int ShadowAtlas::maxShadowedLights = 16;
+int ShadowAtlas::maxTileSize = 512;
+
+static const int minTileSize = 64;
+
+// cube face directions and up vectors, in the order the shaders index them: +x, -x, +y, -y, +z, -z
+static const vec3 faceDirections[6] = {
+    vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f),
+    vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+    vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f)
+};
+
+static const vec3 faceUps[6] = {
+    vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+    vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, 1.0f),
+    vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)
+};
+
+int ShadowTileAllocator::getLevel(int tileSize) const {
+    int level = 0;
+
+    for (int s = size; s > tileSize && s > minTileSize; s /= 2) {
+        level++;
+    }
+
+    return level;
+}
+
+bool ShadowTileAllocator::allocateLevel(int level, vec2i &origin) {
+    if (level < 0) {
+        return false;
+    }
+
+    std::set<std::pair<int, int>> &tiles = freeTiles[level];
+
+    if (!tiles.empty()) {
+        origin = vec2i(tiles.begin()->first, tiles.begin()->second);
+        tiles.erase(tiles.begin());
+
+        return true;
+    }
+
+    vec2i parent;
+    if (!allocateLevel(level - 1, parent)) {
+        return false;
+    }
+
+    // keep the first quadrant, the other three become free
+    int tileSize = size >> level;
+
+    tiles.insert(std::make_pair(parent.x + tileSize, parent.y));
+    tiles.insert(std::make_pair(parent.x, parent.y + tileSize));
+    tiles.insert(std::make_pair(parent.x + tileSize, parent.y + tileSize));
+
+    origin = parent;
+
+    return true;
+}
+
+void ShadowTileAllocator::setup(int size, int minTileSize) {
+    this->size = size;
+    this->minTileSize = minTileSize;
+
+    freeTiles.clear();
+    freeTiles.resize(getLevel(minTileSize) + 1);
+    freeTiles[0].insert(std::make_pair(0, 0));
+}
+
+bool ShadowTileAllocator::allocate(int tileSize, vec4i &tile) {
+    int level = getLevel(tileSize);
+
+    vec2i origin;
+    if (!allocateLevel(level, origin)) {
+        return false;
+    }
+
+    tile = vec4i(origin.x, origin.y, size >> level, size >> level);
+
+    return true;
+}
+
+void ShadowTileAllocator::free(const vec4i &tile) {
+    int level = getLevel(tile.z);
+    int x = tile.x;
+    int y = tile.y;
+
+    while (level > 0) {
+        int tileSize = size >> level;
+        int parentX = x - x % (tileSize * 2);
+        int parentY = y - y % (tileSize * 2);
+
+        std::set<std::pair<int, int>> &tiles = freeTiles[level];
+
+        std::pair<int, int> siblings[4] = {
+            std::make_pair(parentX, parentY),
+            std::make_pair(parentX + tileSize, parentY),
+            std::make_pair(parentX, parentY + tileSize),
+            std::make_pair(parentX + tileSize, parentY + tileSize)
+        };
+
+        // merge once the other three quadrants are free as well
+        int numFree = 0;
+        for (int i = 0; i < 4; i++) {
+            if ((siblings[i].first != x || siblings[i].second != y) && tiles.count(siblings[i])) {
+                numFree++;
+            }
+        }
+
+        if (numFree < 3) {
+            break;
+        }
+
+        for (int i = 0; i < 4; i++) {
+            tiles.erase(siblings[i]);
+        }
+
+        x = parentX;
+        y = parentY;
+        level--;
+    }
+
+    freeTiles[level].insert(std::make_pair(x, y));
+}
+
+int ShadowTileAllocator::getNumFreeTiles() const {
+    int count = 0;
+
+    for (size_t i = 0; i < freeTiles.size(); i++) {
+        count += (int)freeTiles[i].size();
+    }
+
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int ShadowAtlas::getTileSize(float importance) const {
+    // importance is roughly the light's angular radius, halve the resolution every time it halves
+    int tileSize = maxTileSize;
+    float threshold = 0.5f;
+
+    while (tileSize > minTileSize && importance < threshold) {
+        tileSize /= 2;
+        threshold *= 0.5f;
+    }
+
+    return std::min(tileSize, size / 4);
+}
+
+void ShadowAtlas::renderShadow(const PointLight &light, PointLightShadow &shadow) {
+    // a little wider than 90 degrees so filtering near a face's edge stays inside its tile
+    float margin = 4.0f / (float)shadow.tileSize;
+    float fov = degrees(2.0f * std::atan(1.0f / (1.0f - margin)));
+
+    for (int i = 0; i < 6; i++) {
+        Camera faceCamera;
+        faceCamera.position = light.m_position;
+        faceCamera.direction = faceDirections[i];
+        faceCamera.up = faceUps[i];
+        faceCamera.fov = fov;
+        faceCamera.dimensions = vec2(1.0f, 1.0f);
+        faceCamera.nearPlane = 0.05f;
+        faceCamera.farPlane = light.m_radius;
+
+        Frustum faceFrustum;
+        faceFrustum.setupInternals(fov, 1.0f, faceCamera.nearPlane, faceCamera.farPlane);
+        faceFrustum.updateCamPosition(faceCamera);
+
+        Renderer::renderToDepth(framebuffer, shadow.tiles[i], faceCamera, faceFrustum, true);
+
+        shadow.faceMatrices[i] = faceCamera.getProjection() * faceCamera.getView();
+    }
+
+    shadow.position = light.m_position;
+    shadow.radius = light.m_radius;
+    shadow.rendered = true;
+}
+
+void ShadowAtlas::setup(int size) {
+    this->size = size;
+
+    framebuffer.setup(size, size);
+    framebuffer.attachShadow(size, size);
+
+    allocator.setup(size, minTileSize);
+}
+
+void ShadowAtlas::destroy() {
+    framebuffer.destroy();
+    shadows.clear();
+}
+
+void ShadowAtlas::update(const Camera &cam, const std::vector<PointLight*> &lights) {
+    PROFILE_SCOPE("ShadowAtlas::update");
+
+    numUpdated = 0;
+
+    // pick the most important shadow casting lights
+    std::vector<std::pair<float, PointLight*>> candidates;
+
+    for (size_t i = 0; i < lights.size(); i++) {
+        PointLight *light = lights[i];
+
+        if (!light->m_castShadows) {
+            continue;
+        }
+
+        float distance = std::max(length(light->m_position - cam.getPosition()) - light->m_radius, cam.nearPlane);
+        candidates.push_back(std::make_pair(light->m_radius / distance, light));
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, PointLight*> &a, const std::pair<float, PointLight*> &b) {
+        return a.first > b.first;
+    });
+
+    if ((int)candidates.size() > maxShadowedLights) {
+        candidates.resize(std::max(maxShadowedLights, 0));
+    }
+
+    // release the tiles of lights that no longer get a shadow
+    for (auto it = shadows.begin(); it != shadows.end();) {
+        bool found = false;
+
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (candidates[i].second == it->first) {
+                found = true;
+                break;
+            }
+        }
+
+        if (found) {
+            ++it;
+        }
+        else {
+            for (int i = 0; i < 6; i++) {
+                allocator.free(it->second.tiles[i]);
+            }
+
+            it = shadows.erase(it);
+        }
+    }
+
+    // (re)allocate tiles in order of importance so the most important lights get space first
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const PointLight *light = candidates[i].second;
+        int tileSize = getTileSize(candidates[i].first);
+
+        auto it = shadows.find(light);
+
+        if (it != shadows.end()) {
+            it->second.importance = candidates[i].first;
+
+            // grow right away, only shrink after a large drop so lights near a threshold keep their tiles
+            if (tileSize > it->second.tileSize || tileSize * 4 <= it->second.tileSize) {
+                for (int j = 0; j < 6; j++) {
+                    allocator.free(it->second.tiles[j]);
+                }
+
+                shadows.erase(it);
+            }
+            else {
+                continue;
+            }
+        }
+
+        PointLightShadow shadow;
+        shadow.tileSize = tileSize;
+        shadow.importance = candidates[i].first;
+
+        int allocated = 0;
+        while (allocated < 6 && allocator.allocate(tileSize, shadow.tiles[allocated])) {
+            allocated++;
+        }
+
+        if (allocated < 6) {
+            for (int j = 0; j < allocated; j++) {
+                allocator.free(shadow.tiles[j]);
+            }
+
+            continue;
+        }
+
+        shadows[light] = shadow;
+    }
+
+    // re-render what changed, most important first, within the budget
+    std::vector<std::pair<const PointLight*, PointLightShadow*>> dirty;
+
+    for (auto &pair : shadows) {
+        const PointLight *light = pair.first;
+        PointLightShadow &shadow = pair.second;
+
+        Frustum bounds;
+        bounds.setupInternalsOrthographic(-light->m_radius, light->m_radius, -light->m_radius, light->m_radius, -light->m_radius, light->m_radius);
+        Camera boundsCamera;
+        boundsCamera.position = light->m_position;
+        bounds.updateCamPosition(boundsCamera);
+
+        unsigned int casterHash = Renderer::getShadowCasterHash(bounds, true);
+
+        if (!shadow.rendered || !(shadow.position == light->m_position) || shadow.radius != light->m_radius || shadow.casterHash != casterHash) {
+            shadow.casterHash = casterHash;
+            dirty.push_back(std::make_pair(light, &shadow));
+        }
+    }
+
+    std::sort(dirty.begin(), dirty.end(), [](const std::pair<const PointLight*, PointLightShadow*> &a, const std::pair<const PointLight*, PointLightShadow*> &b) {
+        // shadows that were never rendered can't be shown at all, they go first
+        if (a.second->rendered != b.second->rendered) {
+            return !a.second->rendered;
+        }
+
+        return a.second->importance > b.second->importance;
+    });
+
+    for (size_t i = 0; i < dirty.size() && numUpdated < updateBudget; i++) {
+        renderShadow(*dirty[i].first, *dirty[i].second);
+        numUpdated++;
+    }
+
+    // a skipped shadow has to be looked at again next frame
+    for (size_t i = (size_t)numUpdated; i < dirty.size(); i++) {
+        dirty[i].second->casterHash = 0;
+    }
+}
+
+const PointLightShadow *ShadowAtlas::getShadow(const PointLight *light) const {
+    auto it = shadows.find(light);
+
+    if (it == shadows.end() || !it->second.rendered) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+void ShadowAtlas::getShadowMatrices(const PointLightShadow &shadow, const mat4 &inverseView, mat4 matrices[6]) const {
+    for (int i = 0; i < 6; i++) {
+        const vec4i &tile = shadow.tiles[i];
+
+        // clip space to the tile's texture coordinates, and depth to [0, 1]
+        mat4 tileMatrix;
+        tileMatrix.m00 = 0.5f * (float)tile.z / (float)size;
+        tileMatrix.m03 = (0.5f * (float)tile.z + (float)tile.x) / (float)size;
+        tileMatrix.m11 = 0.5f * (float)tile.w / (float)size;
+        tileMatrix.m13 = (0.5f * (float)tile.w + (float)tile.y) / (float)size;
+        tileMatrix.m22 = 0.5f;
+        tileMatrix.m23 = 0.5f;
+
+        matrices[i] = tileMatrix * shadow.faceMatrices[i] * inverseView;
+    }
+}
+
+const Texture &ShadowAtlas::getTexture() const {
+    return framebuffer.getAttachment(0);
+}
+
+int ShadowAtlas::getSize() const {
+    return size;
+}
+
+int ShadowAtlas::getNumShadows() const {
+    return (int)shadows.size();
+}
+
+int ShadowAtlas::getNumUpdated() const {
+    return numUpdated;
+}
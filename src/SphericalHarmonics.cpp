@@ -0,0 +1,211 @@
+#include <crucible/SphericalHarmonics.hpp>
+#include <crucible/Profiler.hpp>
+#include <crucible/Simd.hpp>
+#include <crucible/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// faces smaller than 32 pixels are projected faster than the pool wakes up
+static const int minRowsForThreading = 192;
+
+// direction through the center of a face, and the directions its s and t coordinates run in, in OpenGL face order
+static const vec3 faceAxes[6][3] = {
+        {vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, -1.0f, 0.0f)},
+        {vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, -1.0f, 0.0f)},
+        {vec3(0.0f, 1.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f)},
+        {vec3(0.0f, -1.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f)},
+        {vec3(0.0f, 0.0f, 1.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)},
+        {vec3(0.0f, 0.0f, -1.0f), vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)}
+};
+
+// cosine lobe convolution per band, divided by pi
+static const float bandScales[3] = {1.0f, 2.0f / 3.0f, 0.25f};
+
+/**
+ * Radiance weighted by basis and solid angle, 9 coefficients of rgb, plus the summed weights.
+ */
+struct Accumulator {
+    double sums[27] = {};
+    double weight = 0.0;
+};
+
+static void projectRows(const float *const faces[6], int size, int firstRow, int lastRow, Accumulator &result) {
+    float scale = 2.0f / size;
+
+    for (int row = firstRow; row < lastRow; row++) {
+        int face = row / size;
+        int j = row % size;
+
+        const vec3 &axis = faceAxes[face][0];
+        const vec3 &uAxis = faceAxes[face][1];
+        const vec3 &vAxis = faceAxes[face][2];
+
+        const float *texels = faces[face] + (size_t)j * size * 3;
+
+        float v = (j + 0.5f) * scale - 1.0f;
+
+        // center of the face plus the t offset, the same for the whole row
+        vec3 rowDirection = axis + vAxis * v;
+
+        float sums[27] = {};
+        float weight = 0.0f;
+
+        int x = 0;
+
+#ifdef CRUCIBLE_SSE
+        __m128 acc[27];
+        for (int i = 0; i < 27; i++) {
+            acc[i] = _mm_setzero_ps();
+        }
+        __m128 weightAcc = _mm_setzero_ps();
+
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 vv = _mm_set1_ps(1.0f + v * v);
+
+        for (; x + 4 <= size; x += 4) {
+            __m128 u = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f)), _mm_set1_ps(scale)), one);
+
+            __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(vv, _mm_mul_ps(u, u))));
+
+            __m128 dx = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(rowDirection.x), _mm_mul_ps(u, _mm_set1_ps(uAxis.x))), invLength);
+            __m128 dy = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(rowDirection.y), _mm_mul_ps(u, _mm_set1_ps(uAxis.y))), invLength);
+            __m128 dz = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(rowDirection.z), _mm_mul_ps(u, _mm_set1_ps(uAxis.z))), invLength);
+
+            // solid angle of a texel, up to a constant that cancels out when normalizing
+            __m128 w = _mm_mul_ps(_mm_mul_ps(invLength, invLength), invLength);
+            weightAcc = _mm_add_ps(weightAcc, w);
+
+            __m128 b[9];
+            b[0] = _mm_set1_ps(0.282095f);
+            b[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), dy);
+            b[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), dz);
+            b[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), dx);
+            b[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dy));
+            b[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dy, dz));
+            b[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one));
+            b[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dz));
+            b[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+            const float *p = texels + x * 3;
+            __m128 r = _mm_mul_ps(_mm_set_ps(p[9], p[6], p[3], p[0]), w);
+            __m128 g = _mm_mul_ps(_mm_set_ps(p[10], p[7], p[4], p[1]), w);
+            __m128 bl = _mm_mul_ps(_mm_set_ps(p[11], p[8], p[5], p[2]), w);
+
+            for (int i = 0; i < 9; i++) {
+                acc[i * 3] = _mm_add_ps(acc[i * 3], _mm_mul_ps(r, b[i]));
+                acc[i * 3 + 1] = _mm_add_ps(acc[i * 3 + 1], _mm_mul_ps(g, b[i]));
+                acc[i * 3 + 2] = _mm_add_ps(acc[i * 3 + 2], _mm_mul_ps(bl, b[i]));
+            }
+        }
+
+        float lanes[4];
+        for (int i = 0; i < 27; i++) {
+            _mm_storeu_ps(lanes, acc[i]);
+            sums[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+        _mm_storeu_ps(lanes, weightAcc);
+        weight = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+        for (; x < size; x++) {
+            float u = (x + 0.5f) * scale - 1.0f;
+            float invLength = 1.0f / std::sqrt(1.0f + u * u + v * v);
+
+            vec3 direction = (rowDirection + uAxis * u) * invLength;
+            float w = invLength * invLength * invLength;
+
+            float b[9];
+            SphericalHarmonics::basis(direction, b);
+
+            const float *p = texels + x * 3;
+            for (int i = 0; i < 9; i++) {
+                sums[i * 3] += p[0] * w * b[i];
+                sums[i * 3 + 1] += p[1] * w * b[i];
+                sums[i * 3 + 2] += p[2] * w * b[i];
+            }
+
+            weight += w;
+        }
+
+        // rows are summed in floats, the whole map in doubles
+        for (int i = 0; i < 27; i++) {
+            result.sums[i] += sums[i];
+        }
+        result.weight += weight;
+    }
+}
+
+vec3 SH9::evaluate(const vec3 &normal) const {
+    float b[9];
+    SphericalHarmonics::basis(normal, b);
+
+    vec3 result;
+    for (int i = 0; i < 9; i++) {
+        result = result + coefficients[i] * b[i];
+    }
+
+    return result;
+}
+
+namespace SphericalHarmonics {
+    void basis(const vec3 &d, float out[9]) {
+        out[0] = 0.282095f;
+
+        out[1] = 0.488603f * d.y;
+        out[2] = 0.488603f * d.z;
+        out[3] = 0.488603f * d.x;
+
+        out[4] = 1.092548f * d.x * d.y;
+        out[5] = 1.092548f * d.y * d.z;
+        out[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+        out[7] = 1.092548f * d.x * d.z;
+        out[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+    }
+
+    SH9 projectIrradiance(const float *const faces[6], int size) {
+        PROFILE_SCOPE("SphericalHarmonics::projectIrradiance");
+
+        int rows = size * 6;
+
+        int bands = rows < minRowsForThreading ? 1 : std::min(ThreadPool::getThreadCount(), rows);
+        int rowsPerBand = (rows + bands - 1) / bands;
+
+        // one sum per band, added up in order afterwards so the result doesn't depend on scheduling
+        std::vector<Accumulator> partials(bands);
+
+        ThreadPool::parallelFor(bands, [faces, size, rows, rowsPerBand, &partials](int band) {
+            PROFILE_SCOPE("project rows");
+
+            int firstRow = std::min(band * rowsPerBand, rows);
+            projectRows(faces, size, firstRow, std::min(firstRow + rowsPerBand, rows), partials[band]);
+        });
+
+        Accumulator total;
+        for (const Accumulator &partial : partials) {
+            for (int i = 0; i < 27; i++) {
+                total.sums[i] += partial.sums[i];
+            }
+            total.weight += partial.weight;
+        }
+
+        SH9 result;
+
+        if (total.weight <= 0.0) {
+            return result;
+        }
+
+        // the summed solid angles have to come out as the whole sphere
+        double normalization = 4.0 * PI / total.weight;
+
+        for (int i = 0; i < 9; i++) {
+            float band = bandScales[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+            float s = (float)(normalization * band);
+
+            result.coefficients[i] = vec3((float)total.sums[i * 3], (float)total.sums[i * 3 + 1], (float)total.sums[i * 3 + 2]) * s;
+        }
+
+        return result;
+    }
+}
@@ -1,11 +1,23 @@
 #include <crucible/Texture.hpp>
 #include <crucible/Renderer.hpp>
+#include <crucible/Hash.hpp>
 #include <crucible/Mesh.hpp>
 #include <crucible/Resources.hpp>
 
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static const unsigned int cubemapMagic = 0x4d435243; // "CRCM"
+static const unsigned int cubemapVersion = 1;
+
 void Texture::load(const unsigned char *data, int width, int height, bool pixelated, bool singleChannel) {
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id);
@@ -60,6 +72,55 @@ void Texture::setID(unsigned int id) {
 	this->id = id;
 }
 
+bool Texture::save(const Path &file, bool gammaCorrect) const {
+	int width = 0;
+	int height = 0;
+
+	glBindTexture(GL_TEXTURE_2D, id);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+	if (width == 0 || height == 0) {
+		glBindTexture(GL_TEXTURE_2D, 0);
+		std::cout << "Can't save texture " << file << ", it has no image" << std::endl;
+		return false;
+	}
+
+	std::vector<float> pixels((size_t)width * height * 4);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, &pixels[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	std::vector<unsigned char> image((size_t)width * height * 4);
+
+	for (int y = 0; y < height; y++) {
+		// OpenGL's first row is the bottom of the image
+		const float *source = &pixels[(size_t)(height - 1 - y) * width * 4];
+		unsigned char *destination = &image[(size_t)y * width * 4];
+
+		for (int x = 0; x < width * 4; x++) {
+			float value = source[x];
+
+			if (x % 4 == 3) {
+				value = 1.0f;
+			}
+			else if (gammaCorrect) {
+				value = std::pow(std::max(value, 0.0f), 1.0f / 2.2f);
+			}
+
+			destination[x] = (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+
+	if (!stbi_write_png(file.toString().c_str(), width, height, 4, &image[0], width * 4)) {
+		std::cout << "Failed to write " << file << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
 void Texture::destroy() {
 	glDeleteTextures(1, &id);
 	id = 0;
@@ -102,10 +163,33 @@ void Cubemap::load(const Path &file1, const Path &file2, const Path &file3,
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 }
 
-void Cubemap::loadEquirectangular(const Path &file, int resolution) {
+void Cubemap::loadEquirectangular(const Path &file, int resolution, bool cache) {
 	unsigned int hdrTexture;
 	unsigned int envCubemap;
 
+	Path cachePath(file.toString() + ".cubemap");
+	unsigned int key = 0;
+
+	if (cache) {
+		// FNV-1a of the image and the resolution, hashing is far cheaper than decoding
+		std::ifstream source(file.toString(), std::ios::binary);
+
+		if (source) {
+			key = Hash::OFFSET_BASIS;
+
+			char buffer[4096];
+			while (source.read(buffer, sizeof(buffer)) || source.gcount() > 0) {
+				key = Hash::fnv1a(key, buffer, (size_t)source.gcount());
+			}
+
+			key = Hash::fnv1a(key, &resolution, sizeof(resolution));
+
+			if (loadBinary(cachePath, key)) {
+				return;
+			}
+		}
+	}
+
 	glDepthFunc(GL_LEQUAL);
 
 	static mat4 captureProjection = perspective(90.0f, 1.0f, 0.1f, 10000.0f);
@@ -188,6 +272,121 @@ void Cubemap::loadEquirectangular(const Path &file, int resolution) {
 	glDeleteRenderbuffers(1, &captureRBO);
 
 	this->setID(envCubemap);
+
+	if (key) {
+		saveBinary(cachePath, key);
+	}
+}
+
+bool Cubemap::saveBinary(const Path &file, unsigned int key, int mipLevels) const {
+	int resolution = 0;
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+	glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &resolution);
+
+	if (resolution == 0) {
+		std::cout << "Can't save cubemap " << file << ", it has no image" << std::endl;
+		return false;
+	}
+
+	std::ofstream out(file.toString(), std::ios::binary);
+
+	if (!out) {
+		std::cout << "Could not write cubemap " << file << std::endl;
+		return false;
+	}
+
+	unsigned int header[5] = {cubemapMagic, cubemapVersion, key, (unsigned int)resolution, (unsigned int)mipLevels};
+	out.write((const char*)header, sizeof(header));
+
+	std::vector<unsigned short> pixels;
+
+	// small mips have rows that aren't a multiple of four bytes
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	for (int mip = 0; mip < mipLevels; mip++) {
+		int size = std::max(resolution >> mip, 1);
+		pixels.resize((size_t)size * size * 3);
+
+		for (int i = 0; i < 6; i++) {
+			glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGB, GL_HALF_FLOAT, &pixels[0]);
+			out.write((const char*)&pixels[0], pixels.size() * sizeof(unsigned short));
+		}
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	return true;
+}
+
+bool Cubemap::loadBinary(const Path &file, unsigned int key) {
+	std::ifstream in(file.toString(), std::ios::binary);
+
+	if (!in) {
+		return false;
+	}
+
+	unsigned int header[5] = {0, 0, 0, 0, 0};
+	in.read((char*)header, sizeof(header));
+
+	if (!in || header[0] != cubemapMagic || header[1] != cubemapVersion || header[2] != key) {
+		return false;
+	}
+
+	int resolution = (int)header[3];
+	int mipLevels = (int)header[4];
+
+	if (resolution <= 0 || mipLevels <= 0 || (resolution >> (mipLevels - 1)) == 0) {
+		std::cout << "Cubemap " << file << " has an invalid header" << std::endl;
+		return false;
+	}
+
+	// read everything before creating the texture, so a truncated file leaves nothing behind
+	size_t total = 0;
+	for (int mip = 0; mip < mipLevels; mip++) {
+		size_t size = resolution >> mip;
+		total += size * size * 3 * 6;
+	}
+
+	std::vector<unsigned short> pixels(total);
+	in.read((char*)&pixels[0], total * sizeof(unsigned short));
+
+	if (!in) {
+		std::cout << "Cubemap " << file << " is truncated" << std::endl;
+		return false;
+	}
+
+	unsigned int cubemap;
+	glGenTextures(1, &cubemap);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	const unsigned short *data = &pixels[0];
+	for (int mip = 0; mip < mipLevels; mip++) {
+		int size = resolution >> mip;
+
+		for (int i = 0; i < 6; i++) {
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGB16F, size, size, 0, GL_RGB, GL_HALF_FLOAT, data);
+			data += (size_t)size * size * 3;
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// a partial mip chain, like the prefiltered maps have, is only complete with the levels limited
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
+
+	this->setID(cubemap);
+
+	return true;
 }
 
 void Cubemap::bind(unsigned int unit) const {
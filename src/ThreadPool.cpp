@@ -0,0 +1,129 @@
+#include <crucible/ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Pool {
+    // only one loop runs at a time, others wait here
+    std::mutex loopMutex;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::vector<std::thread> workers;
+
+    // the running loop, written under mutex before the workers are woken
+    const std::function<void(int)> *task = nullptr;
+    int count = 0;
+    std::atomic<int> next;
+
+    // workers below this index take part in the running loop, the rest stay asleep
+    int active = 0;
+    int busy = 0;
+    uint64_t generation = 0;
+
+    bool quit = false;
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+};
+
+static Pool pool;
+
+// set on workers and on a thread running a loop, nested loops would otherwise wait on themselves
+static thread_local bool insideLoop = false;
+
+static void runTasks() {
+    int i;
+    while ((i = pool.next.fetch_add(1)) < pool.count) {
+        (*pool.task)(i);
+    }
+}
+
+static void workerMain(int index) {
+    insideLoop = true;
+
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(pool.mutex);
+
+    while (true) {
+        pool.wake.wait(lock, [&]() { return pool.quit || pool.generation != seen; });
+
+        if (pool.quit) {
+            return;
+        }
+
+        seen = pool.generation;
+
+        if (index >= pool.active) {
+            continue;
+        }
+
+        lock.unlock();
+        runTasks();
+        lock.lock();
+
+        if (--pool.busy == 0) {
+            pool.finished.notify_one();
+        }
+    }
+}
+
+namespace ThreadPool {
+    int numThreads = 0;
+
+    int getThreadCount() {
+        int threads = numThreads > 0 ? numThreads : (int)std::thread::hardware_concurrency();
+
+        return std::max(threads, 1);
+    }
+
+    void parallelFor(int count, const std::function<void(int)> &task) {
+        int threads = std::min(getThreadCount(), count);
+
+        if (threads <= 1 || insideLoop) {
+            for (int i = 0; i < count; i++) {
+                task(i);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> loopLock(pool.loopMutex);
+        std::unique_lock<std::mutex> lock(pool.mutex);
+
+        while ((int)pool.workers.size() < threads - 1) {
+            pool.workers.push_back(std::thread(workerMain, (int)pool.workers.size()));
+        }
+
+        pool.task = &task;
+        pool.count = count;
+        pool.next.store(0);
+        pool.active = threads - 1;
+        pool.busy = threads - 1;
+        pool.generation++;
+
+        lock.unlock();
+        pool.wake.notify_all();
+
+        insideLoop = true;
+        runTasks();
+        insideLoop = false;
+
+        lock.lock();
+        pool.finished.wait(lock, [&]() { return pool.busy == 0; });
+        pool.task = nullptr;
+    }
+}
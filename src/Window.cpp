@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <crucible/Input.hpp>
+#include <crucible/Profiler.hpp>
 
 
 #include <imgui.h>
@@ -10,6 +11,8 @@
 #include <examples/imgui_impl_glfw.h>
 #include <examples/imgui_impl_opengl3.h>
 
+#include <algorithm>
+
 //Enable the dedicated GPU on Nvidia Optimus systems
 #ifdef _WIN32
 #include <windows.h>
@@ -20,11 +23,14 @@ __declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
 
 GLFWwindow *Window::window;
 
+static bool headless = false;
+
 void Window::create(const vec2i &resolution, const std::string &title, bool fullscreen, bool vsync) {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, headless ? GLFW_FALSE : GLFW_TRUE);
 
     if (fullscreen) {
         GLFWmonitor *monitor = glfwGetPrimaryMonitor();
@@ -118,6 +124,17 @@ void Window::create(const vec2i &resolution, const std::string &title, bool full
     Input::setWindowInstance(window);
 }
 
+void Window::createHeadless(const vec2i &resolution, const std::string &title) {
+    headless = true;
+
+    // no vsync, frames should take exactly as long as they take to render
+    create(resolution, title, false, false);
+}
+
+bool Window::isHeadless() {
+    return headless;
+}
+
 bool Window::isOpen() {
     return !glfwWindowShouldClose(window);
 }
@@ -125,10 +142,24 @@ bool Window::isOpen() {
 static float delta = 0;
 static float lastFrameTime = 0;
 
+static float fixedTimestep = 0.0f;
+static double fixedTime = 0.0;
+static int frameCount = 0;
+
 void Window::begin() {
-    float currentFrameTime = Window::getTime();
-    delta = currentFrameTime - lastFrameTime;
-    lastFrameTime = currentFrameTime;
+    Profiler::newFrame();
+
+    frameCount++;
+
+    if (fixedTimestep > 0.0f) {
+        fixedTime += fixedTimestep;
+        delta = fixedTimestep;
+    }
+    else {
+        float currentFrameTime = Window::getTime();
+        delta = currentFrameTime - lastFrameTime;
+        lastFrameTime = currentFrameTime;
+    }
 
     glClearColor(0.0f ,0.0f , 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -154,6 +185,10 @@ void Window::terminate() {
 }
 
 float Window::getTime() {
+    if (fixedTimestep > 0.0f) {
+        return (float)fixedTime;
+    }
+
     return glfwGetTime();
 }
 
@@ -161,6 +196,18 @@ float Window::deltaTime() {
     return delta;
 }
 
+void Window::setFixedTimestep(float seconds) {
+    fixedTimestep = std::max(seconds, 0.0f);
+    fixedTime = 0.0;
+
+    // don't count the time spent in fixed steps as one long frame when going back
+    lastFrameTime = glfwGetTime();
+}
+
+int Window::getFrameCount() {
+    return frameCount;
+}
+
 vec2i Window::getWindowSize() {
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
@@ -179,4 +226,8 @@ void Window::setMouseGrabbed(bool grabbed) {
 
 bool Window::getMouseGrabbed() {
     return glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED;
-}
\ No newline at end of file
+}
+
+void *Window::getProcAddress(const char *name) {
+    return (void*)glfwGetProcAddress(name);
+}
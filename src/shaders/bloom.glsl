@@ -1,16 +1,10 @@
-uniform sampler2D source;
+uniform sampler2D STAGE_bloom;
 
-uniform sampler2D bloom0;
-uniform sampler2D bloom1;
-uniform sampler2D bloom2;
+uniform float STAGE_bloomStrength;
 
-uniform float bloomStrength;
 
-
-vec3 postProcess(vec2 texCoord) {
-    vec3 color = texture(source, texCoord).rgb;
-
-    color += (texture(bloom0, texCoord).rgb*bloomStrength) + (texture(bloom1, texCoord).rgb*bloomStrength) + (texture(bloom2, texCoord).rgb*bloomStrength);
+vec3 STAGE_apply(vec3 color, vec2 texCoord) {
+    color += texture(STAGE_bloom, texCoord).rgb * STAGE_bloomStrength;
 
 	return color;
 }
\ No newline at end of file
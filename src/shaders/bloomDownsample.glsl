@@ -0,0 +1,28 @@
+uniform sampler2D source;
+
+// 13 bilinear taps covering a 6x6 texel area, five overlapping 4x4 boxes weighted toward the center. Halving the
+// resolution with this instead of a single tap keeps small bright spots from flickering as they move.
+vec3 postProcess(vec2 texCoord) {
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+
+    vec3 a = texture(source, texCoord + texel * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, texCoord + texel * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, texCoord + texel * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, texCoord + texel * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, texCoord).rgb;
+    vec3 f = texture(source, texCoord + texel * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, texCoord + texel * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, texCoord + texel * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, texCoord + texel * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, texCoord + texel * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, texCoord + texel * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, texCoord + texel * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, texCoord + texel * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+
+    return clamp(result, 0.0, 100.0);
+}
\ No newline at end of file
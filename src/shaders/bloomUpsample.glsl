@@ -0,0 +1,23 @@
+uniform sampler2D source;
+
+uniform float radius;
+
+// 3x3 tent filter, drawn into the next larger level with additive blending. Sampling between texels of the smaller
+// level lets bilinear filtering do most of the smoothing.
+vec3 postProcess(vec2 texCoord) {
+    vec2 texel = radius / vec2(textureSize(source, 0));
+
+    vec3 result = texture(source, texCoord).rgb * 4.0;
+
+    result += texture(source, texCoord + texel * vec2( 0.0,  1.0)).rgb * 2.0;
+    result += texture(source, texCoord + texel * vec2(-1.0,  0.0)).rgb * 2.0;
+    result += texture(source, texCoord + texel * vec2( 1.0,  0.0)).rgb * 2.0;
+    result += texture(source, texCoord + texel * vec2( 0.0, -1.0)).rgb * 2.0;
+
+    result += texture(source, texCoord + texel * vec2(-1.0,  1.0)).rgb;
+    result += texture(source, texCoord + texel * vec2( 1.0,  1.0)).rgb;
+    result += texture(source, texCoord + texel * vec2(-1.0, -1.0)).rgb;
+    result += texture(source, texCoord + texel * vec2( 1.0, -1.0)).rgb;
+
+    return result / 16.0;
+}
\ No newline at end of file
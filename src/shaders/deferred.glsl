@@ -1,12 +1,9 @@
 #include <lighting>
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
-uniform sampler2D gRoughnessMetallic;
+#include <gbuffer>
 
 vec3 postProcess(vec2 texCoord) {
-    vec3 FragPos = texture(gPosition, texCoord).rgb;
+    vec3 FragPos = gBufferPosition(texCoord);
 
     if (length(FragPos) == 0.0) {
         discard;
@@ -1,20 +1,49 @@
 #include <lighting>
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
-uniform sampler2D gRoughnessMetallic;
+#include <gbuffer>
 uniform samplerCube irradiance;
 uniform samplerCube prefilter;
 uniform sampler2D brdf;
 
 uniform mat4 inverseView;
 
+// up to two baked probes, each fading out towards its radius, irradiance and prefilter light the rest
+uniform int numProbes;
+uniform samplerCube probeIrradiance[2];
+uniform samplerCube probePrefilter[2];
+uniform vec3 probePositions[2];
+uniform float probeRadii[2];
+
+// probes without specular, irradiance as 9 spherical harmonics coefficients each
+#define MAX_SH_PROBES 16
+uniform int numSHProbes;
+uniform vec3 shCoefficients[MAX_SH_PROBES * 9];
+uniform vec3 shPositions[MAX_SH_PROBES];
+uniform float shRadii[MAX_SH_PROBES];
+
+float probeWeight(vec3 worldPos, vec3 probePosition, float radius) {
+    return 1.0 - smoothstep(0.5, 1.0, length(worldPos - probePosition) / radius);
+}
+
+vec3 evaluateSH(int probe, vec3 n) {
+    int i = probe * 9;
+
+    return shCoefficients[i] * 0.282095
+         + shCoefficients[i + 1] * 0.488603 * n.y
+         + shCoefficients[i + 2] * 0.488603 * n.z
+         + shCoefficients[i + 3] * 0.488603 * n.x
+         + shCoefficients[i + 4] * 1.092548 * n.x * n.y
+         + shCoefficients[i + 5] * 1.092548 * n.y * n.z
+         + shCoefficients[i + 6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + shCoefficients[i + 7] * 1.092548 * n.x * n.z
+         + shCoefficients[i + 8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
 vec3 postProcess(vec2 texCoord) {
 
     // retrieve data from gbuffer
-    vec3 fragPos = texture(gPosition, texCoord).rgb;
-    vec3 normal = normalize(texture(gNormal, texCoord).rgb);
+    vec3 fragPos = gBufferPosition(texCoord);
+    vec3 normal = gBufferNormal(texCoord);
     vec3 albedo = texture(gAlbedo, texCoord).rgb;
 	vec4 RoughnessMetallic = texture(gRoughnessMetallic, texCoord);
 	float roughness = RoughnessMetallic.r;
@@ -33,11 +62,58 @@ vec3 postProcess(vec2 texCoord) {
 	vec3 kD = 1.0 - kS;
 	kD *= 1.0 - metallic;
 
-	vec3 irradianceColor = texture(irradiance, (inverseView * vec4(N, 0.0)).xyz).rgb;
-	vec3 diffuse = irradianceColor * albedo;
+	vec3 worldPos = (inverseView * vec4(fragPos, 1.0)).xyz;
+	vec3 worldN = (inverseView * vec4(N, 0.0)).xyz;
+	vec3 worldR = (inverseView * vec4(R, 0.0)).xyz;
 
 	const float MAX_REFLECTION_LOD = 4.0;
-    vec3 prefilteredColor = textureLod(prefilter, (inverseView * vec4(R, 0.0)).xyz,  roughness * MAX_REFLECTION_LOD).rgb;
+	float lod = roughness * MAX_REFLECTION_LOD;
+
+	// sampler arrays can only be indexed by constants here, so the two probes are written out
+	vec3 irradianceColor = vec3(0.0);
+	vec3 prefilteredColor = vec3(0.0);
+	float irradianceWeight = 0.0;
+	float prefilterWeight = 0.0;
+
+	for (int i = 0; i < numSHProbes; i++) {
+		float weight = probeWeight(worldPos, shPositions[i], shRadii[i]);
+
+		if (weight > 0.0) {
+			irradianceColor += max(evaluateSH(i, worldN), vec3(0.0)) * weight;
+			irradianceWeight += weight;
+		}
+	}
+
+	if (numProbes > 0) {
+		float weight = probeWeight(worldPos, probePositions[0], probeRadii[0]);
+		irradianceColor += texture(probeIrradiance[0], worldN).rgb * weight;
+		prefilteredColor += textureLod(probePrefilter[0], worldR, lod).rgb * weight;
+		irradianceWeight += weight;
+		prefilterWeight += weight;
+	}
+	if (numProbes > 1) {
+		float weight = probeWeight(worldPos, probePositions[1], probeRadii[1]);
+		irradianceColor += texture(probeIrradiance[1], worldN).rgb * weight;
+		prefilteredColor += textureLod(probePrefilter[1], worldR, lod).rgb * weight;
+		irradianceWeight += weight;
+		prefilterWeight += weight;
+	}
+
+	if (irradianceWeight > 1.0) {
+		irradianceColor /= irradianceWeight;
+	}
+	else {
+		irradianceColor += texture(irradiance, worldN).rgb * (1.0 - irradianceWeight);
+	}
+
+	if (prefilterWeight > 1.0) {
+		prefilteredColor /= prefilterWeight;
+	}
+	else {
+		prefilteredColor += textureLod(prefilter, worldR, lod).rgb * (1.0 - prefilterWeight);
+	}
+
+	vec3 diffuse = irradianceColor * albedo;
 	vec2 brdfColor = texture(brdf, vec2(max(dot(N, V), 0.0), roughness)).rg;
 
 	vec3 specular = prefilteredColor * (F * brdfColor.x + brdfColor.y);
@@ -1,9 +1,6 @@
 #include <lighting>
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
-uniform sampler2D gRoughnessMetallic;
+#include <gbuffer>
 
 uniform mat4 view;
 
@@ -43,13 +40,13 @@ vec3 lighting(vec3 fragPos, vec3 albedo, vec3 normal, float roughness, float met
 }
 vec3 postProcess(vec2 texCoord) {
     // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, texCoord).rgb;
+    vec3 FragPos = gBufferPosition(texCoord);
 
     if (length(FragPos) == 0.0) {
         discard;
     }
 
-    vec3 Normal = normalize(texture(gNormal, texCoord).rgb);
+    vec3 Normal = gBufferNormal(texCoord);
     vec3 Albedo = texture(gAlbedo, texCoord).rgb;
 	vec4 RoughnessMetallic = texture(gRoughnessMetallic, texCoord);
 	float Roughness = RoughnessMetallic.r;
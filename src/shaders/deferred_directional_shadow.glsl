@@ -1,9 +1,6 @@
 #include <lighting>
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
-uniform sampler2D gRoughnessMetallic;
+#include <gbuffer>
 
 uniform sampler2D shadowTextures[8];
 uniform float shadowDistances[8];
@@ -39,7 +36,8 @@ vec3 lighting(vec3 fragPos, vec3 albedo, vec3 normal, float roughness, float met
 
     float shadow = 1.0;
 
-    float distance = length(fragPos);
+    // cascades are split by view depth
+    float distance = -fragPos.z;
 
     vec3 shadowColor;
 
@@ -48,6 +46,13 @@ vec3 lighting(vec3 fragPos, vec3 albedo, vec3 normal, float roughness, float met
     for (int i = 0; i < numCascades; i++) {
         if (distance < shadowDistances[i]) {
             vec4 fragLightSpace = lightSpaceMatrix[i] * vec4(fragPos, 1.0);
+            vec2 shadowCoords = fragLightSpace.xy / fragLightSpace.w;
+
+            // a cached cascade can lag behind the camera, fall through to the next one outside of its map
+            if (any(lessThan(shadowCoords, vec2(0.0))) || any(greaterThan(shadowCoords, vec2(1.0)))) {
+                continue;
+            }
+
             float bias = 0.001*tan(acos(cosTheta));
 
             shadow = ShadowCalculationLinear(bias, fragLightSpace, shadowTextures[i], shadowDistances[i]);
@@ -83,8 +88,8 @@ vec3 lighting(vec3 fragPos, vec3 albedo, vec3 normal, float roughness, float met
 }
 vec3 postProcess(vec2 texCoord) {
     // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, texCoord).rgb;
-    vec3 Normal = normalize(texture(gNormal, texCoord).rgb);
+    vec3 FragPos = gBufferPosition(texCoord);
+    vec3 Normal = gBufferNormal(texCoord);
     vec3 Albedo = texture(gAlbedo, texCoord).rgb;
 	vec4 RoughnessMetallic = texture(gRoughnessMetallic, texCoord);
 	float Roughness = RoughnessMetallic.r;
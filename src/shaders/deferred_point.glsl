@@ -1,17 +1,27 @@
 #include <lighting>
-#define MAX_POINT_LIGHTS 100
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
-uniform sampler2D gRoughnessMetallic;
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#include <gbuffer>
 
-uniform int pointLightCount;
-uniform PointLight[MAX_POINT_LIGHTS] pointLights;
+// two texels per light: view space position + radius, color
+uniform samplerBuffer lightData;
+// offset into lightIndices and light count of every cluster
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer lightIndices;
+// six view space to atlas matrices per shadowed light, one column per texel
+uniform samplerBuffer shadowMatrices;
+uniform sampler2D shadowAtlas;
+
+uniform mat4 inverseView;
+
+uniform float clusterNear;
+uniform float clusterDepthScale;
 
 vec3 postProcess(vec2 texCoord) {
     // retrieve data from gbuffer
-    vec3 fragPos = texture(gPosition, texCoord).rgb;
-    vec3 normal = normalize(texture(gNormal, texCoord).rgb);
+    vec3 fragPos = gBufferPosition(texCoord);
+    vec3 normal = gBufferNormal(texCoord);
     vec3 albedo = texture(gAlbedo, texCoord).rgb;
 	vec4 RoughnessMetallic = texture(gRoughnessMetallic, texCoord);
 	float roughness = RoughnessMetallic.r;
@@ -19,6 +29,16 @@ vec3 postProcess(vec2 texCoord) {
     float emission = RoughnessMetallic.a;
     float ao = RoughnessMetallic.b;
 
+    if (length(fragPos) == 0.0) {
+        discard;
+    }
+
+    // find the cluster this pixel falls into
+    ivec2 tile = clamp(ivec2(texCoord * vec2(CLUSTER_X, CLUSTER_Y)), ivec2(0), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    int slice = clamp(int(log(max(-fragPos.z, clusterNear) / clusterNear) * clusterDepthScale), 0, CLUSTER_Z - 1);
+    int cluster = (slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x;
+
+    uvec2 range = texelFetch(clusterGrid, cluster).rg;
 
     vec3 N = normal;
 	vec3 V = normalize(-fragPos);
@@ -27,39 +47,27 @@ vec3 postProcess(vec2 texCoord) {
     F0 = mix(F0, albedo, metallic);
     // reflectance equation
     vec3 Lo = vec3(0.0);
-    
-    for (int i = 0; i < pointLightCount; i++) {
-		if (i < MAX_POINT_LIGHTS) {
-			PointLight light = pointLights[i];
-            // calculate per-light radiance
-            vec3 L = normalize(light.position - fragPos);
-            vec3 H = normalize(V + L);
-            float distance    = length(light.position - fragPos);
-            float attenuation = pow(clamp(1.0 - pow(distance / light.radius, 1.0), 0.0, 1.0), 2.0) / (distance * distance + 1.0);
-            vec3 radiance     = light.color * 100.0 * attenuation;
-            // cook-torrance brdf
-            float NDF = DistributionGGX(N, H, roughness);
-            float G   = GeometrySmith(N, V, L, roughness);
-            vec3 F    = fresnelSchlickRoughness(clamp(dot(H, V), 0.0, 1.0), F0, roughness);
-            vec3 kS = F;
-            vec3 kD = vec3(1.0) - kS;
-            kD *= 1.0 - metallic;
-            vec3 nominator    = NDF * G * F;
-            float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
-            vec3 specular     = nominator / denominator;
-            // add to outgoing radiance Lo
-            float NdotL = max(dot(N, L), 0.0);
-            if (distance < light.radius) {
-                Lo += (kD * albedo / PI + specular) * radiance * NdotL;
-            }
-		}
-	}
 
-    //vec3 light = Albedo;
-	if (length(fragPos) > 0.0) {
-		return Lo;
-	}
-	else {
-		discard;
-	}
-}
\ No newline at end of file
+    for (uint i = 0u; i < range.y; i++) {
+        int lightIndex = int(texelFetch(lightIndices, int(range.x + i)).r);
+
+        vec4 positionRadius = texelFetch(lightData, lightIndex * 2);
+        vec3 lightPosition = positionRadius.xyz;
+        float lightRadius = positionRadius.w;
+        vec4 colorShadow = texelFetch(lightData, lightIndex * 2 + 1);
+        vec3 lightColor = colorShadow.rgb;
+
+        float shadow = 1.0;
+        if (colorShadow.a >= 0.0) {
+            int face = CubeFace(mat3(inverseView) * (fragPos - lightPosition));
+            int base = (int(colorShadow.a) * 6 + face) * 4;
+            mat4 shadowMatrix = mat4(texelFetch(shadowMatrices, base), texelFetch(shadowMatrices, base + 1), texelFetch(shadowMatrices, base + 2), texelFetch(shadowMatrices, base + 3));
+
+            shadow = AtlasShadow(shadowAtlas, shadowMatrix * vec4(fragPos, 1.0), 0.0005);
+        }
+
+        Lo += PointLightContribution(fragPos, N, V, albedo, roughness, metallic, F0, lightPosition, lightColor, lightRadius) * shadow;
+    }
+
+    return Lo;
+}
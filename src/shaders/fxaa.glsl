@@ -1,6 +1,5 @@
-uniform sampler2D source;
-
-vec3 postProcess(vec2 texCoord) {
+// reads its neighbours from the pass input, so it always starts a pass
+vec3 STAGE_apply(vec3 color, vec2 texCoord) {
 
     vec2 frameBufSize = textureSize(source, 0).xy;
 
@@ -1,8 +1,4 @@
-uniform sampler2D tex;
-
-vec3 postProcess(vec2 texCoord) {
-    vec3 color = texture(tex, texCoord).rgb;
-
+vec3 STAGE_apply(vec3 color, vec2 texCoord) {
     color = pow(color, vec3(1.0/2.2));
 
     return color;
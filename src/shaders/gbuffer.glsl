@@ -0,0 +1,73 @@
+#ifndef GBUFFER_GLSL
+#define GBUFFER_GLSL
+// reads the g-buffer in either layout, bound by Renderer::bindGBuffer
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gRoughnessMetallic;
+
+// the compact layout has no position target, positions are rebuilt from the depth buffer, and normals are octahedral
+// encoded in two channels
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    vec2 encoded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+
+    return encoded * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+
+    return normalize(n);
+}
+
+// view space position, 0 where nothing was drawn
+vec3 gBufferPosition(vec2 texCoord) {
+    if (!compactGBuffer) {
+        return texture(gPosition, texCoord).xyz;
+    }
+
+    float depth = texture(gDepth, texCoord).r;
+
+    if (depth == 1.0) {
+        return vec3(0.0);
+    }
+
+    vec4 position = inverseProjection * vec4(vec3(texCoord, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+// view space z alone, cheaper in the compact layout since z and w only depend on the depth
+float gBufferViewZ(vec2 texCoord) {
+    if (!compactGBuffer) {
+        return texture(gPosition, texCoord).z;
+    }
+
+    float depth = texture(gDepth, texCoord).r;
+
+    if (depth == 1.0) {
+        return 0.0;
+    }
+
+    vec2 zw = (inverseProjection * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0)).zw;
+    return zw.x / zw.y;
+}
+
+vec3 gBufferNormal(vec2 texCoord) {
+    if (compactGBuffer) {
+        return decodeNormal(texture(gNormal, texCoord).rg);
+    }
+
+    return normalize(texture(gNormal, texCoord).rgb);
+}
+#endif
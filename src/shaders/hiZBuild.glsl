@@ -0,0 +1,36 @@
+#include <gbuffer>
+
+uniform sampler2D source;
+
+// level 0 reads the g-buffer, the others the level below
+uniform bool firstLevel;
+
+const float FAR_DISTANCE = 1.0e20;
+
+vec3 postProcess(vec2 texCoord) {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+
+    if (firstLevel) {
+        float viewZ = gBufferViewZ(texCoord);
+        float distance = viewZ != 0.0 ? -viewZ : FAR_DISTANCE;
+
+        return vec3(distance, distance, 0.0);
+    }
+
+    ivec2 size = textureSize(source, 0);
+    ivec2 base = coord * 2;
+
+    // with an odd size the last row or column of the level below is folded into the last texel of this one
+    int countX = base.x + 3 == size.x ? 3 : 2;
+    int countY = base.y + 3 == size.y ? 3 : 2;
+
+    vec2 result = vec2(FAR_DISTANCE, 0.0);
+    for (int y = 0; y < countY; y++) {
+        for (int x = 0; x < countX; x++) {
+            vec2 texel = texelFetch(source, min(base + ivec2(x, y), size - 1), 0).rg;
+            result = vec2(min(result.x, texel.x), max(result.y, texel.y));
+        }
+    }
+
+    return vec3(result, 0.0);
+}
\ No newline at end of file
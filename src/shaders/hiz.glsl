@@ -0,0 +1,91 @@
+// nearest and farthest view distance per texel, see HiZBuffer
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+
+vec2 hiZFetch(vec2 pixel, int level) {
+    ivec2 size = textureSize(hiZ, level);
+    ivec2 cell = clamp(ivec2(pixel) >> level, ivec2(0), size - 1);
+
+    return texelFetch(hiZ, cell, level).rg;
+}
+
+// Traces a view space ray through the pyramid, hitCoord is set to the texture coordinate of the first surface it passes
+// behind (by less than thickness). The ray climbs a level after every cell it passes and descends when a cell's depth
+// range overlaps its own, so open areas are crossed a few large cells at a time.
+bool hiZTrace(vec3 origin, vec3 direction, mat4 projection, float maxDistance, float thickness, int maxIterations, out vec2 hitCoord) {
+    hitCoord = vec2(0.0);
+    vec2 size = vec2(textureSize(hiZ, 0));
+
+    // keep the end in front of the camera
+    float rayLength = maxDistance;
+    if (direction.z > 0.0) {
+        rayLength = min(rayLength, (-0.01 - origin.z) / direction.z);
+    }
+
+    vec4 h0 = projection * vec4(origin, 1.0);
+    vec4 h1 = projection * vec4(origin + direction * rayLength, 1.0);
+    float k0 = 1.0 / h0.w;
+    float k1 = 1.0 / h1.w;
+
+    // in level 0 pixels, 1/w and so 1/distance interpolate linearly along the screen space ray
+    vec2 s0 = (h0.xy * k0 * 0.5 + 0.5) * size;
+    vec2 s1 = (h1.xy * k1 * 0.5 + 0.5) * size;
+
+    vec2 delta = s1 - s0;
+    delta = vec2(abs(delta.x) < 0.0001 ? 0.0001 : delta.x, abs(delta.y) < 0.0001 ? 0.0001 : delta.y);
+    vec2 invDelta = 1.0 / delta;
+    vec2 towards = step(0.0, delta);
+
+    vec2 screenExit = max(-s0 * invDelta, (size - s0) * invDelta);
+    float tEnd = min(1.0, min(screenExit.x, screenExit.y));
+
+    float pixelLength = 1.0 / length(delta);
+
+    // start a pixel out so the ray doesn't hit the surface it leaves
+    float t = pixelLength;
+    int level = 0;
+
+    for (int i = 0; i < maxIterations && t < tEnd; i++) {
+        vec2 pixel = s0 + delta * t;
+        float cellSize = float(1 << level);
+
+        vec2 crossing = ((floor(pixel / cellSize) + towards) * cellSize - s0) * invDelta;
+        float tCell = min(min(crossing.x, crossing.y), tEnd);
+
+        float d0 = 1.0 / mix(k0, k1, t);
+        float d1 = 1.0 / mix(k0, k1, tCell);
+        vec2 range = hiZFetch(pixel, level);
+
+        if (max(d0, d1) >= range.x && min(d0, d1) <= range.y + thickness) {
+            if (level == 0) {
+                hitCoord = pixel / size;
+                return true;
+            }
+
+            level--;
+        }
+        else {
+            t = tCell + pixelLength * 0.01;
+            level = min(level + 1, hiZLevels - 1);
+        }
+    }
+
+    return false;
+}
+
+// Whether everything in the screen rectangle (texture coordinates) is nearer than the given view distance. For
+// bounding volumes pass the rectangle they project to and their nearest distance.
+bool hiZOccluded(vec2 minCoord, vec2 maxCoord, float nearestDistance) {
+    vec2 size = vec2(textureSize(hiZ, 0));
+    vec2 minPixel = clamp(minCoord, 0.0, 1.0) * size;
+    vec2 maxPixel = clamp(maxCoord, 0.0, 1.0) * size;
+
+    // the level where the rectangle covers at most 2x2 texels
+    float extent = max(maxPixel.x - minPixel.x, maxPixel.y - minPixel.y);
+    int level = clamp(int(ceil(log2(max(extent, 1.0)))), 0, hiZLevels - 1);
+
+    float farthest = max(max(hiZFetch(minPixel, level).y, hiZFetch(vec2(maxPixel.x, minPixel.y), level).y),
+                         max(hiZFetch(vec2(minPixel.x, maxPixel.y), level).y, hiZFetch(maxPixel, level).y));
+
+    return nearestDistance > farthest;
+}
\ No newline at end of file
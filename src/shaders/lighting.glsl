@@ -255,5 +255,55 @@ float ShadowCalculationLinear(float bias, vec4 fragPosLightSpace, sampler2D shad
     return PCF(shadowMap,textureSize(shadowMap, 0), projCoords.xy, projCoords.z-bias, shadowRadius);
 }
 
+// ---------------------------------------------------------------------------------------------------
+
+// cook-torrance contribution of a point light, all positions in view space
+vec3 PointLightContribution(vec3 fragPos, vec3 N, vec3 V, vec3 albedo, float roughness, float metallic, vec3 F0, vec3 lightPosition, vec3 lightColor, float lightRadius) {
+    float distance = length(lightPosition - fragPos);
+    if (distance >= lightRadius) {
+        return vec3(0.0);
+    }
+
+    vec3 L = normalize(lightPosition - fragPos);
+    vec3 H = normalize(V + L);
+    float attenuation = pow(clamp(1.0 - pow(distance / lightRadius, 1.0), 0.0, 1.0), 2.0) / (distance * distance + 1.0);
+    vec3 radiance     = lightColor * 100.0 * attenuation;
+
+    float NDF = DistributionGGX(N, H, roughness);
+    float G   = GeometrySmith(N, V, L, roughness);
+    vec3 F    = fresnelSchlickRoughness(clamp(dot(H, V), 0.0, 1.0), F0, roughness);
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;
+    vec3 nominator    = NDF * G * F;
+    float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
+    vec3 specular     = nominator / denominator;
+
+    float NdotL = max(dot(N, L), 0.0);
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+// ---------------------------------------------------------------------------------------------------
+
+// index of the cube face a world space direction falls into, ordered +x, -x, +y, -y, +z, -z
+int CubeFace(vec3 dir) {
+    vec3 a = abs(dir);
+
+    if (a.x >= a.y && a.x >= a.z) {
+        return dir.x > 0.0 ? 0 : 1;
+    }
+    if (a.y >= a.z) {
+        return dir.y > 0.0 ? 2 : 3;
+    }
+    return dir.z > 0.0 ? 4 : 5;
+}
+
+// shadow factor from a shadow atlas tile, fragPosAtlas is the fragment transformed by the tile's matrix
+float AtlasShadow(sampler2D atlas, vec4 fragPosAtlas, float bias) {
+    vec3 projCoords = fragPosAtlas.xyz / fragPosAtlas.w;
+
+    return texture2DShadowLerp(atlas, textureSize(atlas, 0), projCoords.xy, projCoords.z - bias);
+}
+
 
 #endif
\ No newline at end of file
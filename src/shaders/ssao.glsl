@@ -1,12 +1,18 @@
 #include <lighting>
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
+#include <gbuffer>
+
 uniform sampler2D texNoise;
 
 uniform int kernelSize;
 
-uniform vec3 samples[256];
+// uploaded once, w is unused padding
+layout (std140) uniform SsaoKernel {
+    vec4 samples[256];
+};
+
+// cos and sin of this frame's rotation of the kernel around the normal
+uniform vec2 rotation;
 
 uniform mat4 projection;
 
@@ -19,9 +25,10 @@ uniform vec3 noiseScale;
 
 vec3 postProcess(vec2 texCoord) {
 // get input for SSAO algorithm
-    vec3 fragPos = texture(gPosition, texCoord).xyz;
-    vec3 normal = normalize(texture(gNormal, texCoord).rgb);
+    vec3 fragPos = gBufferPosition(texCoord);
+    vec3 normal = gBufferNormal(texCoord);
     vec3 randomVec = normalize(texture(texNoise, texCoord * noiseScale.xy).xyz);
+    randomVec.xy = mat2(rotation.x, rotation.y, -rotation.y, rotation.x) * randomVec.xy;
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
     vec3 bitangent = cross(normal, tangent);
@@ -31,7 +38,7 @@ vec3 postProcess(vec2 texCoord) {
     for(int i = 0; i < kernelSize; ++i)
     {
         // get sample position
-        vec3 sample = TBN * samples[i]; // from tangent to view-space
+        vec3 sample = TBN * samples[i].xyz; // from tangent to view-space
         sample = fragPos + sample * radius;
 
         // project sample position (to sample texture) (to get position on screen/texture)
@@ -41,11 +48,10 @@ vec3 postProcess(vec2 texCoord) {
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
 
 
-        if (length(texture(gPosition, offset.xy).rgb) > 0.0) {
-            // get sample depth
-            float sampleDepth = texture(gPosition, offset.xy).z; // get depth value of kernel sample
-
+        // get depth value of kernel sample, 0 where nothing was drawn
+        float sampleDepth = gBufferViewZ(offset.xy);
 
+        if (sampleDepth != 0.0) {
             // range check & accumulate
             float rangeCheck = smoothstep(0.0, 1.0, radius / abs((fragPos.z - sampleDepth) * 10));
             occlusion += (sampleDepth >= sample.z + bias ? 1.0 : 0.0) * rangeCheck;
@@ -55,10 +61,11 @@ vec3 postProcess(vec2 texCoord) {
 
 
 
+    // the view space depth is kept next to the AO for reprojection and the depth aware upsample
     if (length(fragPos) > 0.0) {
-        return vec3(occlusion);
+        return vec3(occlusion, fragPos.z, 0.0);
 	}
 	else {
-		return vec3(1.0);
+		return vec3(1.0, 0.0, 0.0);
 	}
 }
\ No newline at end of file
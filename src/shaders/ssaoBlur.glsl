@@ -1,16 +1,50 @@
-uniform sampler2D ssaoInput;
-uniform sampler2D source;
+uniform sampler2D STAGE_ssao;
+// view space positions, or the depth buffer with the compact g-buffer layout
+uniform sampler2D STAGE_position;
+uniform bool STAGE_compact;
+uniform mat4 STAGE_inverseProjection;
+
+uniform float STAGE_depthSharpness;
+
+float STAGE_viewZ(vec2 texCoord) {
+    if (!STAGE_compact) {
+        return texture(STAGE_position, texCoord).z;
+    }
+
+    float depth = texture(STAGE_position, texCoord).r;
+
+    if (depth == 1.0) {
+        return 0.0;
+    }
+
+    vec2 zw = (STAGE_inverseProjection * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0)).zw;
+    return zw.x / zw.y;
+}
+
+// joint bilateral upsample, low resolution samples at another depth than this pixel get little weight so AO doesn't
+// bleed across edges
+vec3 STAGE_apply(vec3 color, vec2 texCoord) {
+    float depth = STAGE_viewZ(texCoord);
+    vec2 texelSize = 1.0 / vec2(textureSize(STAGE_ssao, 0));
 
-vec3 postProcess(vec2 texCoord) {
-    vec2 texelSize = 1.0 / vec2(textureSize(ssaoInput, 0));
     float result = 0.0;
-    for (int x = -2; x < 2; ++x)
+    float totalWeight = 0.0;
+    for (int x = -1; x <= 1; ++x)
     {
-        for (int y = -2; y < 2; ++y)
+        for (int y = -1; y <= 1; ++y)
         {
-            vec2 offset = vec2(float(x), float(y)) * texelSize;
-            result += texture(ssaoInput, texCoord + offset).r;
+            vec2 ssao = texture(STAGE_ssao, texCoord + vec2(float(x), float(y)) * texelSize).rg;
+
+            float weight = exp(-0.5 * float(x*x + y*y)) * exp(-abs(depth - ssao.g) * STAGE_depthSharpness / max(abs(depth), 0.1));
+
+            result += ssao.r * weight;
+            totalWeight += weight;
         }
     }
-    return vec3(result / (4.0 * 4.0)) * texture(source, texCoord).rgb;
+
+    if (totalWeight < 0.0001) {
+        return texture(STAGE_ssao, texCoord).r * color;
+    }
+
+    return (result / totalWeight) * color;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+uniform sampler2D current;
+uniform sampler2D history;
+
+#include <gbuffer>
+
+uniform bool hasHistory;
+
+// from this frame's view space to the previous frame's
+uniform mat4 reprojection;
+uniform mat4 previousProjection;
+
+// weight of the current frame
+uniform float blend;
+
+vec3 postProcess(vec2 texCoord) {
+    vec2 ao = texture(current, texCoord).rg;
+    vec3 position = gBufferPosition(texCoord);
+
+    if (!hasHistory || length(position) == 0.0) {
+        return vec3(ao, 0.0);
+    }
+
+    vec4 previousPosition = reprojection * vec4(position, 1.0);
+    vec4 previousClip = previousProjection * previousPosition;
+    vec2 previousCoord = previousClip.xy / previousClip.w * 0.5 + 0.5;
+
+    if (previousClip.w <= 0.0 || any(lessThan(previousCoord, vec2(0.0))) || any(greaterThan(previousCoord, vec2(1.0)))) {
+        return vec3(ao, 0.0);
+    }
+
+    vec2 previous = texture(history, previousCoord).rg;
+
+    // something else was at this spot last frame, the point was just disoccluded
+    if (abs(previous.g - previousPosition.z) > abs(previousPosition.z) * 0.05 + 0.05) {
+        return vec3(ao, 0.0);
+    }
+
+    return vec3(mix(previous.r, ao.r, blend), ao.g, 0.0);
+}
\ No newline at end of file
@@ -1,7 +1,4 @@
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
-uniform sampler2D gRoughnessMetallic;
+#include <gbuffer>
 uniform sampler2D deferred;
 uniform sampler2D deferredBlur;
 uniform samplerCube prefilter;
@@ -14,101 +11,20 @@ uniform mat4 view;
 
 #include <lighting>
 
-const float step = 0.1;
-const float minRayStep = 0.1;
-const float maxSteps = 60;
-const int numBinarySearchSteps = 10;
+#include <hiz>
 
-float depthAt(vec2 pos) {
-	vec4 texVal = texture(gPosition, pos);
-
-	if (length(texVal.xyz) > 0.0) {
-		return texVal.z;
-	}
-	else {
-		return 100000000000.0;
-	}
-
-	
-}
-
-vec3 binarySearch(inout vec3 dir, inout vec3 hitCoord, inout float dDepth)
-{
-    float depth;
-
-    vec4 projectedCoord;
-
-    for(int i = 0; i < numBinarySearchSteps; i++)
-    {
-
-        projectedCoord = projection * vec4(hitCoord, 1.0);
-        projectedCoord.xy /= projectedCoord.w;
-        projectedCoord.xy = projectedCoord.xy * 0.5 + 0.5;
-
-        //depth = (vec4(texture(gPosition, projectedCoord.xy).xyz, 1.0)).z;
-        depth = depthAt(projectedCoord.xy);
-        dDepth = hitCoord.z - depth;
-
-        dir *= 0.5;
-        if(dDepth > 0.0)
-            hitCoord += dir;
-        else
-            hitCoord -= dir;
-    }
-
-        projectedCoord = projection * vec4(hitCoord, 1.0);
-        projectedCoord.xy /= projectedCoord.w;
-        projectedCoord.xy = projectedCoord.xy * 0.5 + 0.5;
-
-    return vec3(projectedCoord.xy, depth);
-}
-
-vec4 rayMarch(vec3 dir, inout vec3 hitCoord, out float dDepth)
-{
-    dir *= step;
-
-    float error = 1.0;
-    float depth;
-    int steps;
-    vec4 projectedCoord;
-
-    for(int i = 0; i < maxSteps; i++)
-    {
-        hitCoord += dir;
-
-        projectedCoord = projection * vec4(hitCoord, 1.0);
-        projectedCoord.xy /= projectedCoord.w;
-        projectedCoord.xy = projectedCoord.xy * 0.5 + 0.5;
-
-        //depth = (vec4(texture(gPosition, projectedCoord.xy).xyz, 1.0)).z;
-        depth = depthAt(projectedCoord.xy);
-
-        dDepth = hitCoord.z - depth;
-
-        if((dir.z - dDepth) < 1.2)
-        {
-            if(dDepth <= 0.0)
-            {
-                error = 0.0;
-                vec4 Result;
-                Result = vec4(binarySearch(dir, hitCoord, dDepth), 1.0);
-                return Result;
-            }
-
-        }
-
-        steps++;
-    }
-
-    return vec4(projectedCoord.xy, depth, error);
-}
+// start off the surface along the normal so the ray doesn't hit it
+const float rayOffset = 0.1;
+const float maxDistance = 50.0;
+const float thickness = 0.5;
+const int maxIterations = 48;
 
 
 vec3 postProcess(vec2 texCoord) {
     mat4 inverseView = inverse(view);
 
-    vec3 viewPos = texture(gPosition, texCoord).rgb;
-    vec3 normal = normalize(texture(gNormal, texCoord).rgb);
+    vec3 viewPos = gBufferPosition(texCoord);
+    vec3 normal = gBufferNormal(texCoord);
     float roughness = texture(gRoughnessMetallic, texCoord).r;
     float metallic = texture(gRoughnessMetallic, texCoord).g;
     vec3 albedo = texture(gAlbedo, texCoord).rgb;
@@ -122,24 +38,17 @@ vec3 postProcess(vec2 texCoord) {
 
     float frontFacingFactor = smoothstep(0.0, 0.2, dot(V, R));
 
-    vec3 hitPos = viewPos;
-    float dDepth;
-
-    vec4 coords = rayMarch(R * max(minRayStep, -viewPos.z), hitPos, dDepth);
-    //float error = coords.w;
+    vec2 coords;
+    bool hit = hiZTrace(viewPos + N * rayOffset, R, projection, maxDistance, thickness, maxIterations, coords);
 
     vec2 dCoords = smoothstep(0.2, 0.6, abs(vec2(0.5, 0.5) - coords.xy));
     float screenEdgefactor = clamp(1.0 - (dCoords.x + dCoords.y), 0.0, 1.0);
 
     float roughnessCutoffFactor = smoothstep(0.7, 1.0, 1-roughness);
 
-    float ReflectionMultiplier = screenEdgefactor * frontFacingFactor * roughnessCutoffFactor;
-
-    if (coords.z - viewPos.z > 1.0) {
-        ReflectionMultiplier = 0.0;
-    }
+    float ReflectionMultiplier = hit ? screenEdgefactor * frontFacingFactor * roughnessCutoffFactor : 0.0;
 
-    if (length(texture(gPosition, coords.xy).rgb) > 0.0) {
+    if (length(gBufferPosition(coords.xy)) > 0.0) {
 
     }
     else {
@@ -165,7 +74,7 @@ vec3 postProcess(vec2 texCoord) {
     //return texture(deferred, coords.xy).rgb;
 
 
-    if (length(texture(gPosition, texCoord).rgb) > 0.0) {
+    if (length(gBufferPosition(texCoord)) > 0.0) {
         return texture(deferred, texCoord).rgb + (SSR*F);
     }
     else {
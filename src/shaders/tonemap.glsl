@@ -1,6 +1,4 @@
-uniform sampler2D source;
-
-vec3 aces(vec3 col, float exposure)
+vec3 STAGE_aces(vec3 col, float exposure)
 {
     float a = 2.51f;
     float b = 0.03f;
@@ -10,16 +8,14 @@ vec3 aces(vec3 col, float exposure)
     return clamp((col*(a*col+b))/(col*(c*col+d)+e), 0.0, 1.0);
 }
 
-vec3 reinhard(vec3 col, float exposure) {
+vec3 STAGE_reinhard(vec3 col, float exposure) {
     return vec3(1.0) - exp(-col * exposure);
 }
 
-vec3 postProcess(vec2 texCoord) {
-    vec3 color = texture(source, texCoord).rgb;
-
+vec3 STAGE_apply(vec3 color, vec2 texCoord) {
     // HDR tonemapping
     const float exposure = 1.0;
-    color = aces(color, exposure);
+    color = STAGE_aces(color, exposure);
 
     // float fogStrength = length(texture(gPosition, texCoord).rgb);
     // fogStrength = smoothstep(fogInner, fogOuter, fogStrength);
@@ -0,0 +1,55 @@
+#include "Test.hpp"
+
+#include <crucible/Renderer.hpp>
+
+// only has bounds, the decision never draws anything
+class BoxRenderable : public IRenderable {
+private:
+    AABB bounds = AABB(vec3(-0.5f), vec3(0.5f));
+
+public:
+    void render() const {}
+
+    const AABB *getBounds() const {
+        return &bounds;
+    }
+};
+
+TEST("depth prepass/auto mode follows the overdraw of derived bounds") {
+    BoxRenderable box;
+    Material material;
+
+    Camera cam;
+    cam.dimensions = vec2(1920.0f, 1080.0f);
+
+    Renderer::DepthPrepassMode previousMode = Renderer::depthPrepassMode;
+    Renderer::depthPrepassMode = Renderer::DEPTH_PREPASS_AUTO;
+
+    // one small box in the middle of the screen
+    Transform small(vec3(0.0f, 0.0f, -10.0f));
+    Renderer::render(&box, &material, &small);
+
+    CHECK(!Renderer::wantsDepthPrepass(cam, Frustum(), false));
+    CHECK(Renderer::getEstimatedOverdraw() > 0.0f);
+    CHECK(Renderer::getEstimatedOverdraw() < 1.0f);
+
+    // eight screen filling walls behind each other, no aabbs given so the mesh bounds are used
+    std::vector<Transform> walls;
+    for (int i = 0; i < 8; i++) {
+        walls.push_back(Transform(vec3(0.0f, 0.0f, -20.0f - i * 2.0f), quaternion(), vec3(200.0f, 200.0f, 1.0f)));
+    }
+    for (size_t i = 0; i < walls.size(); i++) {
+        Renderer::render(&box, &material, &walls[i]);
+    }
+
+    CHECK(Renderer::wantsDepthPrepass(cam, Frustum(), false));
+    CHECK(Renderer::getEstimatedOverdraw() > Renderer::depthPrepassThreshold);
+
+    Renderer::depthPrepassMode = Renderer::DEPTH_PREPASS_NEVER;
+    CHECK(!Renderer::wantsDepthPrepass(cam, Frustum(), false));
+
+    Renderer::depthPrepassMode = Renderer::DEPTH_PREPASS_ALWAYS;
+    CHECK(Renderer::wantsDepthPrepass(cam, Frustum(), false));
+
+    Renderer::depthPrepassMode = previousMode;
+}
@@ -0,0 +1,100 @@
+#include "Test.hpp"
+
+#include <crucible/OcclusionCuller.hpp>
+#include <crucible/AABB.hpp>
+#include <crucible/ThreadPool.hpp>
+
+// a camera at the origin looking down -z, with an 8 by 8 quad 5 units in front of it covering the middle of the view
+static void setupQuad(OcclusionCuller &culler) {
+    culler.setup(256, 128);
+    culler.begin(perspective(90.0f, 2.0f, 0.1f, 100.0f) * LookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f)));
+
+    std::vector<vec3> positions = {
+        vec3(-4.0f, -4.0f, -5.0f),
+        vec3(4.0f, -4.0f, -5.0f),
+        vec3(4.0f, 4.0f, -5.0f),
+        vec3(-4.0f, 4.0f, -5.0f)
+    };
+    std::vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+
+    culler.addOccluder(positions, indices, mat4());
+    culler.rasterize();
+}
+
+TEST("occlusion culler/box behind a quad is occluded") {
+    OcclusionCuller culler;
+    setupQuad(culler);
+
+    CHECK(culler.isOccluded(AABB(vec3(-1.0f, -1.0f, -11.0f), vec3(1.0f, 1.0f, -9.0f))));
+    CHECK(culler.getNumCulled() == 1);
+}
+
+TEST("occlusion culler/box in front of a quad is visible") {
+    OcclusionCuller culler;
+    setupQuad(culler);
+
+    CHECK(!culler.isOccluded(AABB(vec3(-1.0f, -1.0f, -3.0f), vec3(1.0f, 1.0f, -2.0f))));
+}
+
+TEST("occlusion culler/box behind the edge of a quad is visible") {
+    OcclusionCuller culler;
+    setupQuad(culler);
+
+    // sticks out past the right edge of the quad as seen from the camera
+    CHECK(!culler.isOccluded(AABB(vec3(6.0f, -1.0f, -11.0f), vec3(10.0f, 1.0f, -9.0f))));
+}
+
+TEST("occlusion culler/box crossing the near plane is visible") {
+    OcclusionCuller culler;
+    setupQuad(culler);
+
+    CHECK(!culler.isOccluded(AABB(vec3(-1.0f, -1.0f, -10.0f), vec3(1.0f, 1.0f, 1.0f))));
+}
+
+TEST("occlusion culler/threads rasterize the same buffer") {
+    // enough triangles to go through the worker threads
+    std::vector<vec3> positions;
+    std::vector<unsigned int> indices;
+
+    for (int i = 0; i < 512; i++) {
+        float x = (i % 32) * 0.5f - 8.0f;
+        float y = (i / 32) * 0.5f - 4.0f;
+        unsigned int first = positions.size();
+
+        positions.push_back(vec3(x, y, -5.0f - i * 0.001f));
+        positions.push_back(vec3(x + 0.5f, y, -5.0f));
+        positions.push_back(vec3(x, y + 0.5f, -5.0f));
+
+        indices.push_back(first);
+        indices.push_back(first + 1);
+        indices.push_back(first + 2);
+    }
+
+    mat4 viewProjection = perspective(90.0f, 2.0f, 0.1f, 100.0f) * LookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+
+    OcclusionCuller single;
+    OcclusionCuller threaded;
+
+    int previousThreads = ThreadPool::numThreads;
+
+    OcclusionCuller *cullers[2] = {&single, &threaded};
+    for (int c = 0; c < 2; c++) {
+        ThreadPool::numThreads = c == 0 ? 1 : 4;
+
+        cullers[c]->setup(256, 128);
+        cullers[c]->begin(viewProjection);
+        cullers[c]->addOccluder(positions, indices, mat4());
+        cullers[c]->rasterize();
+    }
+
+    ThreadPool::numThreads = previousThreads;
+
+    bool same = true;
+    for (int y = 0; y < 128; y++) {
+        for (int x = 0; x < 256; x++) {
+            same &= single.getDepth(x, y) == threaded.getDepth(x, y);
+        }
+    }
+
+    CHECK(same);
+}
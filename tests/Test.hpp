@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * A failed CHECK marks the running test as failed and reports the condition, the test keeps running.
+ */
+void reportFailure(const char *condition, const char *file, int line);
+
+struct TestInfo {
+    const char *name;
+    void (*function)();
+};
+
+std::vector<TestInfo> &getTests();
+
+struct TestRegistrar {
+    TestRegistrar(const char *name, void (*function)());
+};
+
+#define TEST_CONCAT_(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_(a, b)
+
+/**
+ * Defines and registers a test, the block that follows is its body. Tests run without a window or an OpenGL context.
+ */
+#define TEST(name) \
+    static void TEST_CONCAT(test, __LINE__)(); \
+    static TestRegistrar TEST_CONCAT(registrar, __LINE__)(name, TEST_CONCAT(test, __LINE__)); \
+    static void TEST_CONCAT(test, __LINE__)()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            reportFailure(#condition, __FILE__, __LINE__); \
+        } \
+    } while (false)
@@ -0,0 +1,59 @@
+#include "Test.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static bool currentFailed = false;
+
+void reportFailure(const char *condition, const char *file, int line) {
+    printf("  %s:%d: CHECK(%s) failed\n", file, line, condition);
+    currentFailed = true;
+}
+
+std::vector<TestInfo> &getTests() {
+    static std::vector<TestInfo> tests;
+    return tests;
+}
+
+TestRegistrar::TestRegistrar(const char *name, void (*function)()) {
+    TestInfo info;
+    info.name = name;
+    info.function = function;
+
+    getTests().push_back(info);
+}
+
+int main(int argc, char **argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    // static registration order depends on the linker
+    std::vector<TestInfo> tests = getTests();
+    std::stable_sort(tests.begin(), tests.end(), [](const TestInfo &a, const TestInfo &b) {
+        return strcmp(a.name, b.name) < 0;
+    });
+
+    int numRun = 0;
+    int numFailed = 0;
+
+    for (const TestInfo &info : tests) {
+        if (!filter.empty() && std::string(info.name).find(filter) == std::string::npos) {
+            continue;
+        }
+
+        currentFailed = false;
+        info.function();
+
+        printf("%-60s %s\n", info.name, currentFailed ? "FAILED" : "ok");
+
+        numRun++;
+        if (currentFailed) {
+            numFailed++;
+        }
+    }
+
+    printf("%d of %d tests passed\n", numRun - numFailed, numRun);
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "Test.hpp"
+
+#include <crucible/ThreadPool.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST("thread pool/every index runs once") {
+    int previousThreads = ThreadPool::numThreads;
+
+    // shrinking and growing the pool between loops, the workers are kept
+    int threadCounts[4] = {4, 2, 8, 1};
+
+    for (int c = 0; c < 4; c++) {
+        ThreadPool::numThreads = threadCounts[c];
+
+        for (int loop = 0; loop < 16; loop++) {
+            std::vector<std::atomic<int>> runs(1000);
+            for (std::atomic<int> &r : runs) {
+                r.store(0);
+            }
+
+            ThreadPool::parallelFor((int)runs.size(), [&runs](int i) {
+                runs[i]++;
+            });
+
+            bool once = true;
+            for (std::atomic<int> &r : runs) {
+                once = once && r.load() == 1;
+            }
+            CHECK(once);
+        }
+    }
+
+    ThreadPool::numThreads = previousThreads;
+}
+
+TEST("thread pool/nested loops run on the calling thread") {
+    int previousThreads = ThreadPool::numThreads;
+    ThreadPool::numThreads = 4;
+
+    std::atomic<int> total(0);
+    std::atomic<bool> sameThread(true);
+
+    ThreadPool::parallelFor(8, [&](int) {
+        std::thread::id outer = std::this_thread::get_id();
+
+        ThreadPool::parallelFor(8, [&](int) {
+            if (std::this_thread::get_id() != outer) {
+                sameThread = false;
+            }
+            total++;
+        });
+    });
+
+    CHECK(total.load() == 64);
+    CHECK(sameThread.load());
+
+    ThreadPool::numThreads = previousThreads;
+}